@@ -0,0 +1,73 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <string_view>
+#include <vector>
+
+namespace mrover::bench {
+
+    using Clock = std::chrono::steady_clock;
+
+    /**
+     * @brief Latency distribution of a benchmarked operation, all values are in milliseconds.
+     */
+    struct Stats {
+        double mean{}, p50{}, p95{}, p99{}, max{};
+        size_t samples{};
+    };
+
+    /**
+     * @brief Summarizes a set of timing samples.
+     *
+     * @param samples   Durations in milliseconds, sorted in place
+     */
+    [[nodiscard]] inline Stats summarize(std::vector<double>& samples) {
+        Stats stats;
+        if (samples.empty()) return stats;
+
+        std::sort(samples.begin(), samples.end());
+        auto percentile = [&](double p) { return samples[std::min(samples.size() - 1, static_cast<size_t>(p * static_cast<double>(samples.size())))]; };
+        double sum = 0;
+        for (double sample: samples) sum += sample;
+        stats.mean = sum / static_cast<double>(samples.size());
+        stats.p50 = percentile(0.50);
+        stats.p95 = percentile(0.95);
+        stats.p99 = percentile(0.99);
+        stats.max = samples.back();
+        stats.samples = samples.size();
+        return stats;
+    }
+
+    /**
+     * @brief Runs a callable repeatedly and records how long each call takes.
+     *
+     * @param function      Operation to benchmark
+     * @param iterations    Number of timed calls
+     * @param warmup        Number of untimed calls made first to warm caches and thread pools
+     */
+    template<typename F>
+    [[nodiscard]] Stats measure(F&& function, size_t iterations, size_t warmup = 10) {
+        for (size_t i = 0; i < warmup; ++i) function();
+
+        std::vector<double> samples;
+        samples.reserve(iterations);
+        for (size_t i = 0; i < iterations; ++i) {
+            Clock::time_point begin = Clock::now();
+            function();
+            samples.push_back(std::chrono::duration<double, std::milli>(Clock::now() - begin).count());
+        }
+        return summarize(samples);
+    }
+
+    inline void printHeader() {
+        std::printf("%-40s %10s %10s %10s %10s %10s\n", "Benchmark", "mean (ms)", "p50", "p95", "p99", "max");
+    }
+
+    inline void print(std::string_view name, Stats const& stats) {
+        std::printf("%-40.*s %10.3f %10.3f %10.3f %10.3f %10.3f\n",
+                    static_cast<int>(name.size()), name.data(), stats.mean, stats.p50, stats.p95, stats.p99, stats.max);
+    }
+
+} // namespace mrover::bench
@@ -0,0 +1,136 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <random>
+#include <vector>
+
+#include <Eigen/Core>
+#include <opencv2/aruco.hpp>
+#include <sensor_msgs/PointCloud2.h>
+
+#include "../point.hpp"
+
+namespace mrover::bench {
+
+    /**
+     * @brief A tag placed in the synthetic scene, in the camera frame (x forward, y left, z up).
+     */
+    struct SyntheticTag {
+        int id{};
+        Eigen::Vector3d center;
+        double yaw{}; // Rotation about z, zero faces the camera
+        bool visible{}; // Every corner projects inside the image
+    };
+
+    /**
+     * @brief Renders point clouds of ArUco tags floating in front of a textured wall, with the tag poses as ground truth.
+     *
+     * Points are ray cast through a pinhole camera so the XYZ and color channels agree the way a stereo camera's would.
+     * Tags drift on slow periodic paths so consecutive frames look like a moving rover.
+     */
+    class SyntheticTagScene {
+    private:
+        static constexpr double WALL_DISTANCE = 15.0;
+        static constexpr int MARKER_CELLS = 6; // 4x4 bits plus a one cell black border
+        static constexpr int QUIET_CELLS = 1;  // White margin printed around the marker
+
+        int mWidth, mHeight;
+        double mFocal;
+        double mTagSide; // Side of the black square in meters
+        std::vector<cv::Mat> mMarkers;
+        std::vector<SyntheticTag> mTags;
+        std::vector<Eigen::Vector3d> mBaseCenters;
+        std::mt19937 mGenerator{1337};
+        size_t mFrame = 0;
+
+        [[nodiscard]] Eigen::Vector2d project(Eigen::Vector3d const& p) const {
+            return {mWidth / 2.0 - mFocal * p.y() / p.x(), mHeight / 2.0 - mFocal * p.z() / p.x()};
+        }
+
+    public:
+        SyntheticTagScene(int width, int height, int tagCount, cv::aruco::Dictionary const& dictionary, double focal = 700, double tagSide = 0.2)
+            : mWidth{width}, mHeight{height}, mFocal{focal}, mTagSide{tagSide} {
+            std::uniform_real_distribution<double> distance{1.5, 6.0}, lateral{-0.35, 0.35}, vertical{-0.15, 0.15};
+            for (int i = 0; i < tagCount; ++i) {
+                cv::Mat marker;
+                dictionary.generateImageMarker(i, MARKER_CELLS, marker, 1);
+                mMarkers.push_back(marker);
+                // Spread tags across the field of view, lateral offsets are relative to the distance so they stay in view
+                double x = distance(mGenerator);
+                mBaseCenters.emplace_back(x, lateral(mGenerator) * x, vertical(mGenerator) * x);
+                mTags.push_back({i, mBaseCenters.back(), 0, false});
+            }
+        }
+
+        [[nodiscard]] std::vector<SyntheticTag> const& tags() const { return mTags; }
+
+        /**
+         * @brief Advances the tags along their paths and renders the next frame in the @p PointT layout.
+         */
+        template<typename PointT = Point>
+        void render(sensor_msgs::PointCloud2& msg) {
+            double t = static_cast<double>(mFrame++) / 30.0;
+            for (size_t i = 0; i < mTags.size(); ++i) {
+                SyntheticTag& tag = mTags[i];
+                double phase = static_cast<double>(i) * 1.7;
+                tag.center = mBaseCenters[i] + Eigen::Vector3d{0.3 * std::sin(0.4 * t + phase), 0.2 * std::sin(0.7 * t + phase), 0.05 * std::sin(t + phase)};
+                tag.yaw = 0.6 * std::sin(0.3 * t + phase);
+
+                tag.visible = true;
+                for (double a: {-0.5, 0.5}) {
+                    for (double b: {-0.5, 0.5}) {
+                        Eigen::Vector3d right{std::sin(tag.yaw), -std::cos(tag.yaw), 0}, up{0, 0, 1};
+                        Eigen::Vector2d pixel = project(tag.center + mTagSide * (a * right + b * up));
+                        tag.visible &= pixel.x() >= 0 && pixel.x() < mWidth && pixel.y() >= 0 && pixel.y() < mHeight;
+                    }
+                }
+            }
+
+            msg.height = mHeight;
+            msg.width = mWidth;
+            msg.is_dense = true;
+            fillPointCloudMessageHeader<PointT>(msg);
+            PointCloudView<PointT> points{msg};
+
+            std::uniform_int_distribution<int> noise{-8, 8};
+            for (int v = 0; v < mHeight; ++v) {
+                for (int u = 0; u < mWidth; ++u) {
+                    Eigen::Vector3d ray{1, -(u - mWidth / 2.0) / mFocal, -(v - mHeight / 2.0) / mFocal};
+
+                    // Background wall with a smooth texture and some sensor noise
+                    double nearest = WALL_DISTANCE;
+                    auto gray = static_cast<uint8_t>(std::clamp(110 + 50 * std::sin(u * 0.031) * std::cos(v * 0.047) + noise(mGenerator), 0.0, 255.0));
+
+                    for (size_t i = 0; i < mTags.size(); ++i) {
+                        SyntheticTag const& tag = mTags[i];
+                        Eigen::Vector3d normal{-std::cos(tag.yaw), -std::sin(tag.yaw), 0}, right{std::sin(tag.yaw), -std::cos(tag.yaw), 0}, up{0, 0, 1};
+                        double denominator = ray.dot(normal);
+                        if (std::abs(denominator) < 1e-9) continue;
+
+                        double distance = tag.center.dot(normal) / denominator;
+                        if (distance <= 0 || distance >= nearest) continue;
+
+                        Eigen::Vector3d local = distance * ray - tag.center;
+                        // Cell coordinates with the origin at the top left of the marker
+                        double cellX = (local.dot(right) / mTagSide + 0.5) * MARKER_CELLS;
+                        double cellY = (0.5 - local.dot(up) / mTagSide) * MARKER_CELLS;
+                        if (cellX < -QUIET_CELLS || cellX >= MARKER_CELLS + QUIET_CELLS || cellY < -QUIET_CELLS || cellY >= MARKER_CELLS + QUIET_CELLS) continue;
+
+                        nearest = distance;
+                        bool inMarker = cellX >= 0 && cellX < MARKER_CELLS && cellY >= 0 && cellY < MARKER_CELLS;
+                        gray = inMarker ? mMarkers[i].at<uint8_t>(static_cast<int>(cellY), static_cast<int>(cellX)) : 255;
+                    }
+
+                    Eigen::Vector3d p = nearest * ray;
+                    PointT& point = points(u, v);
+                    point = {};
+                    setPosition(point, static_cast<float>(p.x()), static_cast<float>(p.y()), static_cast<float>(p.z()));
+                    point.b = point.g = point.r = gray;
+                    point.a = 255;
+                }
+            }
+        }
+    };
+
+} // namespace mrover::bench
@@ -0,0 +1,79 @@
+#include "tag_detector.hpp"
+
+#include <random>
+
+#include <bench.hpp>
+
+/**
+ * @brief Compares the fused point cloud to grayscale kernel against the previous two pass conversion.
+ *
+ * The fused kernel also runs over the compact layout, which reads half the memory of the full one.
+ *
+ * Usage: tag_detector_convert_benchmark [width] [height] [iterations]
+ */
+int main(int argc, char** argv) {
+    using namespace mrover;
+
+    int width = argc > 1 ? std::stoi(argv[1]) : 1280;
+    int height = argc > 2 ? std::stoi(argv[2]) : 720;
+    size_t iterations = argc > 3 ? std::stoul(argv[3]) : 500;
+
+    sensor_msgs::PointCloud2 fullMsg, compactMsg;
+    for (sensor_msgs::PointCloud2* msg: {&fullMsg, &compactMsg}) {
+        msg->width = width;
+        msg->height = height;
+    }
+    fillPointCloudMessageHeader<Point>(fullMsg);
+    fillPointCloudMessageHeader<PointXYZRGB>(compactMsg);
+    PointCloudView<Point> cloud{fullMsg};
+    PointCloudView<PointXYZRGB> compactCloud{compactMsg};
+    std::mt19937 generator{42};
+    std::uniform_int_distribution<int> channel{0, 255};
+    for (size_t i = 0; i < cloud.size(); ++i) {
+        Point& point = cloud[i];
+        point.b = channel(generator);
+        point.g = channel(generator);
+        point.r = channel(generator);
+        point.a = 255;
+        compactCloud[i].b = point.b;
+        compactCloud[i].g = point.g;
+        compactCloud[i].r = point.r;
+        compactCloud[i].a = point.a;
+    }
+    PointCloudView<Point const> fullView{fullMsg};
+    PointCloudView<PointXYZRGB const> compactView{compactMsg};
+
+    cv::Mat bgr{height, width, CV_8UC3}, referenceGray{height, width, CV_8UC1}, gray{height, width, CV_8UC1};
+
+    // Previous implementation: copy into a BGR image then convert that to grayscale
+    auto twoPass = [&] {
+        auto* pixelPtr = reinterpret_cast<cv::Vec3b*>(bgr.data);
+        Point const* pointPtr = cloud.data();
+        std::for_each(std::execution::par_unseq, pixelPtr, pixelPtr + bgr.total(), [&](cv::Vec3b& pixel) {
+            size_t i = &pixel - pixelPtr;
+            pixel[0] = pointPtr[i].b;
+            pixel[1] = pointPtr[i].g;
+            pixel[2] = pointPtr[i].r;
+        });
+        cv::cvtColor(bgr, referenceGray, cv::COLOR_BGR2GRAY);
+    };
+    auto fusedGray = [&] { pointCloudToGray(fullView, gray, nullptr); };
+    auto fusedGrayAndBgr = [&] { pointCloudToGray(fullView, gray, &bgr); };
+    auto fusedCompactGray = [&] { pointCloudToGray(compactView, gray, nullptr); };
+
+    std::printf("Cloud: %dx%d (%.1f MB, %.1f MB compact), iterations: %zu\n", width, height,
+                static_cast<double>(fullMsg.data.size()) / 1e6, static_cast<double>(compactMsg.data.size()) / 1e6, iterations);
+    bench::printHeader();
+    bench::print("for_each(par_unseq) + cvtColor", bench::measure(twoPass, iterations));
+    bench::print("pointCloudToGray (gray only)", bench::measure(fusedGray, iterations));
+    bench::print("pointCloudToGray (gray + BGR debug)", bench::measure(fusedGrayAndBgr, iterations));
+    bench::print("pointCloudToGray (gray only, XYZRGB)", bench::measure(fusedCompactGray, iterations));
+
+    twoPass();
+    fusedGray();
+    int mismatches = cv::countNonZero(referenceGray != gray);
+    fusedCompactGray();
+    mismatches += cv::countNonZero(referenceGray != gray);
+    std::printf("Grayscale mismatches against cvtColor: %d\n", mismatches);
+    return mismatches == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
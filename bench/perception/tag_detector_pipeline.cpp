@@ -0,0 +1,210 @@
+#include "tag_detector.hpp"
+
+#include <rosbag/bag.h>
+#include <rosbag/view.h>
+
+#include <bench.hpp>
+
+#include "synthetic_tags.hpp"
+
+/**
+ * @brief Runs the tag detector processing stages offline, without a ROS master.
+ *
+ * Point clouds either come from a bag or are rendered with ArUco tags at known poses.
+ * The latter also reports recall and the error of the estimated tag positions against the ground truth.
+ * The debug image is always rendered and serialized, as if a remote node were subscribed to it.
+ * Synthetic clouds can be rendered in any point layout to compare them, bags are read in whatever layout they were recorded in.
+ *
+ * Usage: tag_detector_pipeline_benchmark synthetic [frames] [width] [height] [tags] [--roi] [--pyramid levels] [--layout full|xyzrgb|half]
+ *        tag_detector_pipeline_benchmark bag <path> [topic] [frames] [--roi] [--pyramid levels]
+ */
+int main(int argc, char** argv) {
+    using namespace mrover;
+
+    ros::Time::init();
+
+    std::vector<std::string> args;
+    bool useRoiTracking = false;
+    int pyramidLevels = 0;
+    std::string layout = "full";
+    for (int i = 1; i < argc; ++i) {
+        std::string_view arg = argv[i];
+        if (arg == "--roi") {
+            useRoiTracking = true;
+        } else if (arg == "--pyramid" && i + 1 < argc) {
+            pyramidLevels = std::stoi(argv[++i]);
+        } else if (arg == "--layout" && i + 1 < argc) {
+            layout = argv[++i];
+        } else {
+            args.emplace_back(arg);
+        }
+    }
+    auto argOr = [&](size_t i, std::string const& fallback) { return i < args.size() ? args[i] : fallback; };
+
+    std::string mode = argOr(0, "synthetic");
+    if ((mode != "synthetic" && (mode != "bag" || args.size() < 2)) || (layout != "full" && layout != "xyzrgb" && layout != "half")) {
+        std::fprintf(stderr, "Usage: %s synthetic [frames] [width] [height] [tags] [--roi] [--pyramid levels] [--layout full|xyzrgb|half]\n"
+                             "       %s bag <path> [topic] [frames] [--roi] [--pyramid levels]\n",
+                     argv[0], argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    // Same defaults as the nodelet
+    auto dictionary = cv::makePtr<cv::aruco::Dictionary>(cv::aruco::getPredefinedDictionary(cv::aruco::DICT_4X4_50));
+    auto params = cv::makePtr<cv::aruco::DetectorParameters>();
+    params->cornerRefinementMethod = cv::aruco::CORNER_REFINE_SUBPIX;
+    MarkerDetector detector{dictionary, params};
+    detector.setRoiTracking(useRoiTracking, 10, 0.5);
+    detector.setPyramid(pyramidLevels, 0.15);
+
+    // Threshold every scale, as if all of the debug threshold topics had subscribers
+    std::vector<int> windowSizes;
+    for (int windowSize = params->adaptiveThreshWinSizeMin; windowSize <= params->adaptiveThreshWinSizeMax; windowSize += params->adaptiveThreshWinSizeStep) {
+        windowSizes.push_back(windowSize);
+    }
+
+    AdaptiveThresholder thresholder;
+    ImageMessagePool imagePool;
+    cv::Mat grayImg;
+    std::vector<cv::Mat> threshImgs;
+    std::vector<Corners> corners;
+    std::vector<int> ids;
+    std::vector<std::optional<SE3>> tagsInCam;
+    SE3 camInParent{R3{0.5, 0, 0.8}};
+
+    constexpr std::array STAGE_NAMES{"Convert", "Threshold", "Detect", "Pose", "Publish"};
+    constexpr size_t WARMUP_FRAMES = 3; // First frames allocate every buffer
+    std::array<std::vector<double>, STAGE_NAMES.size()> stageSamples;
+    std::vector<double> totalSamples;
+    size_t frameCount = 0;
+    size_t truthCount = 0, truePositives = 0, falsePositives = 0;
+    double positionErrorSum = 0;
+    size_t positionErrorCount = 0;
+
+    auto process = [&](sensor_msgs::PointCloud2ConstPtr const& cloud, std::vector<bench::SyntheticTag> const* truth) {
+        std::array<double, STAGE_NAMES.size()> durations{};
+        size_t stage = 0;
+        bench::Clock::time_point begin = bench::Clock::now();
+        auto measure = [&] {
+            bench::Clock::time_point now = bench::Clock::now();
+            durations[stage++] = std::chrono::duration<double, std::milli>(now - begin).count();
+            begin = now;
+        };
+
+        grayImg.create(static_cast<int>(cloud->height), static_cast<int>(cloud->width), CV_8UC1);
+        sensor_msgs::ImagePtr imgMsg = imagePool.acquire(grayImg.size(), CV_8UC3, sensor_msgs::image_encodings::BGR8);
+        cv::Mat img = wrapImageMessage(*imgMsg, CV_8UC3);
+        visitPointCloud(*cloud, [&](auto const& view) { pointCloudToGray(view, grayImg, &img); });
+        measure();
+
+        thresholder.threshold(grayImg, windowSizes, params->adaptiveThreshConstant, threshImgs);
+        measure();
+
+        detector.detect(grayImg, corners, ids);
+        measure();
+
+        tagsInCam.clear();
+        for (Corners const& markerCorners: corners) {
+            cv::Point2f center = std::reduce(markerCorners.begin(), markerCorners.end()) / static_cast<float>(markerCorners.size());
+            auto u = static_cast<uint32_t>(std::lround(center.x)), v = static_cast<uint32_t>(std::lround(center.y));
+            std::optional<PointPosition> point;
+            if (u < cloud->width && v < cloud->height) {
+                visitPointCloud(*cloud, [&](auto const& view) { point = getPosition(view(u, v)); });
+            }
+            if (point && std::isfinite(point->x) && std::isfinite(point->y) && std::isfinite(point->z)) {
+                SE3 tagInCam{R3{point->x, point->y, point->z}};
+                // Compose into the parent frame like the nodelet does, the result itself is not needed
+                [[maybe_unused]] SE3 tagInParent = tagInCam * camInParent;
+                tagsInCam.emplace_back(tagInCam);
+            } else {
+                tagsInCam.emplace_back(std::nullopt);
+            }
+        }
+        measure();
+
+        cv::aruco::drawDetectedMarkers(img, corners, ids);
+        [[maybe_unused]] ros::SerializedMessage serialized = ros::serialization::serializeMessage(*imgMsg);
+        measure();
+
+        if (truth) {
+            for (bench::SyntheticTag const& tag: *truth) {
+                if (!tag.visible) continue;
+
+                ++truthCount;
+                auto it = std::ranges::find(ids, tag.id);
+                if (it == ids.end()) continue;
+
+                ++truePositives;
+                if (std::optional<SE3> const& tagInCam = tagsInCam[it - ids.begin()]) {
+                    positionErrorSum += (tagInCam->position() - tag.center).norm();
+                    ++positionErrorCount;
+                }
+            }
+            falsePositives += std::ranges::count_if(ids, [&](int id) { return std::ranges::none_of(*truth, [&](bench::SyntheticTag const& tag) { return tag.id == id; }); });
+        }
+
+        if (frameCount++ < WARMUP_FRAMES) return;
+
+        for (size_t i = 0; i < durations.size(); ++i) stageSamples[i].push_back(durations[i]);
+        totalSamples.push_back(std::reduce(durations.begin(), durations.end()));
+    };
+
+    bool synthetic = mode == "synthetic";
+    if (synthetic) {
+        size_t frames = std::stoul(argOr(1, "300"));
+        int width = std::stoi(argOr(2, "1280")), height = std::stoi(argOr(3, "720")), tagCount = std::stoi(argOr(4, "4"));
+        std::printf("Synthetic scene: %dx%d, %d tags, %zu frames, %s layout\n", width, height, tagCount, frames, layout.c_str());
+
+        bench::SyntheticTagScene scene{width, height, tagCount, *dictionary};
+        auto cloud = boost::make_shared<sensor_msgs::PointCloud2>();
+        for (size_t i = 0; i < frames; ++i) {
+            if (layout == "full") {
+                scene.render<Point>(*cloud);
+            } else if (layout == "xyzrgb") {
+                scene.render<PointXYZRGB>(*cloud);
+            } else {
+                scene.render<PointXYZHalfRGB>(*cloud);
+            }
+            process(cloud, &scene.tags());
+        }
+    } else {
+        std::string const& path = args[1];
+        std::string topic = argOr(2, "/camera/left/points");
+        size_t frames = std::stoul(argOr(3, std::to_string(std::numeric_limits<size_t>::max())));
+        std::printf("Bag: %s, topic: %s\n", path.c_str(), topic.c_str());
+
+        rosbag::Bag bag{path, rosbag::bagmode::Read};
+        rosbag::View view{bag, rosbag::TopicQuery{topic}};
+        for (rosbag::MessageInstance const& instance: view) {
+            if (frameCount >= frames) break;
+
+            sensor_msgs::PointCloud2ConstPtr cloud = instance.instantiate<sensor_msgs::PointCloud2>();
+            if (!cloud || cloud->width == 0 || cloud->height == 0 || !visitPointCloud(*cloud, [](auto const&) {})) {
+                std::fprintf(stderr, "Skipping message that is not a point cloud in a known layout\n");
+                continue;
+            }
+            process(cloud, nullptr);
+        }
+    }
+
+    if (totalSamples.empty()) {
+        std::fprintf(stderr, "Need more than %zu frames\n", WARMUP_FRAMES);
+        return EXIT_FAILURE;
+    }
+
+    std::printf("ROI tracking: %s, pyramid levels: %d, threshold scales: %zu\n", useRoiTracking ? "true" : "false", pyramidLevels, windowSizes.size());
+    bench::printHeader();
+    for (size_t i = 0; i < STAGE_NAMES.size(); ++i) {
+        bench::print(STAGE_NAMES[i], bench::summarize(stageSamples[i]));
+    }
+    bench::Stats total = bench::summarize(totalSamples);
+    bench::print("Total", total);
+    std::printf("Throughput: %.1f fps (all stages serial)\n", 1000.0 / total.mean);
+
+    if (synthetic) {
+        std::printf("Recall: %.3f (%zu / %zu visible tags), false positives: %zu\n",
+                    truthCount ? static_cast<double>(truePositives) / static_cast<double>(truthCount) : 0.0, truePositives, truthCount, falsePositives);
+        std::printf("Mean position error: %.4f m\n", positionErrorCount ? positionErrorSum / static_cast<double>(positionErrorCount) : 0.0);
+    }
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,62 @@
+#include "voxel_grid.hpp"
+#include "zed_wrapper.hpp"
+
+#include <bench.hpp>
+
+/**
+ * @brief Voxelizes the point clouds the ZED nodelet publishes, at each resolution the ZED grabs at.
+ *
+ * Clouds are filled from synthetic frames the same way the nodelet fills them on the CPU.
+ * At 720p a leaf size sweep follows, smaller leaves mean more voxels to merge and publish.
+ *
+ * Usage: voxel_grid_benchmark [iterations] [leaf size]
+ */
+int main(int argc, char** argv) {
+    using namespace mrover;
+
+    ros::Time::init();
+
+    size_t iterations = argc > 1 ? std::stoul(argv[1]) : 200;
+    float leafSize = argc > 2 ? std::stof(argv[2]) : VoxelGridParameters{}.leafSize;
+
+    struct Resolution {
+        char const* name;
+        uint32_t width, height;
+    };
+    constexpr std::array RESOLUTIONS{
+            Resolution{"VGA", 672, 376},
+            Resolution{"HD720", 1280, 720},
+            Resolution{"HD1080", 1920, 1080},
+            Resolution{"HD2K", 2208, 1242},
+    };
+    constexpr std::array SWEEP_LEAF_SIZES{0.025f, 0.05f, 0.2f};
+
+    auto fillCloud = [](uint32_t width, uint32_t height) {
+        SyntheticFrameSource source{width, height, 0, 1};
+        StereoFrame frame;
+        source.grab(frame, FrameRequest{});
+        auto msg = boost::make_shared<sensor_msgs::PointCloud2>();
+        fillPointCloudMessageFromHost(frame, msg);
+        return msg;
+    };
+    auto run = [&](std::string const& name, sensor_msgs::PointCloud2 const& input, float leaf) {
+        VoxelGridParameters parameters;
+        parameters.leafSize = leaf;
+        VoxelGrid voxelGrid{parameters};
+        sensor_msgs::PointCloud2 output;
+        bench::Stats stats = bench::measure([&] { voxelGrid.filter(input, output); }, iterations);
+        bench::print(name + " -> " + std::to_string(output.width) + " points", stats);
+    };
+
+    bench::printHeader();
+    for (Resolution const& resolution: RESOLUTIONS) {
+        sensor_msgs::PointCloud2Ptr input = fillCloud(resolution.width, resolution.height);
+        run(std::string{resolution.name} + " " + std::to_string(input->data.size() >> 20) + " MB", *input, leafSize);
+    }
+
+    sensor_msgs::PointCloud2Ptr input = fillCloud(1280, 720);
+    for (float leaf: SWEEP_LEAF_SIZES) {
+        run("HD720 leaf " + std::to_string(leaf).substr(0, 5) + " m", *input, leaf);
+    }
+    return EXIT_SUCCESS;
+}
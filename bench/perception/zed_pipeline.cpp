@@ -0,0 +1,129 @@
+#include "zed_wrapper.hpp"
+
+#include <bench.hpp>
+
+/**
+ * @brief Runs the ZED nodelet publish pipeline on the CPU, without a ZED, a GPU, or a ROS master.
+ *
+ * A grab thread pulls frames from a synthetic or recorded source as fast as it can and hands them through the triple buffer
+ * to a point cloud thread. That thread fills the point cloud, left image, depth, and camera info messages
+ * and serializes them, as if a remote node were subscribed to each. Passing --record writes every consumed frame
+ * to a recording, which is how to make one for the recorded source without a ZED.
+ *
+ * Usage: zed_pipeline_benchmark synthetic [frames] [width] [height] [--record path]
+ *        zed_pipeline_benchmark recorded <path> [frames] [--record path]
+ */
+int main(int argc, char** argv) {
+    using namespace mrover;
+
+    ros::Time::init();
+
+    std::vector<std::string> args;
+    std::string recordPath;
+    for (int i = 1; i < argc; ++i) {
+        std::string_view arg = argv[i];
+        if (arg == "--record" && i + 1 < argc) {
+            recordPath = argv[++i];
+        } else {
+            args.emplace_back(arg);
+        }
+    }
+    auto argOr = [&](size_t i, std::string const& fallback) { return i < args.size() ? args[i] : fallback; };
+
+    std::string mode = argOr(0, "synthetic");
+    if (mode != "synthetic" && (mode != "recorded" || args.size() < 2)) {
+        std::fprintf(stderr, "Usage: %s synthetic [frames] [width] [height] [--record path]\n"
+                             "       %s recorded <path> [frames] [--record path]\n",
+                     argv[0], argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    std::unique_ptr<FrameSource> source;
+    size_t frameCount;
+    if (mode == "synthetic") {
+        frameCount = std::stoul(argOr(1, "600"));
+        source = std::make_unique<SyntheticFrameSource>(std::stoul(argOr(2, "1280")), std::stoul(argOr(3, "720")), 0);
+    } else {
+        // Loop so short recordings still make for a long enough run
+        source = std::make_unique<RecordedFrameSource>(args[1], true, 0);
+        frameCount = std::stoul(argOr(2, "600"));
+    }
+
+    constexpr std::array STAGE_NAMES{"Point cloud fill", "Image + depth fill", "Camera info fill", "Serialize"};
+    constexpr size_t WARMUP_FRAMES = 3; // First frames allocate every message
+    std::array<std::vector<double>, STAGE_NAMES.size()> stageSamples;
+    std::vector<double> grabSamples, totalSamples;
+    std::unique_ptr<FrameRecorder> recorder;
+    TripleBuffer<StereoFrame> frames;
+    size_t grabbed = 0, consumed = 0;
+
+    bench::Clock::time_point runBegin = bench::Clock::now();
+    std::thread grabThread{[&] {
+        for (; grabbed < frameCount; ++grabbed) {
+            // Like the nodelet, the grab thread waits for the point cloud thread so the pipeline sets the rate
+            if (source->isOnDemand()) frames.waitUntilConsumed();
+
+            bench::Clock::time_point begin = bench::Clock::now();
+            if (!source->grab(frames.back(), FrameRequest{true, true})) break;
+
+            frames.publish();
+            grabSamples.push_back(std::chrono::duration<double, std::milli>(bench::Clock::now() - begin).count());
+        }
+        frames.close();
+    }};
+
+    MessagePool<sensor_msgs::PointCloud2> pointCloudPool;
+    MessagePool<sensor_msgs::Image> leftImagePool, leftDepthPool;
+    while (frames.waitAndConsume()) {
+        StereoFrame const& frame = frames.front();
+        std::array<double, STAGE_NAMES.size()> durations{};
+        size_t stage = 0;
+        bench::Clock::time_point frameBegin = bench::Clock::now(), begin = frameBegin;
+        auto measure = [&] {
+            bench::Clock::time_point now = bench::Clock::now();
+            durations[stage++] = std::chrono::duration<double, std::milli>(now - begin).count();
+            begin = now;
+        };
+
+        sensor_msgs::PointCloud2Ptr pointCloudMsg = pointCloudPool.acquire();
+        fillPointCloudMessageFromHost(frame, pointCloudMsg);
+        measure();
+
+        sensor_msgs::ImagePtr leftImageMsg = leftImagePool.acquire(), leftDepthMsg = leftDepthPool.acquire();
+        fillImageMessage(frame.leftBgra, frame.memory, frame.width, frame.height, leftImageMsg);
+        fillDepthMessage(frame.leftDepth, frame.memory, frame.width, frame.height, leftDepthMsg);
+        measure();
+
+        auto leftCamInfoMsg = boost::make_shared<sensor_msgs::CameraInfo>();
+        auto rightCamInfoMsg = boost::make_shared<sensor_msgs::CameraInfo>();
+        fillCameraInfoMessages(source->calibration(), frame.width, frame.height, leftCamInfoMsg, rightCamInfoMsg);
+        measure();
+
+        [[maybe_unused]] ros::SerializedMessage serializedPointCloud = ros::serialization::serializeMessage(*pointCloudMsg);
+        [[maybe_unused]] ros::SerializedMessage serializedImage = ros::serialization::serializeMessage(*leftImageMsg);
+        [[maybe_unused]] ros::SerializedMessage serializedDepth = ros::serialization::serializeMessage(*leftDepthMsg);
+        measure();
+        double total = std::chrono::duration<double, std::milli>(bench::Clock::now() - frameBegin).count();
+
+        // Not part of the pipeline being measured
+        if (!recordPath.empty()) {
+            if (!recorder) recorder = std::make_unique<FrameRecorder>(recordPath, frame.width, frame.height, source->calibration());
+            recorder->write(frame);
+        }
+
+        if (consumed++ < WARMUP_FRAMES) continue;
+
+        for (size_t i = 0; i < STAGE_NAMES.size(); ++i) stageSamples[i].push_back(durations[i]);
+        totalSamples.push_back(total);
+    }
+    grabThread.join();
+    double runSeconds = std::chrono::duration<double>(bench::Clock::now() - runBegin).count();
+
+    bench::printHeader();
+    bench::print("Grab + handoff", bench::summarize(grabSamples));
+    for (size_t i = 0; i < STAGE_NAMES.size(); ++i) bench::print(STAGE_NAMES[i], bench::summarize(stageSamples[i]));
+    bench::print("Total per published frame", bench::summarize(totalSamples));
+    std::printf("Grabbed %zu frames, published %zu at %.1f Hz\n", grabbed, consumed, static_cast<double>(consumed) / runSeconds);
+    if (recorder) std::printf("Recorded %zu frames to %s\n", consumed, recordPath.c_str());
+    return EXIT_SUCCESS;
+}
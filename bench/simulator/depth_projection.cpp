@@ -0,0 +1,96 @@
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdlib>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <Eigen/Geometry>
+
+#include <bench.hpp>
+#include <depth_projection.hpp>
+
+namespace {
+
+    using mrover::PointXYZRGB;
+
+    Eigen::Matrix3d const OPTICAL_TO_CAMERA = (Eigen::AngleAxisd{-M_PI_2, Eigen::Vector3d::UnitZ()} * Eigen::AngleAxisd{-M_PI_2, Eigen::Vector3d::UnitX()}).toRotationMatrix();
+
+    /**
+     * @brief How the Kinect plugin filled its cloud before the ray tables, an atan2 and two tan per pixel and a double precision rotation.
+     */
+    bool projectPerPixel(float const* depth, std::vector<uint8_t> const& image, uint32_t rows, uint32_t cols, double hfov, double near, double far, PointXYZRGB* points) {
+        bool isDense = true;
+        double fl = static_cast<double>(cols) / (2.0 * tan(hfov / 2.0));
+        int index = 0;
+        for (uint32_t j = 0; j < rows; j++) {
+            double pAngle = rows > 1 ? atan2(static_cast<double>(j) - 0.5 * static_cast<double>(rows - 1), fl) : 0.0;
+            for (uint32_t i = 0; i < cols; i++) {
+                PointXYZRGB& point = points[static_cast<size_t>(j) * cols + i];
+                double yAngle = cols > 1 ? atan2(static_cast<double>(i) - 0.5 * static_cast<double>(cols - 1), fl) : 0.0;
+                double d = depth[index++];
+                if (d > near && d < far) {
+                    Eigen::Vector3d rotated = OPTICAL_TO_CAMERA * Eigen::Vector3d{d * tan(yAngle), d * tan(pAngle), d};
+                    mrover::setPosition(point, static_cast<float>(rotated(0)), static_cast<float>(rotated(1)), static_cast<float>(rotated(2)));
+                } else {
+                    float nan = std::numeric_limits<float>::quiet_NaN();
+                    mrover::setPosition(point, nan, nan, nan);
+                    isDense = false;
+                }
+                uint8_t const* src = image.data();
+                if (image.size() == static_cast<size_t>(rows) * cols * 3) {
+                    point.b = src[i * 3 + j * cols * 3 + 2];
+                    point.g = src[i * 3 + j * cols * 3 + 1];
+                    point.r = src[i * 3 + j * cols * 3 + 0];
+                } else {
+                    point.b = point.g = point.r = 0;
+                }
+                point.a = 255;
+            }
+        }
+        return isDense;
+    }
+
+} // namespace
+
+/**
+ * @brief Fills the simulated depth camera's point cloud the way the Kinect plugin used to and with the ray tables.
+ *
+ * Depths are uniform up to past the far cutoff, so about a sixth of the points are out of range.
+ * The sky frame has nothing in range in its upper half, like an outdoor world, that is where dropping invalid points pays off.
+ *
+ * Usage: depth_projection_benchmark [iterations]
+ */
+int main(int argc, char** argv) {
+    size_t iterations = argc > 1 ? std::stoul(argv[1]) : 100;
+    constexpr double HFOV = 1.047, NEAR = 0.4, FAR = 5.0;
+
+    mrover::bench::printHeader();
+    for (auto [cols, rows]: {std::pair{640u, 480u}, std::pair{1280u, 720u}}) {
+        size_t pixels = static_cast<size_t>(cols) * rows;
+        std::mt19937 generator{42};
+        std::uniform_real_distribution<float> distribution{0, 6};
+        std::vector<float> depth(pixels);
+        for (float& value: depth) value = distribution(generator);
+        std::vector<uint8_t> image(pixels * 3);
+        for (uint8_t& value: image) value = static_cast<uint8_t>(generator());
+        std::vector<PointXYZRGB> points(pixels);
+
+        std::string name = std::to_string(cols) + "x" + std::to_string(rows);
+        mrover::bench::print(name + " per pixel", mrover::bench::measure([&] { projectPerPixel(depth.data(), image, rows, cols, HFOV, NEAR, FAR, points.data()); }, iterations));
+
+        mrover::DepthProjection projection;
+        projection.configure(cols, rows, HFOV, OPTICAL_TO_CAMERA);
+        mrover::DepthColors colors{mrover::DepthColors::Format::Rgb, image.data()};
+        mrover::bench::print(name + " ray tables", mrover::bench::measure([&] { projection.project(depth.data(), colors, NEAR, FAR, points.data()); }, iterations));
+
+        std::vector<float> sky = depth;
+        std::fill(sky.begin(), sky.begin() + static_cast<std::ptrdiff_t>(pixels / 2), std::numeric_limits<float>::infinity());
+        mrover::bench::print(name + " sky organized", mrover::bench::measure([&] { projection.project(sky.data(), colors, NEAR, FAR, points.data()); }, iterations));
+        mrover::bench::print(name + " sky in range only", mrover::bench::measure([&] { projection.projectValid(sky.data(), colors, NEAR, FAR, points.data()); }, iterations));
+        projection.configure(cols, rows, HFOV, OPTICAL_TO_CAMERA, 2);
+        mrover::bench::print(name + " sky in range stride 2", mrover::bench::measure([&] { projection.projectValid(sky.data(), colors, NEAR, FAR, points.data()); }, iterations));
+    }
+    return EXIT_SUCCESS;
+}
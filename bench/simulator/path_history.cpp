@@ -0,0 +1,93 @@
+#include <cmath>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+#include <ros/serialization.h>
+
+#include <bench.hpp>
+#include <path_history.hpp>
+
+namespace {
+
+    constexpr double SAMPLE_PERIOD = 0.25, SPEED = 1.0;
+
+    /**
+     * @brief Where the rover is after @p time seconds of driving laps of a 50 m circle, stopping for a minute after each lap.
+     */
+    geometry_msgs::PoseStamped poseAt(double time) {
+        constexpr double RADIUS = 50, LAP_TIME = 2 * M_PI * RADIUS / SPEED, STOP_TIME = 60;
+        double lapTime = std::fmod(time, LAP_TIME + STOP_TIME);
+        double angle = std::min(lapTime, LAP_TIME) * SPEED / RADIUS;
+        geometry_msgs::PoseStamped pose;
+        pose.header.frame_id = "map";
+        pose.header.stamp = ros::Time{static_cast<uint32_t>(time), 0};
+        pose.pose.position.x = RADIUS * std::cos(angle);
+        pose.pose.position.y = RADIUS * std::sin(angle);
+        double yaw = angle + M_PI_2;
+        pose.pose.orientation.z = std::sin(yaw / 2);
+        pose.pose.orientation.w = std::cos(yaw / 2);
+        return pose;
+    }
+
+    /**
+     * @brief Times filling and serializing the path at every publish, grouped by the hour of simulated time it happened in.
+     *
+     * @param publish   Called with every sample, returns the message to serialize
+     * @param every     Only every this many publishes are timed, the path still sees every sample
+     */
+    template<typename F>
+    void run(std::string const& name, size_t hours, size_t every, F&& publish) {
+        size_t samplesPerHour = static_cast<size_t>(3600 / SAMPLE_PERIOD);
+        for (size_t hour = 0; hour < hours; ++hour) {
+            std::vector<double> milliseconds;
+            for (size_t sample = 0; sample < samplesPerHour; ++sample) {
+                double time = static_cast<double>(hour * samplesPerHour + sample) * SAMPLE_PERIOD;
+                geometry_msgs::PoseStamped pose = poseAt(time);
+                if (sample % every != 0) {
+                    publish(pose, false);
+                    continue;
+                }
+
+                mrover::bench::Clock::time_point begin = mrover::bench::Clock::now();
+                publish(pose, true);
+                milliseconds.push_back(std::chrono::duration<double, std::milli>(mrover::bench::Clock::now() - begin).count());
+            }
+            mrover::bench::print(name + " hour " + std::to_string(hour + 1), mrover::bench::summarize(milliseconds));
+        }
+    }
+
+} // namespace
+
+/**
+ * @brief Publishes the ground truth path of a simulated run at 4 Hz the way the drive plugin used to and with the path history.
+ *
+ * Usage: path_history_benchmark [hours] [every]
+ */
+int main(int argc, char** argv) {
+    size_t hours = argc > 1 ? std::stoul(argv[1]) : 4;
+    size_t every = argc > 2 ? std::stoul(argv[2]) : 60;
+
+    mrover::bench::printHeader();
+
+    // Every sample appended and the whole path serialized
+    nav_msgs::Path unbounded;
+    run("unbounded", hours, every, [&](geometry_msgs::PoseStamped const& pose, bool isTimed) {
+        unbounded.poses.push_back(pose);
+        if (isTimed) [[maybe_unused]] ros::SerializedMessage serialized = ros::serialization::serializeMessage(unbounded);
+    });
+
+    for (bool isIncremental: {false, true}) {
+        mrover::PathHistory history{4096, 0.1, 0.1};
+        nav_msgs::Path path;
+        uint64_t publishedEnd = 0;
+        run(isIncremental ? "incremental" : "ring buffer", hours, every, [&](geometry_msgs::PoseStamped const& pose, bool isTimed) {
+            if (!history.add(pose) || !isTimed) return;
+
+            history.fill(path, isIncremental && publishedEnd > 0 ? publishedEnd - 1 : 0);
+            publishedEnd = history.end();
+            [[maybe_unused]] ros::SerializedMessage serialized = ros::serialization::serializeMessage(path);
+        });
+    }
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,152 @@
+#include <array>
+#include <cstdlib>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <bench.hpp>
+#include <filter.hpp>
+
+namespace {
+
+    constexpr size_t PUSHES_PER_SAMPLE = 1000;
+
+    /**
+     * @brief The filter as it was before it kept its values sorted, copying and sorting them on every push.
+     */
+    template<typename T>
+    class ResortingMeanMedianFilter {
+        std::vector<T> mValues, mSortedValues;
+        double mProportion;
+        size_t mFilterCount = 0, mHead = 0;
+
+    public:
+        ResortingMeanMedianFilter(size_t size, double centerProportion) : mValues(size), mSortedValues(size), mProportion(centerProportion) {}
+
+        void push(T value) {
+            mHead = (mHead + 1) % mValues.size();
+            mValues[mHead] = value;
+            mFilterCount = std::min(mFilterCount + 1, mValues.size());
+            mSortedValues.assign(mValues.begin(), mValues.end());
+            std::sort(mSortedValues.begin(), mSortedValues.end());
+        }
+
+        [[nodiscard]] T get() const {
+            if (mFilterCount != mValues.size()) return mValues[mHead];
+
+            auto begin = mSortedValues.begin() + static_cast<std::ptrdiff_t>(mProportion * static_cast<double>(mValues.size()) / 4);
+            auto end = mSortedValues.end() - static_cast<std::ptrdiff_t>(mProportion * static_cast<double>(mValues.size()) / 4);
+            return std::accumulate(begin, end, T{}) / (end - begin);
+        }
+    };
+
+    /**
+     * @brief Times a push and a get per reading, like a sensor callback, in batches since one is too short for the clock to resolve.
+     */
+    template<typename Filter, typename T>
+    mrover::bench::Stats measureFilter(size_t window, std::vector<T> const& readings, size_t batches) {
+        Filter filter{window, 0.5};
+        size_t next = 0;
+        T sink{};
+        auto batch = [&] {
+            for (size_t i = 0; i < PUSHES_PER_SAMPLE; ++i) {
+                filter.push(readings[next]);
+                next = (next + 1) % readings.size();
+                sink += filter.get();
+            }
+        };
+        mrover::bench::Stats stats = mrover::bench::measure(batch, batches, window / PUSHES_PER_SAMPLE + 1);
+        // Keeps the gets from being optimized away
+        if (sink == T{1234567}) std::printf(" ");
+        return stats;
+    }
+
+    template<typename T, typename Distribution>
+    void compare(std::string const& type, Distribution distribution, size_t batches) {
+        std::mt19937 generator{42};
+        std::vector<T> readings(1 << 16);
+        for (T& reading: readings) reading = static_cast<T>(distribution(generator));
+
+        for (size_t window: {10, 30, 100, 300, 1000}) {
+            std::string name = type + " window " + std::to_string(window);
+            mrover::bench::print(name + " resorting", measureFilter<ResortingMeanMedianFilter<T>>(window, readings, batches));
+            mrover::bench::print(name + " incremental", measureFilter<MeanMedianFilter<T>>(window, readings, batches));
+        }
+    }
+
+    /**
+     * @brief Separate filters per channel, how signals read together were filtered before the multi channel filter.
+     */
+    template<typename T, size_t Channels>
+    class ScalarFilters {
+        std::vector<MeanMedianFilter<T>> mFilters;
+
+    public:
+        ScalarFilters(size_t size, double centerProportion) : mFilters(Channels, MeanMedianFilter<T>{size, centerProportion}) {}
+
+        void push(std::array<T, Channels> const& reading) {
+            for (size_t channel = 0; channel < Channels; ++channel) mFilters[channel].push(reading[channel]);
+        }
+
+        [[nodiscard]] std::array<T, Channels> get() const {
+            std::array<T, Channels> filtered;
+            for (size_t channel = 0; channel < Channels; ++channel) filtered[channel] = mFilters[channel].get();
+            return filtered;
+        }
+    };
+
+    template<typename Filter, typename T, size_t Channels>
+    mrover::bench::Stats measureChannels(size_t window, std::vector<std::array<T, Channels>> const& readings, size_t batches) {
+        Filter filter{window, 0.5};
+        size_t next = 0;
+        T sink{};
+        auto batch = [&] {
+            for (size_t i = 0; i < PUSHES_PER_SAMPLE; ++i) {
+                filter.push(readings[next]);
+                next = (next + 1) % readings.size();
+                for (T value: filter.get()) sink += value;
+            }
+        };
+        mrover::bench::Stats stats = mrover::bench::measure(batch, batches, window / PUSHES_PER_SAMPLE + 1);
+        if (sink == T{1234567}) std::printf(" ");
+        return stats;
+    }
+
+    template<size_t Channels>
+    void compareChannels(size_t batches) {
+        std::mt19937 generator{42};
+        std::normal_distribution<float> distribution{0, 1};
+        std::vector<std::array<float, Channels>> readings(1 << 14);
+        for (std::array<float, Channels>& reading: readings) {
+            for (float& value: reading) value = distribution(generator);
+        }
+
+        for (size_t window: {10, 30, 100}) {
+            std::string name = std::to_string(Channels) + " channels window " + std::to_string(window);
+            mrover::bench::print(name + " separate", measureChannels<ScalarFilters<float, Channels>>(window, readings, batches));
+            mrover::bench::print(name + " multi channel", measureChannels<MultiChannelMeanMedianFilter<float, Channels>>(window, readings, batches));
+        }
+    }
+
+} // namespace
+
+/**
+ * @brief Compares the mean median filter against re-sorting the whole window on every push,
+ *        and the multi channel filter against a filter per channel.
+ *
+ * Each sample is a thousand pushes, each followed by a get.
+ *
+ * Usage: filter_benchmark [batches]
+ */
+int main(int argc, char** argv) {
+    size_t batches = argc > 1 ? std::stoul(argv[1]) : 50;
+
+    std::printf("Milliseconds per %zu pushes and gets\n", PUSHES_PER_SAMPLE);
+    mrover::bench::printHeader();
+    compare<float>("float", std::normal_distribution<float>{0, 1}, batches);
+    compare<int>("int", std::uniform_int_distribution<int>{-1000, 1000}, batches);
+    compareChannels<4>(batches);
+    compareChannels<12>(batches);
+    compareChannels<32>(batches);
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,92 @@
+#include <cstdlib>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <bench.hpp>
+#include <loop_profiler.hpp>
+#include <loop_profiler_trace.hpp>
+
+namespace {
+
+    using mrover::bench::Clock;
+
+    constexpr size_t CALLS_PER_SAMPLE = 1000;
+
+    /**
+     * @brief Times batches of calls, a single one is too short for the clock to resolve.
+     */
+    template<typename F>
+    mrover::bench::Stats measureBatches(F&& function, size_t batches) {
+        auto batch = [&] {
+            for (size_t i = 0; i < CALLS_PER_SAMPLE; ++i) function();
+        };
+        return mrover::bench::measure(batch, batches);
+    }
+
+    void printPerCall(std::string const& name, mrover::bench::Stats const& stats) {
+        // Milliseconds per thousand calls are microseconds per call, scale once more to get nanoseconds
+        double scale = 1e6 / static_cast<double>(CALLS_PER_SAMPLE);
+        std::printf("%-40s %10.1f %10.1f %10.1f %10.1f %10.1f\n", name.c_str(),
+                    stats.mean * scale, stats.p50 * scale, stats.p95 * scale, stats.p99 * scale, stats.max * scale);
+    }
+
+} // namespace
+
+/**
+ * @brief Measures what the loop profiler adds to each event, against reading the clock alone.
+ *
+ * Usage: loop_profiler_benchmark [batches] [threads]
+ */
+int main(int argc, char** argv) {
+    size_t batches = argc > 1 ? std::stoul(argv[1]) : 2000;
+    size_t threadCount = argc > 2 ? std::stoul(argv[2]) : 1;
+
+    std::printf("%-40s %10s %10s %10s %10s %10s\n", "Benchmark", "mean (ns)", "p50", "p95", "p99", "max");
+
+    Clock::time_point sink;
+    printPerCall("Clock::now", measureBatches([&] { sink = std::max(sink, Clock::now()); }, batches));
+
+    LoopProfiler profiler{"Benchmark"};
+    printPerCall("measureEvent by name", measureBatches([&] { profiler.measureEvent("Event"); }, batches));
+
+    LoopProfiler::EventId id = profiler.intern("Interned");
+    printPerCall("measureEvent by id", measureBatches([&] { profiler.measureEvent(id); }, batches));
+
+    auto loop = [&] {
+        profiler.beginLoop();
+        profiler.measureEvent("First");
+        profiler.measureEvent("Second");
+        profiler.measureEvent("Third");
+    };
+    printPerCall("beginLoop and three events", measureBatches(loop, batches));
+
+    // Other threads recording at the same time should not slow this one down, each writes its own shard
+    std::atomic<bool> done{false};
+    std::vector<std::thread> others;
+    for (size_t t = 1; t < threadCount; ++t) {
+        others.emplace_back([&] {
+            while (!done) profiler.measureEvent("Other");
+        });
+    }
+    printPerCall("measureEvent with " + std::to_string(threadCount) + " threads", measureBatches([&] { profiler.measureEvent(id); }, batches));
+    done = true;
+    for (std::thread& thread: others) thread.join();
+
+    profiler.setTracing(true);
+    printPerCall("measureEvent while tracing", measureBatches([&] { profiler.measureEvent(id); }, batches));
+    profiler.setTracing(false);
+
+    mrover::bench::Stats report = mrover::bench::measure([&] { (void) profiler.report(); }, batches);
+    // Every ring is full by now
+    auto writeTrace = [&] {
+        std::ostringstream stream;
+        writeChromeTrace(stream, {&profiler});
+    };
+    mrover::bench::Stats trace = mrover::bench::measure(writeTrace, 10, 1);
+    mrover::bench::printHeader();
+    mrover::bench::print("report", report);
+    mrover::bench::print("writeChromeTrace", trace);
+    return sink == Clock::time_point{} ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,70 @@
+#include <cstdlib>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <bench.hpp>
+#include <point.hpp>
+#include <se3.hpp>
+
+namespace {
+
+    template<typename PointT>
+    std::vector<PointT> makeCloud(size_t count) {
+        std::mt19937 generator{42};
+        std::uniform_real_distribution<float> coordinate{-20, 20};
+        std::vector<PointT> cloud(count);
+        for (PointT& point: cloud) {
+            point.x = coordinate(generator);
+            point.y = coordinate(generator);
+            point.z = coordinate(generator);
+        }
+        return cloud;
+    }
+
+    /**
+     * @brief How a cloud was transformed before the batch API, one double precision vector at a time.
+     */
+    template<typename PointT>
+    void applyPerPoint(SE3 const& transform, std::vector<PointT>& cloud) {
+        Eigen::Matrix4d matrix = transform.matrix();
+        for (PointT& point: cloud) {
+            R3 position = (matrix * Eigen::Vector4d{point.x, point.y, point.z, 1}).head<3>();
+            point.x = static_cast<float>(position.x());
+            point.y = static_cast<float>(position.y());
+            point.z = static_cast<float>(position.z());
+        }
+    }
+
+    template<typename PointT>
+    void compare(std::string const& name, SE3 const& transform, size_t count, size_t iterations) {
+        std::vector<PointT> cloud = makeCloud<PointT>(count);
+        mrover::bench::print(name + " per point", mrover::bench::measure([&] { applyPerPoint(transform, cloud); }, iterations));
+        mrover::bench::print(name + " apply", mrover::bench::measure([&] { transform.apply(cloud.data(), cloud.size()); }, iterations));
+    }
+
+} // namespace
+
+/**
+ * @brief Transforms a cloud the size of the ZED at HD720 into another frame, like moving it into odom.
+ *
+ * Usage: se3_benchmark [iterations] [points]
+ */
+int main(int argc, char** argv) {
+    size_t iterations = argc > 1 ? std::stoul(argv[1]) : 50;
+    size_t count = argc > 2 ? std::stoul(argv[2]) : 1280 * 720;
+
+    SE3 cameraInOdom{R3{1.5, -2, 0.25}, Eigen::Quaterniond{0.6532815, 0.2705981, 0.6532815, 0.2705981}.normalized()};
+
+    std::printf("Milliseconds to transform %zu points\n", count);
+    mrover::bench::printHeader();
+    compare<mrover::PointXYZRGB>("xyzrgb", cameraInOdom, count, iterations);
+    compare<mrover::Point>("with normals", cameraInOdom, count, iterations);
+
+    std::vector<float> xyz(count * 3);
+    std::mt19937 generator{42};
+    std::uniform_real_distribution<float> coordinate{-20, 20};
+    for (float& value: xyz) value = coordinate(generator);
+    mrover::bench::print("packed floats apply", mrover::bench::measure([&] { cameraInOdom.apply(xyz.data(), count); }, iterations));
+    return EXIT_SUCCESS;
+}
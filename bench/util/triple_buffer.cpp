@@ -0,0 +1,176 @@
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstdlib>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include <bench.hpp>
+#include <triple_buffer.hpp>
+
+namespace {
+
+    using mrover::bench::Clock;
+
+    struct Frame {
+        uint64_t sequence = 0;
+        Clock::time_point publishedAt;
+        std::vector<uint8_t> payload;
+    };
+
+    struct Config {
+        double producerPeriodMs;
+        double consumerWorkMs;
+        size_t payloadBytes;
+        double durationS;
+    };
+
+    struct Result {
+        std::vector<double> handoffMs; // Time the producer spends handing a frame off
+        std::vector<double> latencyMs; // Time from a frame being filled to the consumer starting on it
+        size_t produced = 0, consumed = 0;
+        double staleSum = 0; // Newer frames that already existed when the consumer started on a frame
+    };
+
+    void spinFor(double ms) {
+        Clock::time_point end = Clock::now() + std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double, std::milli>{ms});
+        while (Clock::now() < end) {}
+    }
+
+    double millisecondsSince(Clock::time_point begin) {
+        return std::chrono::duration<double, std::milli>(Clock::now() - begin).count();
+    }
+
+    /**
+     * @brief Shared producer loop, @p handoff fills the frame with the given sequence number and hands it to the consumer.
+     */
+    template<typename F>
+    void produce(Config const& config, std::atomic<uint64_t>& latest, Result& result, F&& handoff) {
+        Clock::time_point end = Clock::now() + std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>{config.durationS});
+        Clock::time_point next = Clock::now();
+        for (uint64_t sequence = 1; Clock::now() < end; ++sequence) {
+            // Like a camera, frames come at a fixed rate whatever the consumer does
+            while (Clock::now() < next) {}
+            next += std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double, std::milli>{config.producerPeriodMs});
+
+            latest.store(sequence, std::memory_order_release);
+            Clock::time_point begin = Clock::now();
+            handoff(sequence);
+            result.handoffMs.push_back(millisecondsSince(begin));
+            ++result.produced;
+        }
+    }
+
+    void consumeFrame(Config const& config, Frame const& frame, std::atomic<uint64_t> const& latest, Result& result) {
+        result.latencyMs.push_back(millisecondsSince(frame.publishedAt));
+        result.staleSum += static_cast<double>(latest.load(std::memory_order_acquire) - frame.sequence);
+        ++result.consumed;
+        spinFor(config.consumerWorkMs);
+    }
+
+    void fill(Frame& frame, uint64_t sequence, size_t payloadBytes) {
+        frame.sequence = sequence;
+        frame.payload.resize(payloadBytes);
+        std::fill(frame.payload.begin(), frame.payload.end(), static_cast<uint8_t>(sequence));
+        frame.publishedAt = Clock::now();
+    }
+
+    /**
+     * @brief The previous ZED handoff: the producer swaps only if it wins a try lock, the consumer holds the lock while it works.
+     */
+    Result runMutexSwap(Config const& config) {
+        Result result;
+        std::atomic<uint64_t> latest{0};
+        Frame grabFrame, consumerFrame;
+        std::mutex swapMutex;
+        std::condition_variable swapCv;
+        bool isSwapReady = false, isDone = false;
+
+        std::thread consumer{[&] {
+            while (true) {
+                std::unique_lock lock{swapMutex};
+                swapCv.wait(lock, [&] { return isSwapReady || isDone; });
+                if (!isSwapReady) break;
+                isSwapReady = false;
+                consumeFrame(config, consumerFrame, latest, result);
+            }
+        }};
+
+        produce(config, latest, result, [&](uint64_t sequence) {
+            fill(grabFrame, sequence, config.payloadBytes);
+            if (swapMutex.try_lock()) {
+                std::swap(grabFrame, consumerFrame);
+                isSwapReady = true;
+                swapMutex.unlock();
+                swapCv.notify_one();
+            }
+        });
+        {
+            std::scoped_lock lock{swapMutex};
+            isDone = true;
+        }
+        swapCv.notify_one();
+        consumer.join();
+        return result;
+    }
+
+    Result runTripleBuffer(Config const& config) {
+        Result result;
+        std::atomic<uint64_t> latest{0};
+        TripleBuffer<Frame> buffer;
+
+        std::thread consumer{[&] {
+            while (buffer.waitAndConsume()) {
+                consumeFrame(config, buffer.front(), latest, result);
+            }
+        }};
+
+        produce(config, latest, result, [&](uint64_t sequence) {
+            Frame& frame = buffer.back();
+            fill(frame, sequence, config.payloadBytes);
+            buffer.publish();
+        });
+        buffer.close();
+        consumer.join();
+        return result;
+    }
+
+    void report(std::string const& name, Result& result) {
+        mrover::bench::print(name + " handoff", mrover::bench::summarize(result.handoffMs));
+        mrover::bench::print(name + " fill to consume", mrover::bench::summarize(result.latencyMs));
+    }
+
+} // namespace
+
+/**
+ * @brief Compares a mutex guarded swap against the triple buffer for handing frames from a fixed rate producer to a slower consumer.
+ *
+ * Only needs a CPU, the producer stands in for the ZED grab thread and the consumer for the point cloud thread.
+ *
+ * Usage: triple_buffer_benchmark [producer period ms] [consumer work ms] [payload bytes] [duration s]
+ */
+int main(int argc, char** argv) {
+    Config config{
+            argc > 1 ? std::stod(argv[1]) : 1000.0 / 60,
+            argc > 2 ? std::stod(argv[2]) : 25.0,
+            argc > 3 ? std::stoul(argv[3]) : size_t{1} << 20,
+            argc > 4 ? std::stod(argv[4]) : 5.0,
+    };
+    std::printf("Producer period: %.2f ms, consumer work: %.2f ms, payload: %zu bytes, duration: %.1f s\n",
+                config.producerPeriodMs, config.consumerWorkMs, config.payloadBytes, config.durationS);
+
+    Result mutexSwap = runMutexSwap(config);
+    Result tripleBuffer = runTripleBuffer(config);
+
+    mrover::bench::printHeader();
+    report("Mutex swap", mutexSwap);
+    report("Triple buffer", tripleBuffer);
+    for (auto const& [name, result]: {std::pair{"Mutex swap", &mutexSwap}, std::pair{"Triple buffer", &tripleBuffer}}) {
+        std::printf("%s: consumed %zu of %zu frames, %.2f newer frames already waiting on average\n",
+                    name, result->consumed, result->produced, result->consumed ? result->staleSum / static_cast<double>(result->consumed) : 0.0);
+    }
+    return EXIT_SUCCESS;
+}
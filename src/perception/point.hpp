@@ -1,11 +1,30 @@
 #pragma once
 
+// Be careful what you include in this file, it is compiled with nvcc (NVIDIA CUDA compiler) as C++17
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <type_traits>
+
+#include <sensor_msgs/PointCloud2.h>
+
+#ifdef __CUDACC__
+#define MROVER_HOST_DEVICE __host__ __device__
+#else
+#define MROVER_HOST_DEVICE
+#endif
+
 namespace mrover {
 
     /**
-     * @brief Defines one element in the point cloud
+     * @brief Defines one element in the point cloud, the full layout with normals.
      *
-     * This definition HAS to match the below function which fills in the header.
+     * Every layout HAS to match its #PointLayout specialization below, which describes it in the message header.
+     * All layouts store color as packed BGRA bytes named "rgb", by convention rgb is stored as float32 even though it is three bytes.
      */
     struct Point {
         float x, y, z;
@@ -14,18 +33,260 @@ namespace mrover {
         float curvature;
     } __attribute__((packed));
 
-    inline void fillPointCloudMessageHeader(sensor_msgs::PointCloud2Ptr const& msg) {
-        sensor_msgs::PointCloud2Modifier modifier{*msg};
-        modifier.setPointCloud2Fields(
-                8,
-                "x", 1, sensor_msgs::PointField::FLOAT32,
-                "y", 1, sensor_msgs::PointField::FLOAT32,
-                "z", 1, sensor_msgs::PointField::FLOAT32,
-                "rgb", 1, sensor_msgs::PointField::FLOAT32, // by convention rgb is stored as float32 even thought it is three bytes
-                "normal_x", 1, sensor_msgs::PointField::FLOAT32,
-                "normal_y", 1, sensor_msgs::PointField::FLOAT32,
-                "normal_z", 1, sensor_msgs::PointField::FLOAT32,
-                "curvature", 1, sensor_msgs::PointField::FLOAT32);
+    /**
+     * @brief Position and color only, half the size of #Point.
+     */
+    struct PointXYZRGB {
+        float x, y, z;
+        uint8_t b, g, r, a;
+    } __attribute__((packed));
+
+    /**
+     * @brief Position as IEEE 754 half floats and color.
+     *
+     * Half floats keep about a millimeter of precision at a meter and a centimeter at ten meters.
+     * PointField has no half float type, so the position is described as UINT16 fields with their own names.
+     * Generic tools will not mistake it for a float position, use #getPosition to read it.
+     */
+    struct PointXYZHalfRGB {
+        uint16_t x, y, z;
+        uint8_t b, g, r, a;
+    } __attribute__((packed));
+
+    static_assert(sizeof(Point) == 32);
+    static_assert(sizeof(PointXYZRGB) == 16);
+    static_assert(sizeof(PointXYZHalfRGB) == 10);
+
+    struct PointFieldDescription {
+        char const* name;
+        uint32_t offset;
+        uint8_t datatype;
+    };
+
+    template<typename PointT>
+    struct PointLayout;
+
+    template<>
+    struct PointLayout<Point> {
+        static constexpr std::array<PointFieldDescription, 8> FIELDS{{
+                {"x", offsetof(Point, x), sensor_msgs::PointField::FLOAT32},
+                {"y", offsetof(Point, y), sensor_msgs::PointField::FLOAT32},
+                {"z", offsetof(Point, z), sensor_msgs::PointField::FLOAT32},
+                {"rgb", offsetof(Point, b), sensor_msgs::PointField::FLOAT32},
+                {"normal_x", offsetof(Point, normal_x), sensor_msgs::PointField::FLOAT32},
+                {"normal_y", offsetof(Point, normal_y), sensor_msgs::PointField::FLOAT32},
+                {"normal_z", offsetof(Point, normal_z), sensor_msgs::PointField::FLOAT32},
+                {"curvature", offsetof(Point, curvature), sensor_msgs::PointField::FLOAT32},
+        }};
+    };
+
+    template<>
+    struct PointLayout<PointXYZRGB> {
+        static constexpr std::array<PointFieldDescription, 4> FIELDS{{
+                {"x", offsetof(PointXYZRGB, x), sensor_msgs::PointField::FLOAT32},
+                {"y", offsetof(PointXYZRGB, y), sensor_msgs::PointField::FLOAT32},
+                {"z", offsetof(PointXYZRGB, z), sensor_msgs::PointField::FLOAT32},
+                {"rgb", offsetof(PointXYZRGB, b), sensor_msgs::PointField::FLOAT32},
+        }};
+    };
+
+    template<>
+    struct PointLayout<PointXYZHalfRGB> {
+        static constexpr std::array<PointFieldDescription, 4> FIELDS{{
+                {"half_x", offsetof(PointXYZHalfRGB, x), sensor_msgs::PointField::UINT16},
+                {"half_y", offsetof(PointXYZHalfRGB, y), sensor_msgs::PointField::UINT16},
+                {"half_z", offsetof(PointXYZHalfRGB, z), sensor_msgs::PointField::UINT16},
+                {"rgb", offsetof(PointXYZHalfRGB, b), sensor_msgs::PointField::FLOAT32},
+        }};
+    };
+
+    /**
+     * @brief Rounds to the nearest half float, ties to even. Out of range values become infinity.
+     */
+    MROVER_HOST_DEVICE inline uint16_t floatToHalf(float value) {
+        uint32_t bits;
+        std::memcpy(&bits, &value, sizeof(bits));
+        auto sign = static_cast<uint16_t>(bits >> 16 & 0x8000);
+        uint32_t exponent = bits >> 23 & 0xFF;
+        uint32_t mantissa = bits & 0x7FFFFF;
+        // Infinity stays infinity and NaN stays NaN
+        if (exponent == 0xFF) return sign | 0x7C00 | (mantissa ? 0x200 : 0);
+
+        int32_t halfExponent = static_cast<int32_t>(exponent) - 127 + 15;
+        if (halfExponent >= 0x1F) return sign | 0x7C00;
+        if (halfExponent <= 0) {
+            // Subnormal half, shift the mantissa with its implicit bit into place
+            if (halfExponent < -10) return sign;
+            mantissa |= 0x800000;
+            uint32_t shift = 14 - halfExponent;
+            uint32_t half = mantissa >> shift;
+            uint32_t remainder = mantissa & ((1u << shift) - 1), halfway = 1u << (shift - 1);
+            if (remainder > halfway || (remainder == halfway && (half & 1))) ++half;
+            return sign | static_cast<uint16_t>(half);
+        }
+
+        uint32_t half = static_cast<uint32_t>(halfExponent) << 10 | mantissa >> 13;
+        uint32_t remainder = mantissa & 0x1FFF;
+        // A carry out of the mantissa correctly bumps the exponent, up to infinity
+        if (remainder > 0x1000 || (remainder == 0x1000 && (half & 1))) ++half;
+        return sign | static_cast<uint16_t>(half);
+    }
+
+    MROVER_HOST_DEVICE inline float halfToFloat(uint16_t half) {
+        uint32_t sign = static_cast<uint32_t>(half & 0x8000) << 16;
+        uint32_t exponent = half >> 10 & 0x1F;
+        uint32_t mantissa = half & 0x3FF;
+        uint32_t bits;
+        if (exponent == 0x1F) {
+            bits = sign | 0x7F800000 | mantissa << 13;
+        } else if (exponent != 0) {
+            bits = sign | (exponent + 127 - 15) << 23 | mantissa << 13;
+        } else if (mantissa == 0) {
+            bits = sign;
+        } else {
+            // Subnormal half, every half is a normal float
+            uint32_t shifts = 0;
+            while (!(mantissa & 0x400)) {
+                mantissa <<= 1;
+                ++shifts;
+            }
+            bits = sign | (127 - 14 - shifts) << 23 | (mantissa & 0x3FF) << 13;
+        }
+        float value;
+        std::memcpy(&value, &bits, sizeof(value));
+        return value;
+    }
+
+    struct PointPosition {
+        float x, y, z;
+    };
+
+    template<typename PointT>
+    MROVER_HOST_DEVICE void setPosition(PointT& point, float x, float y, float z) {
+        point.x = x;
+        point.y = y;
+        point.z = z;
+    }
+
+    MROVER_HOST_DEVICE inline void setPosition(PointXYZHalfRGB& point, float x, float y, float z) {
+        point.x = floatToHalf(x);
+        point.y = floatToHalf(y);
+        point.z = floatToHalf(z);
+    }
+
+    template<typename PointT>
+    MROVER_HOST_DEVICE PointPosition getPosition(PointT const& point) {
+        return {point.x, point.y, point.z};
+    }
+
+    MROVER_HOST_DEVICE inline PointPosition getPosition(PointXYZHalfRGB const& point) {
+        return {halfToFloat(point.x), halfToFloat(point.y), halfToFloat(point.z)};
+    }
+
+    /**
+     * @brief Describes @p PointT in the message and sizes its buffer for width * height points.
+     *
+     * The width and height have to be set beforehand.
+     */
+    template<typename PointT>
+    void fillPointCloudMessageHeader(sensor_msgs::PointCloud2& msg) {
+        auto const& fields = PointLayout<PointT>::FIELDS;
+        msg.fields.resize(fields.size());
+        for (size_t i = 0; i < fields.size(); ++i) {
+            msg.fields[i].name = fields[i].name;
+            msg.fields[i].offset = fields[i].offset;
+            msg.fields[i].datatype = fields[i].datatype;
+            msg.fields[i].count = 1;
+        }
+        msg.is_bigendian = __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__;
+        msg.point_step = sizeof(PointT);
+        msg.row_step = msg.point_step * msg.width;
+        msg.data.resize(static_cast<size_t>(msg.row_step) * msg.height);
+    }
+
+    /**
+     * @return Whether the message header describes exactly @p PointT, extra fields in the padding are not allowed
+     */
+    template<typename PointT>
+    bool hasPointLayout(sensor_msgs::PointCloud2 const& msg) {
+        if (msg.point_step != sizeof(PointT) || msg.is_bigendian != (__BYTE_ORDER__ == __ORDER_BIG_ENDIAN__)) return false;
+
+        auto const& fields = PointLayout<PointT>::FIELDS;
+        if (msg.fields.size() != fields.size()) return false;
+        return std::all_of(fields.begin(), fields.end(), [&](PointFieldDescription const& expected) {
+            auto it = std::find_if(msg.fields.begin(), msg.fields.end(), [&](sensor_msgs::PointField const& field) { return field.name == expected.name; });
+            return it != msg.fields.end() && it->offset == expected.offset && it->datatype == expected.datatype && it->count == 1;
+        });
+    }
+
+    /**
+     * @brief Typed access to the points of an organized point cloud message, checked against the layout once up front.
+     *
+     * Producers use a mutable view over a message they filled the header of, consumers a const view (@p PointT is const).
+     * The view does not own the message, which has to outlive it.
+     */
+    template<typename PointT>
+    class PointCloudView {
+    public:
+        using Layout = std::remove_const_t<PointT>;
+        using Message = std::conditional_t<std::is_const_v<PointT>, sensor_msgs::PointCloud2 const, sensor_msgs::PointCloud2>;
+
+    private:
+        PointT* mPoints;
+        uint32_t mWidth, mHeight;
+
+    public:
+        [[nodiscard]] static bool isCompatible(sensor_msgs::PointCloud2 const& msg) {
+            return hasPointLayout<Layout>(msg) &&
+                   msg.row_step == msg.width * msg.point_step &&
+                   msg.data.size() >= static_cast<size_t>(msg.row_step) * msg.height;
+        }
+
+        /**
+         * @throws std::invalid_argument If the message does not hold contiguous points of type @p PointT
+         */
+        explicit PointCloudView(Message& msg) : mWidth{msg.width}, mHeight{msg.height} {
+            if (!isCompatible(msg)) throw std::invalid_argument{"Point cloud message does not match the point layout"};
+
+            mPoints = reinterpret_cast<PointT*>(msg.data.data());
+        }
+
+        [[nodiscard]] uint32_t width() const { return mWidth; }
+
+        [[nodiscard]] uint32_t height() const { return mHeight; }
+
+        [[nodiscard]] size_t size() const { return static_cast<size_t>(mWidth) * mHeight; }
+
+        [[nodiscard]] PointT* data() const { return mPoints; }
+
+        [[nodiscard]] PointT* row(uint32_t v) const { return mPoints + static_cast<size_t>(v) * mWidth; }
+
+        [[nodiscard]] PointT& operator()(uint32_t u, uint32_t v) const { return row(v)[u]; }
+
+        [[nodiscard]] PointT& operator[](size_t i) const { return mPoints[i]; }
+
+        [[nodiscard]] PointT* begin() const { return mPoints; }
+
+        [[nodiscard]] PointT* end() const { return mPoints + size(); }
+    };
+
+    /**
+     * @brief Calls @p f with a const view of the message in whichever known layout it has.
+     *
+     * @return Whether the layout was known, @p f is not called otherwise
+     */
+    template<typename F>
+    bool visitPointCloud(sensor_msgs::PointCloud2 const& msg, F&& f) {
+        if (PointCloudView<Point const>::isCompatible(msg)) {
+            f(PointCloudView<Point const>{msg});
+        } else if (PointCloudView<PointXYZRGB const>::isCompatible(msg)) {
+            f(PointCloudView<PointXYZRGB const>{msg});
+        } else if (PointCloudView<PointXYZHalfRGB const>::isCompatible(msg)) {
+            f(PointCloudView<PointXYZHalfRGB const>{msg});
+        } else {
+            return false;
+        }
+        return true;
     }
 
 } // namespace mrover
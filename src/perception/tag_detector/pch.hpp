@@ -1,14 +1,22 @@
 #pragma once
 
 #include <algorithm>
+#include <array>
 #include <cassert>
 #include <cmath>
+#include <condition_variable>
 #include <cstdint>
+#include <cstring>
+#include <deque>
 #include <execution>
 #include <limits>
+#include <memory>
+#include <mutex>
 #include <numeric>
 #include <optional>
+#include <ranges>
 #include <string>
+#include <thread>
 #include <type_traits>
 #include <unordered_map>
 
@@ -19,8 +27,12 @@
 #include <opencv2/imgproc.hpp>
 
 #include <dynamic_reconfigure/server.h>
+#include <message_filters/subscriber.h>
+#include <message_filters/sync_policies/approximate_time.h>
+#include <message_filters/synchronizer.h>
 #include <nodelet/loader.h>
 #include <nodelet/nodelet.h>
+#include <sensor_msgs/CameraInfo.h>
 #include <sensor_msgs/Image.h>
 #include <sensor_msgs/PointCloud2.h>
 #include <sensor_msgs/image_encodings.h>
@@ -33,4 +45,6 @@
 #include <mrover/DetectorParamsConfig.h>
 
 #include <loop_profiler.hpp>
+#include <loop_profiler_reporter.hpp>
+#include <message_pool.hpp>
 #include <se3.hpp>
@@ -0,0 +1,143 @@
+#include "tag_detector.hpp"
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+#include <tbb/blocked_range.h>
+#include <tbb/parallel_for.h>
+
+namespace mrover {
+
+    // Fixed point coefficients OpenCV uses for COLOR_BGR2GRAY, matching them keeps the output bit-exact with cvtColor
+    constexpr int GRAY_SHIFT = 14;
+    constexpr int B2Y = 1868, G2Y = 9617, R2Y = 4899;
+
+    /**
+     * @brief Reads the packed BGRA bytes out of a point without touching the rest of it.
+     */
+    template<typename PointT>
+    [[nodiscard]] uint32_t loadBgra(PointT const& point) {
+        uint32_t bgra;
+        std::memcpy(&bgra, reinterpret_cast<uint8_t const*>(&point) + offsetof(PointT, b), sizeof(bgra));
+        return bgra;
+    }
+
+    [[nodiscard]] constexpr uint8_t grayFromBgr(uint32_t b, uint32_t g, uint32_t r) {
+        return static_cast<uint8_t>((b * B2Y + g * G2Y + r * R2Y + (1 << (GRAY_SHIFT - 1))) >> GRAY_SHIFT);
+    }
+
+    inline void storeBgr(uint8_t* bgr, uint32_t bgra) {
+        bgr[0] = bgra & 0xFF;
+        bgr[1] = bgra >> 8 & 0xFF;
+        bgr[2] = bgra >> 16 & 0xFF;
+    }
+
+    /**
+     * @brief Converts one row of points, returns how many points were handled so the caller can finish the tail.
+     */
+    template<bool WithBgr, typename PointT>
+    size_t convertRowSimd([[maybe_unused]] PointT const* points, [[maybe_unused]] size_t count, [[maybe_unused]] uint8_t* gray, [[maybe_unused]] uint8_t* bgr) {
+        [[maybe_unused]] constexpr size_t LANES = 16;
+
+        size_t i = 0;
+#if defined(__SSE2__)
+        __m128i const coefficients = _mm_setr_epi16(B2Y, G2Y, R2Y, 0, B2Y, G2Y, R2Y, 0);
+        __m128i const rounding = _mm_set1_epi32(1 << (GRAY_SHIFT - 1));
+        __m128i const zero = _mm_setzero_si128();
+        // Four BGRA words in, four gray values out as 32 bit integers
+        auto grayQuad = [&](size_t j) {
+            uint32_t w0 = loadBgra(points[j + 0]), w1 = loadBgra(points[j + 1]), w2 = loadBgra(points[j + 2]), w3 = loadBgra(points[j + 3]);
+            if constexpr (WithBgr) {
+                storeBgr(bgr + (j + 0) * 3, w0);
+                storeBgr(bgr + (j + 1) * 3, w1);
+                storeBgr(bgr + (j + 2) * 3, w2);
+                storeBgr(bgr + (j + 3) * 3, w3);
+            }
+            __m128i bgra = _mm_set_epi32(static_cast<int>(w3), static_cast<int>(w2), static_cast<int>(w1), static_cast<int>(w0));
+            // Widen to 16 bits, madd then yields {b*B2Y + g*G2Y, r*R2Y} pairs per pixel
+            __m128i lo = _mm_madd_epi16(_mm_unpacklo_epi8(bgra, zero), coefficients);
+            __m128i hi = _mm_madd_epi16(_mm_unpackhi_epi8(bgra, zero), coefficients);
+            __m128 loPs = _mm_castsi128_ps(lo), hiPs = _mm_castsi128_ps(hi);
+            __m128i evens = _mm_castps_si128(_mm_shuffle_ps(loPs, hiPs, _MM_SHUFFLE(2, 0, 2, 0)));
+            __m128i odds = _mm_castps_si128(_mm_shuffle_ps(loPs, hiPs, _MM_SHUFFLE(3, 1, 3, 1)));
+            return _mm_srli_epi32(_mm_add_epi32(_mm_add_epi32(evens, odds), rounding), GRAY_SHIFT);
+        };
+        for (; i + LANES <= count; i += LANES) {
+            __m128i g0 = grayQuad(i + 0), g1 = grayQuad(i + 4), g2 = grayQuad(i + 8), g3 = grayQuad(i + 12);
+            __m128i packed = _mm_packus_epi16(_mm_packs_epi32(g0, g1), _mm_packs_epi32(g2, g3));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(gray + i), packed);
+        }
+#elif defined(__ARM_NEON)
+        for (; i + LANES <= count; i += LANES) {
+            std::array<uint32_t, LANES> words;
+            for (size_t j = 0; j < LANES; ++j) words[j] = loadBgra(points[i + j]);
+            // De-interleave into separate 16 wide b, g, r, a planes
+            uint8x16x4_t planes = vld4q_u8(reinterpret_cast<uint8_t const*>(words.data()));
+            if constexpr (WithBgr) {
+                vst3q_u8(bgr + i * 3, uint8x16x3_t{{planes.val[0], planes.val[1], planes.val[2]}});
+            }
+            auto grayHalf = [](uint8x8_t b, uint8x8_t g, uint8x8_t r) {
+                uint16x8_t b16 = vmovl_u8(b), g16 = vmovl_u8(g), r16 = vmovl_u8(r);
+                uint32x4_t lo = vmull_n_u16(vget_low_u16(b16), B2Y);
+                lo = vmlal_n_u16(lo, vget_low_u16(g16), G2Y);
+                lo = vmlal_n_u16(lo, vget_low_u16(r16), R2Y);
+                uint32x4_t hi = vmull_n_u16(vget_high_u16(b16), B2Y);
+                hi = vmlal_n_u16(hi, vget_high_u16(g16), G2Y);
+                hi = vmlal_n_u16(hi, vget_high_u16(r16), R2Y);
+                // Rounding narrowing shift is exactly (x + (1 << 13)) >> 14
+                return vmovn_u16(vcombine_u16(vrshrn_n_u32(lo, GRAY_SHIFT), vrshrn_n_u32(hi, GRAY_SHIFT)));
+            };
+            uint8x8_t grayLo = grayHalf(vget_low_u8(planes.val[0]), vget_low_u8(planes.val[1]), vget_low_u8(planes.val[2]));
+            uint8x8_t grayHi = grayHalf(vget_high_u8(planes.val[0]), vget_high_u8(planes.val[1]), vget_high_u8(planes.val[2]));
+            vst1q_u8(gray + i, vcombine_u8(grayLo, grayHi));
+        }
+#endif
+        return i;
+    }
+
+    template<bool WithBgr, typename PointT>
+    void convertRow(PointT const* points, size_t count, uint8_t* gray, uint8_t* bgr) {
+        for (size_t i = convertRowSimd<WithBgr>(points, count, gray, bgr); i < count; ++i) {
+            uint32_t bgra = loadBgra(points[i]);
+            gray[i] = grayFromBgr(bgra & 0xFF, bgra >> 8 & 0xFF, bgra >> 16 & 0xFF);
+            if constexpr (WithBgr) storeBgr(bgr + i * 3, bgra);
+        }
+    }
+
+    /**
+     * @brief Fused point cloud to image conversion, one pass over the cloud instead of a copy followed by cvtColor.
+     *
+     * Rows are split across threads and each row runs a vectorized kernel (SSE2 on x86-64, NEON on ARM).
+     *
+     * @param cloud     Organized point cloud with as many points as there are pixels in @p gray
+     * @param gray      Continuous CV_8UC1 output, bit-exact with cvtColor(..., COLOR_BGR2GRAY)
+     * @param bgr       Optional continuous CV_8UC3 output of the same size, pass null to skip it
+     */
+    template<typename PointT>
+    void pointCloudToGray(PointCloudView<PointT const> const& cloud, cv::Mat& gray, cv::Mat* bgr) {
+        assert(gray.type() == CV_8UC1 && gray.isContinuous());
+        assert(static_cast<uint32_t>(gray.cols) == cloud.width() && static_cast<uint32_t>(gray.rows) == cloud.height());
+        assert(!bgr || (bgr->type() == CV_8UC3 && bgr->isContinuous() && bgr->size() == gray.size()));
+
+        auto const cols = static_cast<size_t>(gray.cols);
+        tbb::parallel_for(tbb::blocked_range<int>{0, gray.rows}, [&](tbb::blocked_range<int> const& rows) {
+            for (int r = rows.begin(); r < rows.end(); ++r) {
+                PointT const* rowPoints = cloud.row(r);
+                uint8_t* rowGray = gray.ptr<uint8_t>(r);
+                if (bgr) {
+                    convertRow<true>(rowPoints, cols, rowGray, bgr->ptr<uint8_t>(r));
+                } else {
+                    convertRow<false>(rowPoints, cols, rowGray, nullptr);
+                }
+            }
+        });
+    }
+
+    template void pointCloudToGray(PointCloudView<Point const> const&, cv::Mat&, cv::Mat*);
+    template void pointCloudToGray(PointCloudView<PointXYZRGB const> const&, cv::Mat&, cv::Mat*);
+    template void pointCloudToGray(PointCloudView<PointXYZHalfRGB const> const&, cv::Mat&, cv::Mat*);
+
+} // namespace mrover
@@ -23,13 +23,15 @@ namespace mrover {
 
         mImgPub = mNh.advertise<sensor_msgs::Image>("tag_detection", 1);
         mDictionary = cv::makePtr<cv::aruco::Dictionary>(cv::aruco::getPredefinedDictionary(dictionaryNumber));
+        mMarkerDetector = MarkerDetector{mDictionary, mDetectorParams};
 
-        mPcSub = mNh.subscribe("camera/left/points", 1, &TagDetectorNodelet::pointCloudCallback, this);
-        mServiceEnableDetections = mNh.advertiseService("enable_detections", &TagDetectorNodelet::enableDetectionsCallback, this);
-
-        // Lambda handles passing class pointer (implicit first parameter) to configCallback
-        mCallbackType = [this](mrover::DetectorParamsConfig& config, uint32_t level) { configCallback(config, level); };
-        mConfigServer.setCallback(mCallbackType);
+        bool useRoiTracking;
+        int roiFullScanPeriod;
+        double roiPaddingRate;
+        mPnh.param<bool>("use_roi_tracking", useRoiTracking, false);
+        mPnh.param<int>("roi_full_scan_period", roiFullScanPeriod, 10);
+        mPnh.param<double>("roi_padding_rate", roiPaddingRate, 0.5);
+        mMarkerDetector.setRoiTracking(useRoiTracking, roiFullScanPeriod, roiPaddingRate);
 
         mPnh.param<double>("adaptiveThreshConstant",
                            mDetectorParams->adaptiveThreshConstant, defaultDetectorParams->adaptiveThreshConstant);
@@ -90,41 +92,105 @@ namespace mrover {
                            mDetectorParams->polygonalApproxAccuracyRate,
                            defaultDetectorParams->polygonalApproxAccuracyRate);
 
+        int pyramidLevels;
+        double pyramidFallbackPerimeterRate;
+        mPnh.param<int>("pyramidLevels", pyramidLevels, 0);
+        mPnh.param<double>("pyramidFallbackPerimeterRate", pyramidFallbackPerimeterRate, 0.15);
+        mMarkerDetector.setPyramid(pyramidLevels, pyramidFallbackPerimeterRate);
+
+        // Stages read the parameters from here on, later changes only reach them through the staged config
+        mThresholdParams = *mDetectorParams;
+        mPendingConfig = {*mDetectorParams, pyramidLevels, pyramidFallbackPerimeterRate};
+
+        // Everything on the callback thread by default, e.g. [0, 1, 2, 2] runs detection and pose estimation on their own threads
+        std::vector<int> stageThreads;
+        int pipelineQueueSize;
+        mPnh.param<std::vector<int>>("pipeline_stage_threads", stageThreads, std::vector<int>(STAGE_COUNT, 0));
+        mPnh.param<int>("pipeline_queue_size", pipelineQueueSize, 1);
+        startPipeline(stageThreads, pipelineQueueSize);
+
+        bool useLoopProfiler, logProfiler, traceProfiler;
+        double profilerPeriod;
+        mPnh.param<bool>("use_loop_profiler", useLoopProfiler, true);
+        mPnh.param<double>("loop_profiler_period", profilerPeriod, 1.0);
+        mPnh.param<bool>("log_loop_profiler", logProfiler, false);
+        mPnh.param<bool>("trace_loop_profiler", traceProfiler, false);
+        if (useLoopProfiler) {
+            std::vector<LoopProfiler*> profilers;
+            for (LoopProfiler& profiler: mStageProfilers) profilers.push_back(&profiler);
+            mProfilerReporter.emplace(mNh, mPnh, std::move(profilers), profilerPeriod, logProfiler, traceProfiler);
+        }
+
+        // Either the point cloud, or an image with its depth which is much smaller to send between processes
+        std::string inputMode;
+        mPnh.param<std::string>("input_mode", inputMode, "point_cloud");
+        if (inputMode == "image_depth") {
+            mImgSub.subscribe(mNh, "camera/left/image", 1);
+            mDepthSub.subscribe(mNh, "camera/left/depth", 1);
+            mCameraInfoSub.subscribe(mNh, "camera/left/camera_info", 1);
+            mImageDepthSync.emplace(ImageDepthPolicy{4}, mImgSub, mDepthSub, mCameraInfoSub);
+            mImageDepthSync->registerCallback(&TagDetectorNodelet::imageDepthCallback, this);
+        } else {
+            if (inputMode != "point_cloud") NODELET_WARN("Unknown input mode \"%s\", using the point cloud", inputMode.c_str());
+            mPcSub = mNh.subscribe("camera/left/points", 1, &TagDetectorNodelet::pointCloudCallback, this);
+        }
+        mServiceEnableDetections = mNh.advertiseService("enable_detections", &TagDetectorNodelet::enableDetectionsCallback, this);
+
+        // Lambda handles passing class pointer (implicit first parameter) to configCallback
+        mCallbackType = [this](mrover::DetectorParamsConfig& config, uint32_t level) { configCallback(config, level); };
+        mConfigServer.setCallback(mCallbackType);
+
         NODELET_INFO("Tag detection ready, use odom frame: %s, min hit count: %d, max hit count: %d, hit increment weight: %d, hit decrement weight: %d", mUseOdom ? "true" : "false", mMinHitCountBeforePublish, mMaxHitCount, mTagIncrementWeight, mTagDecrementWeight);
+        NODELET_INFO("Input mode: %s", inputMode.c_str());
+        NODELET_INFO("ROI tracking: %s, full scan period: %d, padding rate: %f", useRoiTracking ? "true" : "false", roiFullScanPeriod, roiPaddingRate);
     }
 
     void TagDetectorNodelet::configCallback(mrover::DetectorParamsConfig& config, uint32_t level) {
         // Don't load initial config, since it will overwrite the rosparam settings
         if (level == std::numeric_limits<uint32_t>::max()) return;
 
-        mDetectorParams->adaptiveThreshConstant = config.adaptiveThreshConstant;
-        mDetectorParams->adaptiveThreshWinSizeMin = config.adaptiveThreshWinSizeMin;
-        mDetectorParams->adaptiveThreshWinSizeMax = config.adaptiveThreshWinSizeMax;
-        mDetectorParams->adaptiveThreshWinSizeStep = config.adaptiveThreshWinSizeStep;
-        mDetectorParams->cornerRefinementMaxIterations = config.cornerRefinementMaxIterations;
-        mDetectorParams->cornerRefinementMinAccuracy = config.cornerRefinementMinAccuracy;
-        mDetectorParams->cornerRefinementWinSize = config.cornerRefinementWinSize;
+        // Stages may be running on other threads, they pick this up at the start of their next frame
+        std::scoped_lock lock{mConfigMutex};
+        cv::aruco::DetectorParameters& params = mPendingConfig.params;
+        params.adaptiveThreshConstant = config.adaptiveThreshConstant;
+        params.adaptiveThreshWinSizeMin = config.adaptiveThreshWinSizeMin;
+        params.adaptiveThreshWinSizeMax = config.adaptiveThreshWinSizeMax;
+        params.adaptiveThreshWinSizeStep = config.adaptiveThreshWinSizeStep;
+        params.cornerRefinementMaxIterations = config.cornerRefinementMaxIterations;
+        params.cornerRefinementMinAccuracy = config.cornerRefinementMinAccuracy;
+        params.cornerRefinementWinSize = config.cornerRefinementWinSize;
         if (config.doCornerRefinement) {
             if (config.cornerRefinementSubpix) {
-                mDetectorParams->cornerRefinementMethod = cv::aruco::CORNER_REFINE_SUBPIX;
+                params.cornerRefinementMethod = cv::aruco::CORNER_REFINE_SUBPIX;
             } else {
-                mDetectorParams->cornerRefinementMethod = cv::aruco::CORNER_REFINE_CONTOUR;
+                params.cornerRefinementMethod = cv::aruco::CORNER_REFINE_CONTOUR;
             }
         } else {
-            mDetectorParams->cornerRefinementMethod = cv::aruco::CORNER_REFINE_NONE;
+            params.cornerRefinementMethod = cv::aruco::CORNER_REFINE_NONE;
         }
-        mDetectorParams->errorCorrectionRate = config.errorCorrectionRate;
-        mDetectorParams->minCornerDistanceRate = config.minCornerDistanceRate;
-        mDetectorParams->markerBorderBits = config.markerBorderBits;
-        mDetectorParams->maxErroneousBitsInBorderRate = config.maxErroneousBitsInBorderRate;
-        mDetectorParams->minDistanceToBorder = config.minDistanceToBorder;
-        mDetectorParams->minMarkerDistanceRate = config.minMarkerDistanceRate;
-        mDetectorParams->minMarkerPerimeterRate = config.minMarkerPerimeterRate;
-        mDetectorParams->maxMarkerPerimeterRate = config.maxMarkerPerimeterRate;
-        mDetectorParams->minOtsuStdDev = config.minOtsuStdDev;
-        mDetectorParams->perspectiveRemoveIgnoredMarginPerCell = config.perspectiveRemoveIgnoredMarginPerCell;
-        mDetectorParams->perspectiveRemovePixelPerCell = config.perspectiveRemovePixelPerCell;
-        mDetectorParams->polygonalApproxAccuracyRate = config.polygonalApproxAccuracyRate;
+        params.errorCorrectionRate = config.errorCorrectionRate;
+        params.minCornerDistanceRate = config.minCornerDistanceRate;
+        params.markerBorderBits = config.markerBorderBits;
+        params.maxErroneousBitsInBorderRate = config.maxErroneousBitsInBorderRate;
+        params.minDistanceToBorder = config.minDistanceToBorder;
+        params.minMarkerDistanceRate = config.minMarkerDistanceRate;
+        params.minMarkerPerimeterRate = config.minMarkerPerimeterRate;
+        params.maxMarkerPerimeterRate = config.maxMarkerPerimeterRate;
+        params.minOtsuStdDev = config.minOtsuStdDev;
+        params.perspectiveRemoveIgnoredMarginPerCell = config.perspectiveRemoveIgnoredMarginPerCell;
+        params.perspectiveRemovePixelPerCell = config.perspectiveRemovePixelPerCell;
+        params.polygonalApproxAccuracyRate = config.polygonalApproxAccuracyRate;
+        mPendingConfig.pyramidLevels = config.pyramidLevels;
+        mPendingConfig.pyramidFallbackPerimeterRate = config.pyramidFallbackPerimeterRate;
+        ++mPendingConfigVersion;
+    }
+
+    std::optional<TagDetectorNodelet::DetectorConfig> TagDetectorNodelet::takeConfig(uint64_t& appliedVersion) {
+        std::scoped_lock lock{mConfigMutex};
+        if (appliedVersion == mPendingConfigVersion) return std::nullopt;
+
+        appliedVersion = mPendingConfigVersion;
+        return mPendingConfig;
     }
 
     bool TagDetectorNodelet::enableDetectionsCallback(std_srvs::SetBool::Request& req, std_srvs::SetBool::Response& res) {
@@ -0,0 +1,167 @@
+#include "tag_detector.hpp"
+
+namespace mrover {
+
+    MarkerDetector::MarkerDetector(cv::Ptr<cv::aruco::Dictionary> dictionary, cv::Ptr<cv::aruco::DetectorParameters> params)
+        : mDictionary{std::move(dictionary)}, mParams{std::move(params)} {}
+
+    void MarkerDetector::setRoiTracking(bool enabled, int fullScanPeriod, double paddingRate) {
+        mUseRoiTracking = enabled;
+        mFullScanPeriod = std::max(1, fullScanPeriod);
+        mRoiPaddingRate = std::max(0.0, paddingRate);
+        mTracked.clear();
+    }
+
+    void MarkerDetector::setPyramid(int levels, double fallbackPerimeterRate) {
+        mPyramidLevels = std::clamp(levels, 0, 3);
+        mPyramidFallbackPerimeterRate = std::max(0.0, fallbackPerimeterRate);
+    }
+
+    /**
+     * @brief Detects in an image or crop, at full resolution or through the downscaled pyramid level.
+     */
+    void MarkerDetector::detectRegion(cv::Mat const& image, cv::Ptr<cv::aruco::DetectorParameters> const& params, std::vector<Corners>& corners, std::vector<int>& ids) {
+        if (!mUsePyramid) {
+            cv::aruco::detectMarkers(image, mDictionary, corners, ids, params);
+            return;
+        }
+
+        // Contour finding and bit extraction dominate detection time and both scale with the pixel count
+        // Perimeter rates are relative to the image size, so the same parameters accept the same tags at any level
+        auto const factor = static_cast<float>(1 << mPyramidLevels);
+        cv::resize(image, mDownscaled, {}, 1.0 / factor, 1.0 / factor, cv::INTER_AREA);
+        auto lowParams = cv::makePtr<cv::aruco::DetectorParameters>(*params);
+        lowParams->cornerRefinementMethod = cv::aruco::CORNER_REFINE_NONE;
+        cv::aruco::detectMarkers(mDownscaled, mDictionary, corners, ids, lowParams);
+
+        for (Corners& markerCorners: corners) {
+            for (cv::Point2f& corner: markerCorners) {
+                // Pixel centers line up at (x + 0.5) * factor - 0.5 with area interpolation
+                corner = (corner + cv::Point2f{0.5f, 0.5f}) * factor - cv::Point2f{0.5f, 0.5f};
+            }
+        }
+
+        // Same refinement OpenCV does for CORNER_REFINE_SUBPIX, but on the full resolution image
+        // Contour refinement has no full resolution equivalent here so it is also done with subpixel refinement
+        if (params->cornerRefinementMethod == cv::aruco::CORNER_REFINE_NONE) return;
+
+        // Lifted corners can be off by about one downscaled pixel, so the window must at least cover that
+        int windowSize = std::max(params->cornerRefinementWinSize, static_cast<int>(factor));
+        cv::TermCriteria criteria{cv::TermCriteria::MAX_ITER | cv::TermCriteria::EPS, params->cornerRefinementMaxIterations, params->cornerRefinementMinAccuracy};
+        for (Corners& markerCorners: corners) {
+            cv::cornerSubPix(image, markerCorners, cv::Size{windowSize, windowSize}, cv::Size{-1, -1}, criteria);
+        }
+    }
+
+    void MarkerDetector::detectFull(cv::Mat const& gray, std::vector<Corners>& corners, std::vector<int>& ids) {
+        detectRegion(gray, mParams, corners, ids);
+    }
+
+    /**
+     * @brief Builds one padded region per tracked tag, merging any that overlap so no area is searched twice.
+     */
+    void MarkerDetector::buildRois(cv::Size imageSize) {
+        mRois.clear();
+        cv::Rect const bounds{{}, imageSize};
+        for (auto const& [id, corners]: mTracked) {
+            cv::Rect box = cv::boundingRect(corners);
+            // Corners closer than minDistanceToBorder to the edge of the crop are rejected by OpenCV, so pad past that too
+            int padding = static_cast<int>(std::ceil(mRoiPaddingRate * std::max(box.width, box.height))) + mParams->minDistanceToBorder + 1;
+            box -= cv::Point{padding, padding};
+            box += cv::Size{2 * padding, 2 * padding};
+            box &= bounds;
+            if (!box.empty()) mRois.push_back(box);
+        }
+
+        bool merged = true;
+        while (merged) {
+            merged = false;
+            for (size_t i = 0; i < mRois.size() && !merged; ++i) {
+                for (size_t j = i + 1; j < mRois.size(); ++j) {
+                    if ((mRois[i] & mRois[j]).empty()) continue;
+
+                    mRois[i] |= mRois[j];
+                    mRois.erase(mRois.begin() + static_cast<std::ptrdiff_t>(j));
+                    merged = true;
+                    break;
+                }
+            }
+        }
+    }
+
+    void MarkerDetector::detectInRois(cv::Mat const& gray, std::vector<Corners>& corners, std::vector<int>& ids) {
+        corners.clear();
+        ids.clear();
+
+        int imageMaxDimension = std::max(gray.cols, gray.rows);
+        for (cv::Rect const& roi: mRois) {
+            // Perimeter limits are relative to the largest dimension of the input image
+            // Rescale them so a crop accepts exactly the tag sizes the full image would
+            auto params = cv::makePtr<cv::aruco::DetectorParameters>(*mParams);
+            double scale = static_cast<double>(imageMaxDimension) / std::max(roi.width, roi.height);
+            params->minMarkerPerimeterRate *= scale;
+            params->maxMarkerPerimeterRate *= scale;
+
+            detectRegion(gray(roi), params, mRoiCorners, mRoiIds);
+
+            cv::Point2f offset{static_cast<float>(roi.x), static_cast<float>(roi.y)};
+            for (size_t i = 0; i < mRoiIds.size(); ++i) {
+                if (std::ranges::find(ids, mRoiIds[i]) != ids.end()) continue;
+
+                for (cv::Point2f& corner: mRoiCorners[i]) corner += offset;
+                ids.push_back(mRoiIds[i]);
+                corners.push_back(std::move(mRoiCorners[i]));
+            }
+        }
+    }
+
+    void MarkerDetector::detect(cv::Mat const& gray, std::vector<Corners>& corners, std::vector<int>& ids) {
+        assert(gray.type() == CV_8UC1);
+
+        auto anyMissing = [&](auto const& expectedIds) {
+            return std::ranges::any_of(expectedIds, [&](int id) { return std::ranges::find(ids, id) == ids.end(); });
+        };
+
+        double minPyramidPerimeter = mPyramidFallbackPerimeterRate * std::max(gray.cols, gray.rows);
+        mUsePyramid = mPyramidLevels > 0 && mLastSmallestPerimeter && mLastSmallestPerimeter.value() >= minPyramidPerimeter;
+
+        mRois.clear();
+        bool fullScan = !mUseRoiTracking || mTracked.empty() || mFramesSinceFullScan + 1 >= mFullScanPeriod;
+        if (!fullScan) {
+            buildRois(gray.size());
+            detectInRois(gray, corners, ids);
+            // A tracked tag missing from its region may have moved past the padding or be occluded
+            // Look everywhere this frame so hit counts are never decremented for a tag a full scan would have found
+            fullScan = anyMissing(std::views::keys(mTracked));
+        }
+
+        if (fullScan) {
+            mRois.clear();
+            detectFull(gray, corners, ids);
+            // Previously seen tags that disappear at the downscaled level may have become too small or blurry for it
+            if (mUsePyramid && anyMissing(mLastIds)) {
+                mUsePyramid = false;
+                detectFull(gray, corners, ids);
+            }
+            mFramesSinceFullScan = 0;
+        } else {
+            ++mFramesSinceFullScan;
+        }
+        mLastWasFullScan = fullScan;
+
+        mLastIds = ids;
+        mLastSmallestPerimeter = std::nullopt;
+        for (Corners const& markerCorners: corners) {
+            double perimeter = cv::arcLength(markerCorners, true);
+            mLastSmallestPerimeter = std::min(mLastSmallestPerimeter.value_or(perimeter), perimeter);
+        }
+
+        mTracked.clear();
+        if (!mUseRoiTracking) return;
+
+        for (size_t i = 0; i < ids.size(); ++i) {
+            mTracked.emplace(ids[i], corners[i]);
+        }
+    }
+
+} // namespace mrover
@@ -1,5 +1,7 @@
 #include "pch.hpp"
 
+#include "../point.hpp"
+
 namespace mrover {
 
     struct Tag {
@@ -9,16 +11,238 @@ namespace mrover {
         std::optional<SE3> tagInCam;
     };
 
+    using Corners = std::vector<cv::Point2f>;
+
+    /**
+     * @brief Runs ArUco detection on grayscale images.
+     *
+     * In ROI tracking mode tags found in the previous frame are only searched for in a padded region around their last corners.
+     * A full frame scan still happens periodically to pick up new tags, and immediately whenever a tracked tag is lost,
+     * so a frame never reports fewer tags than a full scan would have.
+     *
+     * In pyramid mode candidates are found on a downscaled copy of the image and only corner refinement runs at full resolution.
+     * This is only used while every tag seen last frame was large enough to decode at the downscaled level,
+     * and detection falls back to full resolution in the same frame if a previously seen tag goes missing.
+     */
+    class MarkerDetector {
+    private:
+        cv::Ptr<cv::aruco::Dictionary> mDictionary;
+        cv::Ptr<cv::aruco::DetectorParameters> mParams;
+
+        bool mUseRoiTracking = false;
+        int mFullScanPeriod = 10;     // Frames between full scans while tracking
+        double mRoiPaddingRate = 0.5; // Padding added on each side of a tag, relative to its largest side
+        int mFramesSinceFullScan = 0;
+        std::unordered_map<int, Corners> mTracked; // Map from tag ID to its corners in the last frame
+        std::vector<cv::Rect> mRois;
+        bool mLastWasFullScan = true;
+
+        std::vector<Corners> mRoiCorners;
+        std::vector<int> mRoiIds;
+
+        int mPyramidLevels = 0;                   // Each level halves the resolution, zero disables the pyramid
+        double mPyramidFallbackPerimeterRate = 0; // Tags smaller than this (relative to the full image) need full resolution
+        bool mUsePyramid = false;                 // Decided at the start of each frame
+        std::vector<int> mLastIds;
+        std::optional<double> mLastSmallestPerimeter; // In pixels
+        cv::Mat mDownscaled;
+
+        void detectRegion(cv::Mat const& image, cv::Ptr<cv::aruco::DetectorParameters> const& params, std::vector<Corners>& corners, std::vector<int>& ids);
+
+        void detectFull(cv::Mat const& gray, std::vector<Corners>& corners, std::vector<int>& ids);
+
+        void detectInRois(cv::Mat const& gray, std::vector<Corners>& corners, std::vector<int>& ids);
+
+        void buildRois(cv::Size imageSize);
+
+    public:
+        MarkerDetector() = default;
+
+        MarkerDetector(cv::Ptr<cv::aruco::Dictionary> dictionary, cv::Ptr<cv::aruco::DetectorParameters> params);
+
+        void setRoiTracking(bool enabled, int fullScanPeriod, double paddingRate);
+
+        void setPyramid(int levels, double fallbackPerimeterRate);
+
+        /**
+         * @param gray      Grayscale image
+         * @param corners   Output corners for each detected tag in image space
+         * @param ids       Output IDs for each detected tag
+         */
+        void detect(cv::Mat const& gray, std::vector<Corners>& corners, std::vector<int>& ids);
+
+        /**
+         * @return Regions searched in the last frame, empty if it was a full scan
+         */
+        [[nodiscard]] std::vector<cv::Rect> const& rois() const { return mRois; }
+
+        [[nodiscard]] bool lastWasFullScan() const { return mLastWasFullScan; }
+
+        [[nodiscard]] bool lastUsedPyramid() const { return mUsePyramid; }
+    };
+
+    /**
+     * @brief Adaptive mean thresholding at several window sizes that all share one integral image.
+     */
+    class AdaptiveThresholder {
+    private:
+        cv::Mat mPadded;
+        cv::Mat mIntegral;
+        std::vector<int> mRadii;
+
+    public:
+        void threshold(cv::Mat const& gray, std::vector<int> const& windowSizes, double constant, std::vector<cv::Mat>& outputs);
+    };
+
+    /**
+     * @brief Bounded FIFO between two pipeline stages.
+     *
+     * When full the oldest entry is dropped to make room, so a slow consumer always gets the most recent input next.
+     */
+    template<typename T>
+    class LatestWinsQueue {
+    private:
+        std::mutex mMutex;
+        std::condition_variable mNotEmpty;
+        std::deque<T> mItems;
+        size_t mCapacity;
+        bool mClosed = false;
+
+    public:
+        explicit LatestWinsQueue(size_t capacity) : mCapacity{std::max<size_t>(capacity, 1)} {}
+
+        /**
+         * @return The entry dropped to make room, or @p item itself if the queue is closed
+         */
+        std::optional<T> push(T item) {
+            std::optional<T> dropped;
+            {
+                std::scoped_lock lock{mMutex};
+                if (mClosed) return item;
+
+                if (mItems.size() == mCapacity) {
+                    dropped = std::move(mItems.front());
+                    mItems.pop_front();
+                }
+                mItems.push_back(std::move(item));
+            }
+            mNotEmpty.notify_one();
+            return dropped;
+        }
+
+        /**
+         * @brief Blocks until an entry is available.
+         *
+         * @return Nothing once the queue has been closed
+         */
+        std::optional<T> pop() {
+            std::unique_lock lock{mMutex};
+            mNotEmpty.wait(lock, [this] { return mClosed || !mItems.empty(); });
+            if (mClosed) return std::nullopt;
+
+            T item = std::move(mItems.front());
+            mItems.pop_front();
+            return item;
+        }
+
+        void close() {
+            {
+                std::scoped_lock lock{mMutex};
+                mClosed = true;
+                mItems.clear();
+            }
+            mNotEmpty.notify_all();
+        }
+    };
+
+    /**
+     * @brief Recycles image messages once every subscriber has let go of them.
+     *
+     * Images are rendered straight into the message and published as a shared pointer,
+     * so nodelets in the same manager receive them without a copy.
+     * A message is only written to again after the last reference to it is dropped.
+     */
+    class ImageMessagePool {
+    private:
+        MessagePool<sensor_msgs::Image> mPool;
+
+    public:
+        /**
+         * @return A message with its size, encoding and data allocated, the header is left to the caller
+         */
+        sensor_msgs::ImagePtr acquire(cv::Size size, int type, std::string const& encoding);
+    };
+
+    /**
+     * @return A header over the storage of @p msg, valid for as long as the message is not resized
+     */
+    cv::Mat wrapImageMessage(sensor_msgs::Image& msg, int type);
+
+    /**
+     * @brief Everything one camera frame carries through the detection pipeline.
+     *
+     * The input is either a point cloud or an image with a matching depth image, never both.
+     * Frames are recycled, so the images keep their allocations from one input to the next.
+     */
+    struct DetectionFrame {
+        sensor_msgs::PointCloud2ConstPtr cloud;
+        sensor_msgs::ImageConstPtr image;
+        sensor_msgs::ImageConstPtr depth; // 32FC1, meters along the optical axis
+        sensor_msgs::CameraInfoConstPtr cameraInfo;
+        uint32_t seqNum{};
+        bool publishDebugImage{};
+        cv::Mat grayImg;
+        sensor_msgs::ImagePtr imgMsg; // Only acquired when the debug image is published
+        cv::Mat img;                  // BGR, wraps the storage of imgMsg
+        std::vector<Corners> corners;
+        std::vector<int> ids;
+        std::vector<cv::Rect> rois;
+        std::vector<std::pair<int, int>> hitCounts; // Tag ID and hit count for every tag being tracked after this frame
+    };
+
+    using DetectionFramePtr = std::unique_ptr<DetectionFrame>;
+
     class TagDetectorNodelet : public nodelet::Nodelet {
     private:
+        /**
+         * Stages run in this order for every frame.
+         * Each can be mapped to the callback thread or to a worker thread, see "pipeline_stage_threads".
+         */
+        enum class Stage {
+            Convert, // Input to grayscale (and debug BGR), plus the debug threshold images
+            Detect,  // ArUco corners and IDs
+            Pose,    // Hit counts and TF
+            Render,  // Debug image
+        };
+        static constexpr size_t STAGE_COUNT = 4;
+
+        /**
+         * @brief Settings that can change through dynamic reconfigure while frames are in flight.
+         */
+        struct DetectorConfig {
+            cv::aruco::DetectorParameters params;
+            int pyramidLevels{};
+            double pyramidFallbackPerimeterRate{};
+        };
+
+        struct TagFrameIds {
+            std::string immediate; // Child of the camera frame
+            std::string parent;    // Child of the odom or map frame
+        };
+
         ros::NodeHandle mNh, mPnh;
 
         ros::Publisher mImgPub;
         std::unordered_map<int, ros::Publisher> mThreshPubs; // Map from threshold scale to publisher
         ros::ServiceServer mServiceEnableDetections;
 
+        using ImageDepthPolicy = message_filters::sync_policies::ApproximateTime<sensor_msgs::Image, sensor_msgs::Image, sensor_msgs::CameraInfo>;
+
         ros::Subscriber mPcSub;
-        ros::Subscriber mImgSub;
+        // Alternative to the point cloud, a fraction of the bandwidth when this runs in another process
+        message_filters::Subscriber<sensor_msgs::Image> mImgSub, mDepthSub;
+        message_filters::Subscriber<sensor_msgs::CameraInfo> mCameraInfoSub;
+        std::optional<message_filters::Synchronizer<ImageDepthPolicy>> mImageDepthSync;
         tf2_ros::Buffer mTfBuffer;
         tf2_ros::TransformListener mTfListener{mTfBuffer};
         tf2_ros::TransformBroadcaster mTfBroadcaster;
@@ -34,37 +258,98 @@ namespace mrover {
 
         cv::Ptr<cv::aruco::DetectorParameters> mDetectorParams;
         cv::Ptr<cv::aruco::Dictionary> mDictionary;
+        MarkerDetector mMarkerDetector;
 
-        cv::Mat mImg;
-        cv::Mat mGrayImg;
-        sensor_msgs::Image mImgMsg;
-        sensor_msgs::Image mThreshMsg;
+        cv::Size mImageSize;
+        AdaptiveThresholder mThresholder;
+        std::vector<int> mThreshScales, mThreshWindowSizes; // Only the scales that have subscribers
+        std::vector<sensor_msgs::ImagePtr> mThreshMsgs;     // One output per entry in mThreshScales
+        std::vector<cv::Mat> mThreshImgs;                   // Wrap the storage of mThreshMsgs
+        ImageMessagePool mImgMsgPool, mThreshMsgPool;
         uint32_t mSeqNum{};
         std::optional<size_t> mPrevDetectedCount; // Log spam prevention
-        std::vector<std::vector<cv::Point2f>> mImmediateCorners;
-        std::vector<int> mImmediateIds;
         std::unordered_map<int, Tag> mTags;
+        std::unordered_map<int, TagFrameIds> mTagFrameIds; // Kept after a tag is lost so the strings are built once per ID
+        std::vector<geometry_msgs::TransformStamped> mTransforms;
         dynamic_reconfigure::Server<mrover::DetectorParamsConfig> mConfigServer;
         dynamic_reconfigure::Server<mrover::DetectorParamsConfig>::CallbackType mCallbackType;
 
-        LoopProfiler mProfiler{"Tag Detector"};
+        // The reconfigure callback only stages a config, each stage applies it between frames on its own thread
+        std::mutex mConfigMutex;
+        DetectorConfig mPendingConfig;       // Guarded by mConfigMutex
+        uint64_t mPendingConfigVersion{};    // Guarded by mConfigMutex, bumped on every reconfigure
+        uint64_t mDetectConfigVersion{};     // Only touched by the detect stage, which owns mDetectorParams and mMarkerDetector
+        uint64_t mConvertConfigVersion{};    // Only touched by the convert stage
+        cv::aruco::DetectorParameters mThresholdParams; // Convert stage copy for the debug threshold images
+
+        // Stages in group zero run on the callback thread, every other group has its own worker thread
+        // Groups are contiguous, so a frame only ever moves forward through the queues
+        std::array<size_t, STAGE_COUNT> mStageGroups{};
+        std::vector<std::unique_ptr<LatestWinsQueue<DetectionFramePtr>>> mStageQueues; // Input of group i + 1
+        std::vector<std::thread> mStageThreads;                                      // Worker of group i + 1
+        std::mutex mFramePoolMutex;
+        std::vector<DetectionFramePtr> mFramePool;
+
+        std::array<LoopProfiler, STAGE_COUNT> mStageProfilers{
+                LoopProfiler{"Tag Detector Convert"},
+                LoopProfiler{"Tag Detector Detect"},
+                LoopProfiler{"Tag Detector Pose"},
+                LoopProfiler{"Tag Detector Render"},
+        };
+        std::optional<LoopProfilerReporter> mProfilerReporter;
 
         void onInit() override;
 
-        void publishThresholdedImage();
+        void startPipeline(std::vector<int> const& stageThreads, int queueSize);
+
+        void stopPipeline();
+
+        void runStageGroup(size_t group, DetectionFramePtr frame);
+
+        void stageWorker(size_t group);
+
+        DetectionFramePtr acquireFrame();
+
+        void releaseFrame(DetectionFramePtr frame);
+
+        void convertStage(DetectionFrame& frame);
+
+        void detectStage(DetectionFrame& frame);
+
+        void poseStage(DetectionFrame& frame);
+
+        void renderStage(DetectionFrame& frame);
+
+        void publishThresholdedImage(cv::Mat const& grayImg, uint32_t seqNum);
+
+        TagFrameIds const& tagFrameIds(int id);
 
         std::optional<SE3> getTagInCamFromPixel(sensor_msgs::PointCloud2ConstPtr const& cloudPtr, size_t u, size_t v);
 
+        std::optional<SE3> getTagInCamFromDepth(DetectionFrame const& frame, size_t u, size_t v);
+
+        void convertImage(DetectionFrame& frame);
+
+        /**
+         * @return The staged config if it changed since @p appliedVersion, which is then updated
+         */
+        std::optional<DetectorConfig> takeConfig(uint64_t& appliedVersion);
+
     public:
         TagDetectorNodelet() = default;
 
-        ~TagDetectorNodelet() override = default;
+        ~TagDetectorNodelet() override;
 
         void pointCloudCallback(sensor_msgs::PointCloud2ConstPtr const& msg);
 
+        void imageDepthCallback(sensor_msgs::ImageConstPtr const& image, sensor_msgs::ImageConstPtr const& depth, sensor_msgs::CameraInfoConstPtr const& cameraInfo);
+
         void configCallback(mrover::DetectorParamsConfig& config, uint32_t level);
 
         bool enableDetectionsCallback(std_srvs::SetBool::Request& req, std_srvs::SetBool::Response& res);
     };
 
+    template<typename PointT>
+    void pointCloudToGray(PointCloudView<PointT const> const& cloud, cv::Mat& gray, cv::Mat* bgr);
+
 } // namespace mrover
@@ -0,0 +1,21 @@
+#include "tag_detector.hpp"
+
+namespace mrover {
+
+    sensor_msgs::ImagePtr ImageMessagePool::acquire(cv::Size size, int type, std::string const& encoding) {
+        sensor_msgs::ImagePtr msg = mPool.acquire();
+
+        msg->height = size.height;
+        msg->width = size.width;
+        msg->encoding = encoding;
+        msg->step = size.width * CV_ELEM_SIZE(type);
+        msg->is_bigendian = __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__;
+        msg->data.resize(static_cast<size_t>(msg->step) * msg->height);
+        return msg;
+    }
+
+    cv::Mat wrapImageMessage(sensor_msgs::Image& msg, int type) {
+        return {static_cast<int>(msg.height), static_cast<int>(msg.width), type, msg.data.data(), msg.step};
+    }
+
+} // namespace mrover
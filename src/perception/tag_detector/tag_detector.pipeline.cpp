@@ -0,0 +1,185 @@
+#include "tag_detector.hpp"
+
+namespace mrover {
+
+    /**
+     * @brief Maps stages to threads and starts a worker for every group off the callback thread.
+     *
+     * @param stageThreads  Thread number for each stage, zero is the callback thread.
+     *                      Stages sharing a number run back to back on the same thread, so numbers must not decrease.
+     * @param queueSize     Frames each worker can have waiting before the oldest is dropped
+     */
+    void TagDetectorNodelet::startPipeline(std::vector<int> const& stageThreads, int queueSize) {
+        bool valid = stageThreads.size() == STAGE_COUNT &&
+                     std::ranges::all_of(stageThreads, [](int thread) { return thread >= 0; }) &&
+                     std::ranges::is_sorted(stageThreads);
+        if (!valid) {
+            NODELET_WARN("Invalid stage to thread mapping, expected %zu non-decreasing thread numbers. Running every stage on the callback thread", STAGE_COUNT);
+        }
+
+        size_t groupCount = 0;
+        for (size_t stage = 0; stage < STAGE_COUNT; ++stage) {
+            if (valid && stageThreads[stage] != 0 && (stage == 0 || stageThreads[stage] != stageThreads[stage - 1])) ++groupCount;
+            mStageGroups[stage] = valid && stageThreads[stage] != 0 ? groupCount : 0;
+        }
+
+        for (size_t group = 1; group <= groupCount; ++group) {
+            mStageQueues.push_back(std::make_unique<LatestWinsQueue<DetectionFramePtr>>(std::max(queueSize, 1)));
+        }
+        for (size_t group = 1; group <= groupCount; ++group) {
+            mStageThreads.emplace_back(&TagDetectorNodelet::stageWorker, this, group);
+        }
+
+        NODELET_INFO("Pipeline stage groups: [%zu %zu %zu %zu], queue size: %d", mStageGroups[0], mStageGroups[1], mStageGroups[2], mStageGroups[3], queueSize);
+    }
+
+    void TagDetectorNodelet::stopPipeline() {
+        for (auto& queue: mStageQueues) queue->close();
+        for (std::thread& thread: mStageThreads) {
+            if (thread.joinable()) thread.join();
+        }
+        mStageThreads.clear();
+        mStageQueues.clear();
+    }
+
+    TagDetectorNodelet::~TagDetectorNodelet() {
+        mPcSub.shutdown();
+        mImgSub.unsubscribe();
+        mDepthSub.unsubscribe();
+        mCameraInfoSub.unsubscribe();
+        stopPipeline();
+    }
+
+    DetectionFramePtr TagDetectorNodelet::acquireFrame() {
+        std::scoped_lock lock{mFramePoolMutex};
+        if (mFramePool.empty()) return std::make_unique<DetectionFrame>();
+
+        DetectionFramePtr frame = std::move(mFramePool.back());
+        mFramePool.pop_back();
+        return frame;
+    }
+
+    void TagDetectorNodelet::releaseFrame(DetectionFramePtr frame) {
+        // Let go of the inputs and debug image as soon as possible, the grayscale image is kept for the next frame
+        // Unless it is only a header over the input image, which must not outlive it
+        if (frame->image && !frame->grayImg.u) frame->grayImg.release();
+        frame->cloud.reset();
+        frame->image.reset();
+        frame->depth.reset();
+        frame->cameraInfo.reset();
+        frame->img.release();
+        frame->imgMsg.reset();
+        std::scoped_lock lock{mFramePoolMutex};
+        mFramePool.push_back(std::move(frame));
+    }
+
+    /**
+     * @brief Runs every stage in @p group on the calling thread, then hands the frame to the next group.
+     */
+    void TagDetectorNodelet::runStageGroup(size_t group, DetectionFramePtr frame) {
+        // Sequence of the input rather than our own, so the stages line up with the ZED in a trace
+        uint32_t inputSeq = frame->cloud ? frame->cloud->header.seq : frame->image->header.seq;
+        for (size_t stage = 0; stage < STAGE_COUNT; ++stage) {
+            if (mStageGroups[stage] != group) continue;
+
+            LoopProfiler& profiler = mStageProfilers[stage];
+            profiler.beginLoop(inputSeq);
+            profiler.measureEvent("Idle");
+            switch (static_cast<Stage>(stage)) {
+                case Stage::Convert:
+                    convertStage(*frame);
+                    break;
+                case Stage::Detect:
+                    detectStage(*frame);
+                    break;
+                case Stage::Pose:
+                    poseStage(*frame);
+                    break;
+                case Stage::Render:
+                    renderStage(*frame);
+                    break;
+            }
+        }
+
+        if (group == mStageQueues.size()) {
+            releaseFrame(std::move(frame));
+            return;
+        }
+
+        // Latest wins: if the next group is still busy with an older frame, that frame is the one thrown away
+        if (std::optional<DetectionFramePtr> dropped = mStageQueues[group]->push(std::move(frame))) {
+            NODELET_DEBUG("Dropped frame %u before stage group %zu", dropped.value()->seqNum, group + 1);
+            releaseFrame(std::move(dropped.value()));
+        }
+    }
+
+    void TagDetectorNodelet::stageWorker(size_t group) {
+        while (std::optional<DetectionFramePtr> frame = mStageQueues[group - 1]->pop()) {
+            runStageGroup(group, std::move(frame.value()));
+        }
+    }
+
+    /**
+     * Ingest a new point cloud into the pipeline.
+     *
+     * @param msg   Point cloud message
+     */
+    void TagDetectorNodelet::pointCloudCallback(sensor_msgs::PointCloud2ConstPtr const& msg) {
+        assert(msg);
+        assert(msg->height > 0);
+        assert(msg->width > 0);
+
+        if (!mEnableDetections) return;
+
+        NODELET_DEBUG("Got point cloud %d", msg->header.seq);
+
+        if (!visitPointCloud(*msg, [](auto const&) {})) {
+            NODELET_WARN_THROTTLE(1, "Unsupported point cloud layout with point step %u", msg->point_step);
+            return;
+        }
+
+        DetectionFramePtr frame = acquireFrame();
+        frame->cloud = msg;
+        frame->seqNum = mSeqNum++;
+        frame->publishDebugImage = mPublishImages && mImgPub.getNumSubscribers();
+        runStageGroup(0, std::move(frame));
+    }
+
+    /**
+     * Ingest a new image and its depth into the pipeline.
+     *
+     * @param image         8-bit grayscale or color image
+     * @param depth         32-bit float depth in meters, taken at the same time
+     * @param cameraInfo    Intrinsics of @p image
+     */
+    void TagDetectorNodelet::imageDepthCallback(sensor_msgs::ImageConstPtr const& image, sensor_msgs::ImageConstPtr const& depth, sensor_msgs::CameraInfoConstPtr const& cameraInfo) {
+        assert(image && depth && cameraInfo);
+
+        if (!mEnableDetections) return;
+
+        NODELET_DEBUG("Got image and depth %d", image->header.seq);
+
+        using namespace sensor_msgs::image_encodings;
+        if (image->encoding != MONO8 && image->encoding != BGR8 && image->encoding != BGRA8 && image->encoding != RGB8 && image->encoding != RGBA8) {
+            NODELET_WARN_THROTTLE(1, "Unsupported image encoding: %s", image->encoding.c_str());
+            return;
+        }
+        if (depth->encoding != TYPE_32FC1) {
+            NODELET_WARN_THROTTLE(1, "Unsupported depth encoding: %s", depth->encoding.c_str());
+            return;
+        }
+        if (image->width == 0 || image->height == 0 || depth->width == 0 || depth->height == 0 || cameraInfo->K[0] == 0 || cameraInfo->K[4] == 0) {
+            NODELET_WARN_THROTTLE(1, "Empty image, depth, or camera info");
+            return;
+        }
+
+        DetectionFramePtr frame = acquireFrame();
+        frame->image = image;
+        frame->depth = depth;
+        frame->cameraInfo = cameraInfo;
+        frame->seqNum = mSeqNum++;
+        frame->publishDebugImage = mPublishImages && mImgPub.getNumSubscribers();
+        runStageGroup(0, std::move(frame));
+    }
+
+} // namespace mrover
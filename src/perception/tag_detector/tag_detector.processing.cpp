@@ -1,7 +1,5 @@
 #include "tag_detector.hpp"
 
-#include "../point.hpp"
-
 namespace mrover {
 
     /**
@@ -18,72 +16,180 @@ namespace mrover {
             return std::nullopt;
         }
 
-        Point point = reinterpret_cast<Point const*>(cloudPtr->data.data())[u + v * cloudPtr->width];
+        std::optional<SE3> tagInCam;
+        visitPointCloud(*cloudPtr, [&](auto const& cloud) {
+            PointPosition point = getPosition(cloud(u, v));
+            if (!std::isfinite(point.x) || !std::isfinite(point.y) || !std::isfinite(point.z)) {
+                NODELET_WARN("Tag center point not finite: [%f %f %f]", point.x, point.y, point.z);
+                return;
+            }
+            tagInCam.emplace(R3{point.x, point.y, point.z}, SO3{});
+        });
+        return tagInCam;
+    }
+
+    /**
+     * @brief Retrieve the pose of the tag in camera space by back-projecting a pixel with its depth
+     * @param frame Frame holding the image, depth image, and camera info
+     * @param u     X Pixel Position in the image
+     * @param v     Y Pixel Position in the image
+     */
+    std::optional<SE3> TagDetectorNodelet::getTagInCamFromDepth(DetectionFrame const& frame, size_t u, size_t v) {
+        assert(frame.image && frame.depth && frame.cameraInfo);
+
+        sensor_msgs::Image const& image = *frame.image;
+        sensor_msgs::Image const& depth = *frame.depth;
+        // The depth image does not have to be at the same resolution as the color image
+        size_t depthU = u * depth.width / image.width, depthV = v * depth.height / image.height;
+        if (u >= image.width || v >= image.height || depthU >= depth.width || depthV >= depth.height) {
+            NODELET_WARN("Tag center out of bounds: [%zu %zu]", u, v);
+            return std::nullopt;
+        }
 
-        if (!std::isfinite(point.x) || !std::isfinite(point.y) || !std::isfinite(point.z)) {
-            NODELET_WARN("Tag center point not finite: [%f %f %f]", point.x, point.y, point.z);
+        float z;
+        std::memcpy(&z, depth.data.data() + depthV * depth.step + depthU * sizeof(float), sizeof(z));
+        if (!std::isfinite(z) || z <= 0) {
+            NODELET_WARN("Tag center depth not valid: %f", z);
             return std::nullopt;
         }
 
-        return std::make_optional<SE3>(R3{point.x, point.y, point.z}, SO3{});
+        // Camera info is for the color image, K is [fx 0 cx; 0 fy cy; 0 0 1]
+        boost::array<double, 9> const& K = frame.cameraInfo->K;
+        double x = (static_cast<double>(u) - K[2]) * z / K[0];
+        double y = (static_cast<double>(v) - K[5]) * z / K[4];
+        // Optical frame is z forward, x right, y down but the camera frame is x forward, y left, z up
+        return std::make_optional<SE3>(R3{z, -x, -y}, SO3{});
     }
 
     /**
-     * For each tag we have detected so far, fuse point cloud information.
-     * This information is where it is in the world.
+     * Convert a color or grayscale image into the images detection needs.
+     * A grayscale image is used in place since detection only ever reads it.
      *
-     * @param msg   Point cloud message
+     * @param frame Frame holding the image
      */
-    void TagDetectorNodelet::pointCloudCallback(sensor_msgs::PointCloud2ConstPtr const& msg) {
-        assert(msg);
-        assert(msg->height > 0);
-        assert(msg->width > 0);
-
-        if (!mEnableDetections) return;
-
-        mProfiler.beginLoop();
-
-        NODELET_DEBUG("Got point cloud %d", msg->header.seq);
-
-        // OpenCV needs a dense BGR image |BGR|...| but out point cloud is |BGRAXYZ...|...|
-        // So we need to copy the data into the correct format
-        if (static_cast<int>(msg->height) != mImg.rows || static_cast<int>(msg->width) != mImg.cols) {
-            NODELET_INFO("Image size changed from [%d %d] to [%u %u]", mImg.cols, mImg.rows, msg->width, msg->height);
-            mImg = cv::Mat{static_cast<int>(msg->height), static_cast<int>(msg->width), CV_8UC3, cv::Scalar{0, 0, 0}};
-        }
-        auto* pixelPtr = reinterpret_cast<cv::Vec3b*>(mImg.data);
-        auto* pointPtr = reinterpret_cast<Point const*>(msg->data.data());
-        std::for_each(std::execution::par_unseq, pixelPtr, pixelPtr + mImg.total(), [&](cv::Vec3b& pixel) {
-            size_t i = &pixel - pixelPtr;
-            pixel[0] = pointPtr[i].b;
-            pixel[1] = pointPtr[i].g;
-            pixel[2] = pointPtr[i].r;
-        });
-        mProfiler.measureEvent("Convert");
+    void TagDetectorNodelet::convertImage(DetectionFrame& frame) {
+        sensor_msgs::Image const& image = *frame.image;
+        auto rows = static_cast<int>(image.height), cols = static_cast<int>(image.width);
+        auto* data = const_cast<uint8_t*>(image.data.data());
+
+        if (image.encoding == sensor_msgs::image_encodings::MONO8) {
+            frame.grayImg = cv::Mat{rows, cols, CV_8UC1, data, image.step};
+            if (frame.publishDebugImage) cv::cvtColor(frame.grayImg, frame.img, cv::COLOR_GRAY2BGR);
+            return;
+        }
+
+        bool hasAlpha = image.encoding == sensor_msgs::image_encodings::BGRA8 || image.encoding == sensor_msgs::image_encodings::RGBA8;
+        bool isRgb = image.encoding == sensor_msgs::image_encodings::RGB8 || image.encoding == sensor_msgs::image_encodings::RGBA8;
+        cv::Mat color{rows, cols, hasAlpha ? CV_8UC4 : CV_8UC3, data, image.step};
+        frame.grayImg.create(rows, cols, CV_8UC1);
+        if (hasAlpha) {
+            cv::cvtColor(color, frame.grayImg, isRgb ? cv::COLOR_RGBA2GRAY : cv::COLOR_BGRA2GRAY);
+            if (frame.publishDebugImage) cv::cvtColor(color, frame.img, isRgb ? cv::COLOR_RGBA2BGR : cv::COLOR_BGRA2BGR);
+        } else {
+            cv::cvtColor(color, frame.grayImg, isRgb ? cv::COLOR_RGB2GRAY : cv::COLOR_BGR2GRAY);
+            if (frame.publishDebugImage) {
+                if (isRgb) {
+                    cv::cvtColor(color, frame.img, cv::COLOR_RGB2BGR);
+                } else {
+                    color.copyTo(frame.img);
+                }
+            }
+        }
+    }
+
+    /**
+     * Convert the input into the images detection needs.
+     * OpenCV needs dense images |Y|...| but our point cloud is |XYZBGRA...|...|
+     * The grayscale plane is all detection needs, the BGR image is only built when someone wants to see it
+     *
+     * @param frame Frame holding the point cloud or image
+     */
+    void TagDetectorNodelet::convertStage(DetectionFrame& frame) {
+        LoopProfiler& profiler = mStageProfilers[static_cast<size_t>(Stage::Convert)];
+
+        if (std::optional<DetectorConfig> config = takeConfig(mConvertConfigVersion)) mThresholdParams = config->params;
+
+        cv::Size imageSize = frame.cloud ? cv::Size{static_cast<int>(frame.cloud->width), static_cast<int>(frame.cloud->height)}
+                                         : cv::Size{static_cast<int>(frame.image->width), static_cast<int>(frame.image->height)};
+        if (imageSize != mImageSize) {
+            NODELET_INFO("Image size changed from [%d %d] to [%d %d]", mImageSize.width, mImageSize.height, imageSize.width, imageSize.height);
+            mImageSize = imageSize;
+        }
+        if (frame.publishDebugImage) {
+            // The debug image is written straight into the message that will be published
+            frame.imgMsg = mImgMsgPool.acquire(imageSize, CV_8UC3, sensor_msgs::image_encodings::BGR8);
+            frame.img = wrapImageMessage(*frame.imgMsg, CV_8UC3);
+        }
+        if (frame.cloud) {
+            frame.grayImg.create(imageSize, CV_8UC1);
+            // The layout was checked on ingest, so one of the known layouts always matches
+            [[maybe_unused]] bool known = visitPointCloud(*frame.cloud, [&](auto const& cloud) {
+                pointCloudToGray(cloud, frame.grayImg, frame.publishDebugImage ? &frame.img : nullptr);
+            });
+            assert(known);
+        } else {
+            convertImage(frame);
+        }
+        profiler.measureEvent("Convert");
 
         // Call thresholding
-        publishThresholdedImage();
-        mProfiler.measureEvent("Threshold");
+        publishThresholdedImage(frame.grayImg, frame.seqNum);
+        profiler.measureEvent("Threshold");
+    }
+
+    /**
+     * Detect the tag vertices in screen space and their respective ids.
+     * When tracking, only the regions around previously seen tags are searched most frames
+     *
+     * @param frame Frame holding the grayscale image
+     */
+    void TagDetectorNodelet::detectStage(DetectionFrame& frame) {
+        // Applied between frames, the detector reads its parameters throughout detection
+        if (std::optional<DetectorConfig> config = takeConfig(mDetectConfigVersion)) {
+            *mDetectorParams = config->params;
+            mMarkerDetector.setPyramid(config->pyramidLevels, config->pyramidFallbackPerimeterRate);
+        }
+        mMarkerDetector.detect(frame.grayImg, frame.corners, frame.ids);
+        frame.rois = mMarkerDetector.rois();
+        NODELET_DEBUG("OpenCV detect size: %zu, full scan: %s, pyramid: %s", frame.ids.size(),
+                      mMarkerDetector.lastWasFullScan() ? "true" : "false", mMarkerDetector.lastUsedPyramid() ? "true" : "false");
+        mStageProfilers[static_cast<size_t>(Stage::Detect)].measureEvent("OpenCV Detect");
+    }
+
+    /**
+     * @return Frame IDs for the tag, only built the first time the tag is seen
+     */
+    TagDetectorNodelet::TagFrameIds const& TagDetectorNodelet::tagFrameIds(int id) {
+        auto it = mTagFrameIds.find(id);
+        if (it == mTagFrameIds.end()) {
+            std::string idString = std::to_string(id);
+            std::tie(it, std::ignore) = mTagFrameIds.emplace(id, TagFrameIds{"immediateFiducial" + idString, "fiducial" + idString});
+        }
+        return it->second;
+    }
 
-        // Detect the tag vertices in screen space and their respective ids
-        // {mImmediateCorneres, mImmediateIds} are the outputs from OpenCV
-        cv::aruco::detectMarkers(mImg, mDictionary, mImmediateCorners, mImmediateIds, mDetectorParams);
-        NODELET_DEBUG("OpenCV detect size: %zu", mImmediateIds.size());
-        mProfiler.measureEvent("OpenCV Detect");
+    /**
+     * For each tag we have detected so far, fuse point cloud (or depth) information.
+     * This information is where it is in the world.
+     *
+     * @param frame Frame holding the 3D input and the detected tags
+     */
+    void TagDetectorNodelet::poseStage(DetectionFrame& frame) {
+        mTransforms.clear();
 
         // Update ID, image center, and increment hit count for all detected tags
-        for (size_t i = 0; i < mImmediateIds.size(); ++i) {
-            int id = mImmediateIds[i];
+        for (size_t i = 0; i < frame.ids.size(); ++i) {
+            int id = frame.ids[i];
             Tag& tag = mTags[id];
             tag.hitCount = std::clamp(tag.hitCount + mTagIncrementWeight, 0, mMaxHitCount);
             tag.id = id;
-            tag.imageCenter = std::reduce(mImmediateCorners[i].begin(), mImmediateCorners[i].end()) / static_cast<float>(mImmediateCorners[i].size());
-            tag.tagInCam = getTagInCamFromPixel(msg, std::lround(tag.imageCenter.x), std::lround(tag.imageCenter.y));
+            tag.imageCenter = std::reduce(frame.corners[i].begin(), frame.corners[i].end()) / static_cast<float>(frame.corners[i].size());
+            auto u = static_cast<size_t>(std::lround(tag.imageCenter.x)), v = static_cast<size_t>(std::lround(tag.imageCenter.y));
+            tag.tagInCam = frame.cloud ? getTagInCamFromPixel(frame.cloud, u, v) : getTagInCamFromDepth(frame, u, v);
 
             if (tag.tagInCam) {
                 // Publish tag to immediate
-                std::string immediateFrameId = "immediateFiducial" + std::to_string(tag.id);
-                SE3::pushToTfTree(mTfBroadcaster, immediateFrameId, mCameraFrameId, tag.tagInCam.value());
+                mTransforms.push_back(tag.tagInCam->toTransformStamped(mCameraFrameId, tagFrameIds(id).immediate));
             }
         }
 
@@ -92,7 +198,7 @@ namespace mrover {
         auto it = mTags.begin();
         while (it != mTags.end()) {
             auto& [id, tag] = *it;
-            if (std::ranges::find(mImmediateIds, id) == mImmediateIds.end()) {
+            if (std::ranges::find(frame.ids, id) == frame.ids.end()) {
                 tag.hitCount -= mTagDecrementWeight;
                 tag.tagInCam = std::nullopt;
                 if (tag.hitCount <= 0) {
@@ -104,62 +210,80 @@ namespace mrover {
         }
 
         // Publish all tags to the tf tree that have been seen enough times
-        for (auto const& [id, tag]: mTags) {
-            if (tag.hitCount >= mMinHitCountBeforePublish && tag.tagInCam) {
-                try {
-                    std::string immediateFrameId = "immediateFiducial" + std::to_string(tag.id);
-                    // Publish tag to odom
-                    std::string const& parentFrameId = mUseOdom ? mOdomFrameId : mMapFrameId;
-                    SE3 tagInParent = SE3::fromTfTree(mTfBuffer, parentFrameId, immediateFrameId);
-                    SE3::pushToTfTree(mTfBroadcaster, "fiducial" + std::to_string(id), parentFrameId, tagInParent);
-                } catch (tf2::ExtrapolationException const&) {
-                    NODELET_WARN("Old data for immediate tag");
-                } catch (tf2::LookupException const&) {
-                    NODELET_WARN("Expected transform for immediate tag");
-                } catch (tf::ConnectivityException const&) {
-                    NODELET_WARN("Expected connection to odom frame. Is visual odometry running?");
+        // The camera is looked up once and each tag is composed with it here, instead of reading the immediate frames back out of the tf tree
+        bool anyToPublish = std::ranges::any_of(mTags, [this](auto const& pair) {
+            auto const& [_, tag] = pair;
+            return tag.hitCount >= mMinHitCountBeforePublish && tag.tagInCam;
+        });
+        if (anyToPublish) {
+            try {
+                // Publish tag to odom
+                std::string const& parentFrameId = mUseOdom ? mOdomFrameId : mMapFrameId;
+                SE3 camInParent = SE3::fromTfTree(mTfBuffer, parentFrameId, mCameraFrameId);
+                for (auto const& [id, tag]: mTags) {
+                    if (tag.hitCount < mMinHitCountBeforePublish || !tag.tagInCam) continue;
+
+                    SE3 tagInParent = tag.tagInCam.value() * camInParent;
+                    mTransforms.push_back(tagInParent.toTransformStamped(parentFrameId, tagFrameIds(id).parent));
                 }
+            } catch (tf2::ExtrapolationException const&) {
+                NODELET_WARN("Old data for camera");
+            } catch (tf2::LookupException const&) {
+                NODELET_WARN("Expected transform for camera");
+            } catch (tf::ConnectivityException const&) {
+                NODELET_WARN("Expected connection to odom frame. Is visual odometry running?");
             }
         }
 
-        if (mPublishImages && mImgPub.getNumSubscribers()) {
+        // One message for every tag, the tf topic has a lot of subscribers
+        if (!mTransforms.empty()) mTfBroadcaster.sendTransform(mTransforms);
 
-            cv::aruco::drawDetectedMarkers(mImg, mImmediateCorners, mImmediateIds);
-            // Max number of tags the hit counter can display = 10;
-            if (!mTags.empty()) {
-                // TODO: remove some magic numbers in this block
-                int tagCount = 1;
-                auto tagBoxWidth = static_cast<int>(mImg.cols / (mTags.size() * 2));
-                for (auto& [id, tag]: mTags) {
-                    cv::Scalar color{255, 0, 0};
-                    cv::Point pt{tagBoxWidth * tagCount, mImg.rows / 10};
-                    std::string text = "id" + std::to_string(id) + ":" + std::to_string(tag.hitCount);
-                    cv::putText(mImg, text, pt, cv::FONT_HERSHEY_COMPLEX, mImg.cols / 800.0, color, mImg.cols / 300);
+        // The hit counts are owned by this stage, so rendering gets a snapshot
+        frame.hitCounts.clear();
+        for (auto const& [id, tag]: mTags) {
+            frame.hitCounts.emplace_back(id, tag.hitCount);
+        }
 
-                    ++tagCount;
-                }
-            }
-            mImgMsg.header.seq = mSeqNum;
-            mImgMsg.header.stamp = ros::Time::now();
-            mImgMsg.header.frame_id = "zed2i_left_camera_frame";
-            mImgMsg.height = mImg.rows;
-            mImgMsg.width = mImg.cols;
-            mImgMsg.encoding = sensor_msgs::image_encodings::BGR8;
-            mImgMsg.step = mImg.step;
-            mImgMsg.is_bigendian = __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__;
-            size_t size = mImgMsg.step * mImgMsg.height;
-            mImgMsg.data.resize(size);
-            std::uninitialized_copy(std::execution::par_unseq, mImg.data, mImg.data + size, mImgMsg.data.begin());
-            mImgPub.publish(mImgMsg);
-        }
-
-        size_t detectedCount = mImmediateIds.size();
+        size_t detectedCount = frame.ids.size();
         NODELET_INFO_COND(!mPrevDetectedCount.has_value() || detectedCount != mPrevDetectedCount.value(), "Detected %zu markers", detectedCount);
         mPrevDetectedCount = detectedCount;
 
-        mProfiler.measureEvent("Publish");
+        mStageProfilers[static_cast<size_t>(Stage::Pose)].measureEvent("Pose");
+    }
+
+    /**
+     * Draw the detections on top of the camera image and publish it.
+     *
+     * @param frame Frame holding the BGR image and the detected tags
+     */
+    void TagDetectorNodelet::renderStage(DetectionFrame& frame) {
+        if (!frame.publishDebugImage) return;
+
+        cv::Mat& img = frame.img;
+        cv::aruco::drawDetectedMarkers(img, frame.corners, frame.ids);
+        for (cv::Rect const& roi: frame.rois) {
+            cv::rectangle(img, roi, cv::Scalar{0, 255, 255}, 2);
+        }
+        // Max number of tags the hit counter can display = 10;
+        if (!frame.hitCounts.empty()) {
+            // TODO: remove some magic numbers in this block
+            int tagCount = 1;
+            auto tagBoxWidth = static_cast<int>(img.cols / (frame.hitCounts.size() * 2));
+            for (auto const& [id, hitCount]: frame.hitCounts) {
+                cv::Scalar color{255, 0, 0};
+                cv::Point pt{tagBoxWidth * tagCount, img.rows / 10};
+                std::string text = "id" + std::to_string(id) + ":" + std::to_string(hitCount);
+                cv::putText(img, text, pt, cv::FONT_HERSHEY_COMPLEX, img.cols / 800.0, color, img.cols / 300);
+
+                ++tagCount;
+            }
+        }
+        frame.imgMsg->header.seq = frame.seqNum;
+        frame.imgMsg->header.stamp = ros::Time::now();
+        frame.imgMsg->header.frame_id = "zed2i_left_camera_frame";
+        mImgPub.publish(frame.imgMsg);
 
-        mSeqNum++;
+        mStageProfilers[static_cast<size_t>(Stage::Render)].measureEvent("Publish");
     }
 
 } // namespace mrover
@@ -1,26 +1,73 @@
 #include "tag_detector.hpp"
 
+#include <tbb/blocked_range.h>
+#include <tbb/parallel_for.h>
+
 namespace mrover {
 
-    void threshold(cv::InputArray in, cv::OutputArray out, int windowSize, double constant) {
-        CV_Assert(windowSize >= 3);
+    /**
+     * @brief Thresholds @p gray at every window size in one parallel pass over a single integral image.
+     *
+     * Matches cv::adaptiveThreshold(..., ADAPTIVE_THRESH_MEAN_C, THRESH_BINARY_INV, ...) exactly, which is what ArUco uses internally.
+     * The border is replicated like OpenCV does, so the integral image is built over a padded copy of the input.
+     *
+     * @param gray          Grayscale input
+     * @param windowSizes   Window size of each output, even sizes are rounded up like OpenCV does
+     * @param constant      Constant subtracted from the mean
+     * @param outputs       One CV_8UC1 output per window size, (re)allocated as needed
+     */
+    void AdaptiveThresholder::threshold(cv::Mat const& gray, std::vector<int> const& windowSizes, double constant, std::vector<cv::Mat>& outputs) {
+        assert(gray.type() == CV_8UC1);
+
+        outputs.resize(windowSizes.size());
+        if (windowSizes.empty()) return;
+
+        mRadii.clear();
+        for (int windowSize: windowSizes) {
+            windowSize = std::max(windowSize, 3);
+            mRadii.push_back(windowSize / 2); // Even sizes are rounded up, so both 2r and 2r + 1 have radius r
+        }
+        int padding = *std::ranges::max_element(mRadii);
+
+        cv::copyMakeBorder(gray, mPadded, padding, padding, padding, padding, cv::BORDER_REPLICATE);
+        cv::integral(mPadded, mIntegral, CV_32S);
+        for (cv::Mat& output: outputs) output.create(gray.size(), CV_8UC1);
 
-        if (windowSize % 2 == 0) windowSize++; // win size must be odd
-        cv::adaptiveThreshold(in, out, 255, cv::ADAPTIVE_THRESH_MEAN_C, cv::THRESH_BINARY_INV, windowSize, constant);
+        // OpenCV computes the mean as round(sum / area) then outputs 255 where src - mean <= -floor(constant)
+        // Written as mean >= src + delta, and since area is odd sum / area never lies exactly halfway between integers:
+        // round(sum / area) >= k  <=>  2 * sum >= (2k - 1) * area
+        // This keeps the inner loop to integer multiplies and compares which vectorize well
+        int const delta = cvFloor(constant);
+        tbb::parallel_for(tbb::blocked_range<int>{0, gray.rows}, [&](tbb::blocked_range<int> const& rows) {
+            for (int y = rows.begin(); y < rows.end(); ++y) {
+                uint8_t const* src = gray.ptr<uint8_t>(y);
+                for (size_t i = 0; i < mRadii.size(); ++i) {
+                    int r = mRadii[i];
+                    int area = (2 * r + 1) * (2 * r + 1);
+                    // Window rows [y - r, y + r] in the original image are [y + padding - r, y + padding + r] in the padded one
+                    int const* top = mIntegral.ptr<int>(y + padding - r) + (padding - r);
+                    int const* bottom = mIntegral.ptr<int>(y + padding + r + 1) + (padding - r);
+                    int const width = 2 * r + 1;
+                    uint8_t* dst = outputs[i].ptr<uint8_t>(y);
+                    for (int x = 0; x < gray.cols; ++x) {
+                        int sum = bottom[x + width] - bottom[x] - top[x + width] + top[x];
+                        int k = src[x] + delta;
+                        dst[x] = 2 * sum >= (2 * k - 1) * area ? 255 : 0;
+                    }
+                }
+            }
+        });
     }
 
     /**
-     * Detect tags from raw image using OpenCV and calculate their screen space centers.
-     * Tag pose information relative to the camera in 3D space is filled in when we receive point cloud data.
-     *
-     * @param msg
+     * Publish the adaptive threshold images ArUco would see at each window size, only for scales that have subscribers.
      */
-    void TagDetectorNodelet::publishThresholdedImage() {
-        cvtColor(mImg, mGrayImg, cv::COLOR_BGR2GRAY);
-
+    void TagDetectorNodelet::publishThresholdedImage(cv::Mat const& grayImg, uint32_t seqNum) {
         // number of window sizes (scales) to apply adaptive thresholding
-        int scaleCount = (mDetectorParams->adaptiveThreshWinSizeMax - mDetectorParams->adaptiveThreshWinSizeMin) / mDetectorParams->adaptiveThreshWinSizeStep + 1;
+        int scaleCount = (mThresholdParams.adaptiveThreshWinSizeMax - mThresholdParams.adaptiveThreshWinSizeMin) / mThresholdParams.adaptiveThreshWinSizeStep + 1;
 
+        mThreshScales.clear();
+        mThreshWindowSizes.clear();
         // for each value in the interval of thresholding window sizes
         for (int scale = 0; scale < scaleCount; ++scale) {
             auto it = mThreshPubs.find(scale);
@@ -32,22 +79,27 @@ namespace mrover {
 
             if (publisher.getNumSubscribers() == 0) continue;
 
-            int windowSize = mDetectorParams->adaptiveThreshWinSizeMin + scale * mDetectorParams->adaptiveThreshWinSizeStep;
-            threshold(mGrayImg, mGrayImg, windowSize, mDetectorParams->adaptiveThreshConstant);
-
-            mThreshMsg.header.seq = mSeqNum;
-            mThreshMsg.header.stamp = ros::Time::now();
-            mThreshMsg.header.frame_id = "zed2i_left_camera_frame";
-            mThreshMsg.height = mGrayImg.rows;
-            mThreshMsg.width = mGrayImg.cols;
-            mThreshMsg.encoding = sensor_msgs::image_encodings::MONO8;
-            mThreshMsg.step = mGrayImg.step;
-            mThreshMsg.is_bigendian = __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__;
-            size_t size = mThreshMsg.step * mThreshMsg.height;
-            mThreshMsg.data.resize(size);
-            std::uninitialized_copy(std::execution::par_unseq, mGrayImg.data, mGrayImg.data + size, mThreshMsg.data.begin());
-
-            publisher.publish(mThreshMsg);
+            mThreshScales.push_back(scale);
+            mThreshWindowSizes.push_back(mThresholdParams.adaptiveThreshWinSizeMin + scale * mThresholdParams.adaptiveThreshWinSizeStep);
+        }
+        if (mThreshScales.empty()) return;
+
+        // Each scale is thresholded straight into the message that will be published
+        // The grayscale image is also the input to detection so it is never written to
+        mThreshMsgs.clear();
+        mThreshImgs.clear();
+        for (size_t i = 0; i < mThreshScales.size(); ++i) {
+            sensor_msgs::ImagePtr const& msg = mThreshMsgs.emplace_back(mThreshMsgPool.acquire(grayImg.size(), CV_8UC1, sensor_msgs::image_encodings::MONO8));
+            mThreshImgs.push_back(wrapImageMessage(*msg, CV_8UC1));
+        }
+        mThresholder.threshold(grayImg, mThreshWindowSizes, mThresholdParams.adaptiveThreshConstant, mThreshImgs);
+
+        for (size_t i = 0; i < mThreshScales.size(); ++i) {
+            sensor_msgs::ImagePtr const& msg = mThreshMsgs[i];
+            msg->header.seq = seqNum;
+            msg->header.stamp = ros::Time::now();
+            msg->header.frame_id = "zed2i_left_camera_frame";
+            mThreshPubs.at(mThreshScales[i]).publish(msg);
         }
     }
 
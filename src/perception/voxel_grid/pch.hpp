@@ -0,0 +1,30 @@
+#pragma once
+
+#include <algorithm>
+#include <bit>
+#include <cassert>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <boost_cpp23_workaround.hpp>
+
+#include <tbb/blocked_range.h>
+#include <tbb/enumerable_thread_specific.h>
+#include <tbb/parallel_for.h>
+
+#include <nodelet/loader.h>
+#include <nodelet/nodelet.h>
+#include <ros/init.h>
+#include <ros/node_handle.h>
+#include <sensor_msgs/PointCloud2.h>
+
+#include <loop_profiler.hpp>
+#include <loop_profiler_reporter.hpp>
+#include <message_pool.hpp>
@@ -0,0 +1,80 @@
+#include "voxel_grid.hpp"
+
+namespace mrover {
+
+    void VoxelGridNodelet::onInit() {
+        mNh = getMTNodeHandle();
+        mPnh = getMTPrivateNodeHandle();
+
+        VoxelGridParameters parameters;
+        int minPointsPerVoxel{};
+        mPnh.param("leaf_size", parameters.leafSize, parameters.leafSize);
+        mPnh.param("min_range", parameters.minRange, parameters.minRange);
+        mPnh.param("max_range", parameters.maxRange, parameters.maxRange);
+        mPnh.param("min_height", parameters.minHeight, parameters.minHeight);
+        mPnh.param("max_height", parameters.maxHeight, parameters.maxHeight);
+        mPnh.param("min_points_per_voxel", minPointsPerVoxel, static_cast<int>(parameters.minPointsPerVoxel));
+        parameters.minPointsPerVoxel = static_cast<uint32_t>(std::max(minPointsPerVoxel, 0));
+
+        try {
+            mVoxelGrid.emplace(parameters);
+        } catch (std::exception const& e) {
+            NODELET_FATAL("Invalid voxel grid parameters: %s", e.what());
+            ros::shutdown();
+            return;
+        }
+        NODELET_INFO("Voxel leaf size: %.3f m, range: [%.2f, %.2f] m, height: [%.2f, %.2f] m",
+                     parameters.leafSize, parameters.minRange, parameters.maxRange, parameters.minHeight, parameters.maxHeight);
+
+        bool useLoopProfiler{}, logProfiler{}, traceProfiler{};
+        double profilerPeriod{};
+        mPnh.param("use_loop_profiler", useLoopProfiler, true);
+        mPnh.param("loop_profiler_period", profilerPeriod, 1.0);
+        mPnh.param("log_loop_profiler", logProfiler, false);
+        mPnh.param("trace_loop_profiler", traceProfiler, false);
+        if (useLoopProfiler) mProfilerReporter.emplace(mNh, mPnh, std::vector{&mProfiler}, profilerPeriod, logProfiler, traceProfiler);
+
+        mPcPub = mNh.advertise<sensor_msgs::PointCloud2>("camera/left/points_downsampled", 1);
+        // In the same nodelet manager as the ZED nodelet, the cloud is handed over as a shared pointer without copying or serializing
+        mPcSub = mNh.subscribe("camera/left/points", 1, &VoxelGridNodelet::pointCloudCallback, this);
+    }
+
+    void VoxelGridNodelet::pointCloudCallback(sensor_msgs::PointCloud2ConstPtr const& msg) {
+        assert(msg);
+
+        if (mPcPub.getNumSubscribers() == 0) return;
+
+        mProfiler.beginLoop(msg->header.seq);
+        mProfiler.measureEvent("Wait");
+
+        sensor_msgs::PointCloud2Ptr downsampledMsg = mPointCloudMsgPool.acquire();
+        try {
+            mVoxelGrid->filter(*msg, *downsampledMsg);
+        } catch (std::invalid_argument const& e) {
+            NODELET_WARN_THROTTLE(1, "Dropping point cloud: %s", e.what());
+            return;
+        }
+        mProfiler.measureEvent("Voxelize");
+
+        mPcPub.publish(downsampledMsg);
+        mProfiler.measureEvent("Publish");
+    }
+
+} // namespace mrover
+
+int main(int argc, char** argv) {
+    ros::init(argc, argv, "voxel_grid");
+
+    // Start the voxel grid nodelet
+    nodelet::Loader nodelet;
+    nodelet.load(ros::this_node::getName(), "mrover/VoxelGridNodelet", ros::names::getRemappings(), {});
+
+    ros::spin();
+
+    return EXIT_SUCCESS;
+}
+
+#ifdef MROVER_IS_NODELET
+#include <pluginlib/class_list_macros.h>
+PLUGINLIB_EXPORT_CLASS(mrover::VoxelGridNodelet, nodelet::Nodelet)
+#endif
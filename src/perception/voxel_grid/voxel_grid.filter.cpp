@@ -0,0 +1,164 @@
+#include "voxel_grid.hpp"
+
+namespace mrover {
+
+    namespace {
+
+        constexpr int64_t KEY_BITS = 21; // Per axis, three of them fit in a 64-bit key with the top bit to spare
+        constexpr int64_t KEY_OFFSET = int64_t{1} << (KEY_BITS - 1);
+        constexpr size_t POINTS_PER_TASK = 16384; // Many rows per task, so few runs of points in one voxel are cut at task boundaries
+
+    } // namespace
+
+    VoxelGrid::VoxelMap::VoxelMap(size_t capacity) {
+        assert(capacity >= 2 && std::has_single_bit(capacity));
+
+        mSlots.assign(capacity, Slot{EMPTY, {}});
+        mShift = 64 - static_cast<uint32_t>(std::countr_zero(capacity));
+    }
+
+    size_t VoxelGrid::VoxelMap::slotOf(uint64_t key) const {
+        // Fibonacci hashing, spreads keys that differ only in their low bits (neighboring voxels) across the table
+        return static_cast<size_t>((key * 0x9E3779B97F4A7C15ull) >> mShift);
+    }
+
+    VoxelGrid::VoxelSum& VoxelGrid::VoxelMap::operator[](uint64_t key) {
+        assert(key != EMPTY);
+
+        size_t mask = mSlots.size() - 1;
+        for (size_t index = slotOf(key);; index = (index + 1) & mask) {
+            Slot& slot = mSlots[index];
+            if (slot.key == key) return slot.sum;
+            if (slot.key != EMPTY) continue;
+
+            // Kept at most half full so probe sequences stay short
+            if ((mOccupied.size() + 1) * 2 > mSlots.size()) {
+                grow();
+                return (*this)[key];
+            }
+            slot = {key, {}};
+            mOccupied.push_back(static_cast<uint32_t>(index));
+            return slot.sum;
+        }
+    }
+
+    void VoxelGrid::VoxelMap::clear() {
+        for (uint32_t index: mOccupied) mSlots[index].key = EMPTY;
+        mOccupied.clear();
+    }
+
+    void VoxelGrid::VoxelMap::grow() {
+        VoxelMap larger{mSlots.size() * 2};
+        larger.mOccupied.reserve(mOccupied.size() * 2);
+        forEach([&](uint64_t key, VoxelSum const& sum) { larger[key] = sum; });
+        *this = std::move(larger);
+    }
+
+    VoxelGrid::VoxelGrid(VoxelGridParameters const& parameters) : mParameters{parameters} {
+        if (!(mParameters.leafSize > 0) || !std::isfinite(mParameters.leafSize))
+            throw std::invalid_argument{"Voxel leaf size must be positive"};
+        if (!(mParameters.minRange >= 0 && mParameters.minRange < mParameters.maxRange))
+            throw std::invalid_argument{"Voxel grid range must be non-negative and not empty"};
+        if (!(mParameters.minHeight < mParameters.maxHeight))
+            throw std::invalid_argument{"Voxel grid height range must not be empty"};
+        // Every kept point is within the max range on each axis, its voxel coordinate has to fit in the key
+        if (mParameters.maxRange / mParameters.leafSize >= static_cast<float>(KEY_OFFSET - 1))
+            throw std::invalid_argument{"Voxel grid max range is too many leaves away, raise the leaf size or lower the range"};
+        if (mParameters.minPointsPerVoxel == 0)
+            throw std::invalid_argument{"Voxels need at least one point"};
+
+        mInverseLeafSize = 1.0 / mParameters.leafSize;
+    }
+
+    template<typename PointT>
+    void VoxelGrid::accumulate(PointCloudView<PointT const> const& view) {
+        float minRangeSquared = mParameters.minRange * mParameters.minRange;
+        float maxRangeSquared = mParameters.maxRange * mParameters.maxRange;
+        float minHeight = mParameters.minHeight, maxHeight = mParameters.maxHeight;
+        double inverseLeafSize = mInverseLeafSize;
+
+        // Organized or not, the points are contiguous, so split them evenly regardless of rows
+        tbb::parallel_for(tbb::blocked_range<size_t>{0, view.size(), POINTS_PER_TASK}, [&](tbb::blocked_range<size_t> const& range) {
+            VoxelMap& map = mThreadMaps.local();
+            // Sum of the current run of points in one voxel, kept out of the grid so it can live in registers
+            uint64_t runKey = std::numeric_limits<uint64_t>::max();
+            VoxelSum run{};
+            for (size_t i = range.begin(); i < range.end(); ++i) {
+                PointT const& point = view[i];
+                auto [x, y, z] = getPosition(point);
+                float rangeSquared = x * x + y * y + z * z;
+                // Written so that missing depth (NaN) fails every comparison and is dropped
+                if (!(rangeSquared >= minRangeSquared && rangeSquared <= maxRangeSquared && z >= minHeight && z <= maxHeight)) continue;
+
+                // The offset makes every coordinate positive, where truncating is flooring
+                auto axisKey = [&](float value) { return static_cast<uint64_t>(static_cast<int64_t>(value * inverseLeafSize + KEY_OFFSET)); };
+                uint64_t key = axisKey(x) << (KEY_BITS * 2) | axisKey(y) << KEY_BITS | axisKey(z);
+                if (key != runKey) {
+                    if (run.count) map[runKey] += run;
+                    runKey = key;
+                    run = {};
+                }
+                run.x += x;
+                run.y += y;
+                run.z += z;
+                run.b += point.b;
+                run.g += point.g;
+                run.r += point.r;
+                run.a += point.a;
+                ++run.count;
+            }
+            if (run.count) map[runKey] += run;
+        });
+    }
+
+    size_t VoxelGrid::filter(sensor_msgs::PointCloud2 const& input, sensor_msgs::PointCloud2& output) {
+        assert(&input != &output);
+
+        for (VoxelMap& map: mThreadMaps) map.clear();
+        bool isKnownLayout = visitPointCloud(input, [this](auto const& view) { accumulate(view); });
+        if (!isKnownLayout) throw std::invalid_argument{"Point cloud message is not in a known point layout"};
+
+        // When a single thread did all the work its grid is already the result
+        VoxelMap const* merged = nullptr;
+        auto isUsed = [](VoxelMap const& map) { return map.size() > 0; };
+        if (std::count_if(mThreadMaps.begin(), mThreadMaps.end(), isUsed) == 1) {
+            merged = &*std::find_if(mThreadMaps.begin(), mThreadMaps.end(), isUsed);
+        } else {
+            // A few thousand voxels per thread, merging them on one thread is cheap next to visiting the points
+            mMerged.clear();
+            for (VoxelMap const& map: mThreadMaps) {
+                map.forEach([&](uint64_t key, VoxelSum const& sum) { mMerged[key] += sum; });
+            }
+            merged = &mMerged;
+        }
+
+        // Sorted so the output does not depend on how the points were split between threads
+        mVoxels.clear();
+        merged->forEach([&](uint64_t key, VoxelSum const& sum) {
+            if (sum.count >= mParameters.minPointsPerVoxel) mVoxels.emplace_back(key, &sum);
+        });
+        std::sort(mVoxels.begin(), mVoxels.end(), [](auto const& a, auto const& b) { return a.first < b.first; });
+
+        output.header = input.header;
+        output.height = 1;
+        output.width = static_cast<uint32_t>(mVoxels.size());
+        output.is_dense = true;
+        fillPointCloudMessageHeader<Point>(output);
+
+        PointCloudView<Point> points{output};
+        for (size_t i = 0; i < mVoxels.size(); ++i) {
+            VoxelSum const& sum = *mVoxels[i].second;
+            auto mean = [&](uint32_t channel) { return static_cast<uint8_t>((channel + sum.count / 2) / sum.count); };
+            Point& point = points[i];
+            setPosition(point, static_cast<float>(sum.x / sum.count), static_cast<float>(sum.y / sum.count), static_cast<float>(sum.z / sum.count));
+            point.b = mean(sum.b);
+            point.g = mean(sum.g);
+            point.r = mean(sum.r);
+            point.a = mean(sum.a);
+            point.normal_x = point.normal_y = point.normal_z = 0;
+            point.curvature = 0;
+        }
+        return mVoxels.size();
+    }
+
+} // namespace mrover
@@ -0,0 +1,144 @@
+#pragma once
+
+#include "pch.hpp"
+
+#include "../point.hpp"
+
+namespace mrover {
+
+    struct VoxelGridParameters {
+        float leafSize = 0.1f;  // Edge length of a voxel, meters
+        float minRange = 0.3f;  // Distance from the camera, meters, closer points are dropped
+        float maxRange = 10.0f; // Distance from the camera, meters, further points are dropped
+        float minHeight = -1.0f; // Height (z) in the frame of the cloud, meters, lower points are dropped
+        float maxHeight = 2.0f;  // Height (z) in the frame of the cloud, meters, higher points are dropped
+        uint32_t minPointsPerVoxel = 1; // Voxels with fewer points are dropped, raising this rejects stray depth noise
+    };
+
+    /**
+     * @brief Downsamples a point cloud to the centroid of the points in each occupied voxel.
+     *
+     * The input is split into chunks across threads, each thread sums its points into its own hash grid.
+     * The grids are then merged, so there is no locking or atomics while points are being visited.
+     * Neighboring pixels of an organized cloud usually land in the same voxel, so runs of them are summed before touching the grid.
+     * Grids keep their memory between frames, after the first few frames nothing is allocated.
+     *
+     * Not thread safe, use one per thread.
+     */
+    class VoxelGrid {
+    public:
+        struct VoxelSum {
+            // Doubles since a voxel close to the camera can hold tens of thousands of points
+            double x, y, z;
+            uint32_t b, g, r, a;
+            uint32_t count;
+
+            VoxelSum& operator+=(VoxelSum const& other) {
+                x += other.x;
+                y += other.y;
+                z += other.z;
+                b += other.b;
+                g += other.g;
+                r += other.r;
+                a += other.a;
+                count += other.count;
+                return *this;
+            }
+        };
+
+        /**
+         * @brief Open addressing hash map from a packed voxel coordinate to its sum, with linear probing.
+         *
+         * Remembers which slots it filled, so clearing and iterating only touch those instead of the whole table.
+         */
+        class VoxelMap {
+        private:
+            static constexpr uint64_t EMPTY = std::numeric_limits<uint64_t>::max(); // Packed keys never set the top bit
+
+            // Key next to its sum, so a lookup is a single cache miss
+            struct Slot {
+                uint64_t key;
+                VoxelSum sum;
+            };
+
+            std::vector<Slot> mSlots;
+            std::vector<uint32_t> mOccupied;
+            uint32_t mShift{};
+
+            [[nodiscard]] size_t slotOf(uint64_t key) const;
+
+            void grow();
+
+        public:
+            explicit VoxelMap(size_t capacity = 1024);
+
+            /**
+             * @return Sum of the voxel, zeroed if it was not in the map. Invalidated by the next insertion.
+             */
+            [[nodiscard]] VoxelSum& operator[](uint64_t key);
+
+            void clear();
+
+            [[nodiscard]] size_t size() const { return mOccupied.size(); }
+
+            template<typename F>
+            void forEach(F&& f) const {
+                for (uint32_t slot: mOccupied) f(mSlots[slot].key, mSlots[slot].sum);
+            }
+        };
+
+    private:
+        VoxelGridParameters mParameters;
+        double mInverseLeafSize;
+
+        tbb::enumerable_thread_specific<VoxelMap> mThreadMaps;
+        VoxelMap mMerged;
+        std::vector<std::pair<uint64_t, VoxelSum const*>> mVoxels;
+
+        template<typename PointT>
+        void accumulate(PointCloudView<PointT const> const& view);
+
+    public:
+        /**
+         * @throws std::invalid_argument If the parameters are out of range, see the constructor for the limits
+         */
+        explicit VoxelGrid(VoxelGridParameters const& parameters);
+
+        [[nodiscard]] VoxelGridParameters const& parameters() const { return mParameters; }
+
+        /**
+         * @brief Fills @p output with an unorganized cloud of #Point centroids, one per voxel, sorted by voxel.
+         *
+         * Each centroid carries the mean color of its points. Normals and curvature are zero.
+         * @p output must not be @p input.
+         *
+         * @return  Number of points in @p output
+         * @throws std::invalid_argument If @p input is not in a known point layout, see #visitPointCloud
+         */
+        size_t filter(sensor_msgs::PointCloud2 const& input, sensor_msgs::PointCloud2& output);
+    };
+
+    class VoxelGridNodelet : public nodelet::Nodelet {
+    private:
+        ros::NodeHandle mNh, mPnh;
+
+        ros::Subscriber mPcSub;
+        ros::Publisher mPcPub;
+
+        std::optional<VoxelGrid> mVoxelGrid;
+        MessagePool<sensor_msgs::PointCloud2> mPointCloudMsgPool;
+
+        LoopProfiler mProfiler{"Voxel Grid"};
+        std::optional<LoopProfilerReporter> mProfilerReporter;
+
+        void onInit() override;
+
+        void pointCloudCallback(sensor_msgs::PointCloud2ConstPtr const& msg);
+
+    public:
+        VoxelGridNodelet() = default;
+
+        ~VoxelGridNodelet() override = default;
+    };
+
+} // namespace mrover
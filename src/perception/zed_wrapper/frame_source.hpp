@@ -0,0 +1,207 @@
+#pragma once
+
+// Be careful what you include in this file, it is compiled with nvcc (NVIDIA CUDA compiler) as C++17
+// Nothing in here may depend on the ZED SDK, the recorded and synthetic sources have to build without it
+
+#include "pch.hpp"
+
+namespace mrover {
+
+    // Where the planes of a frame live, device memory can only be read with CUDA
+    enum class FrameMemory {
+        Host,
+        Device,
+    };
+
+    /**
+     * @brief Non-owning view of one image plane, rows may be padded.
+     */
+    struct FrameBuffer {
+        uint8_t const* data = nullptr;
+        size_t step = 0; // Bytes from one row to the next
+
+        explicit operator bool() const { return data; }
+    };
+
+    /**
+     * @brief Whatever a source needs to keep alive for the buffers of a frame to stay valid.
+     */
+    struct FrameStorage {
+        virtual ~FrameStorage() = default;
+    };
+
+    /**
+     * @brief One timestamped stereo capture, handed from the grab thread to the point cloud thread.
+     *
+     * Every plane has the same resolution. Planes that were not requested are left empty.
+     */
+    struct StereoFrame {
+        ros::Time time;
+        FrameMemory memory = FrameMemory::Host;
+        uint32_t width = 0, height = 0;
+        FrameBuffer leftBgra, rightBgra; // Four bytes per pixel
+        FrameBuffer leftXyz;             // Four floats per pixel in meters, x forward y left z up, the last one is unused
+        FrameBuffer leftDepth;           // One float per pixel, meters along the optical axis
+        // Owned by the source that filled the frame, it may reuse it on the next grab into the same frame
+        std::unique_ptr<FrameStorage> storage;
+    };
+
+    struct CameraIntrinsics {
+        double fx = 0, fy = 0, cx = 0, cy = 0;
+        std::array<double, 5> distortion{}; // Plumb bob model, in the order ROS expects
+    };
+
+    struct StereoCalibration {
+        CameraIntrinsics left, right;
+        double baseline = 0; // Meters between the two cameras
+    };
+
+    /**
+     * @brief Planes the grab loop needs this frame, sources skip the work for the rest. The left image and points are always needed.
+     */
+    struct FrameRequest {
+        bool rightImage = false;
+        bool leftDepth = false;
+    };
+
+    /**
+     * @brief Produces the frames the ZED nodelet publishes.
+     *
+     * Only ever used from the grab thread. Besides the ZED itself, frames can come from a recording or be generated,
+     * which lets the publish pipeline run on machines without a ZED or a GPU.
+     */
+    class FrameSource {
+    public:
+        virtual ~FrameSource() = default;
+
+        /**
+         * @brief Blocks until the next frame is ready and points @p frame at it.
+         *
+         * @return False once the source has no more frames
+         */
+        virtual bool grab(StereoFrame& frame, FrameRequest const& request) = 0;
+
+        [[nodiscard]] virtual StereoCalibration calibration() const = 0;
+
+        /**
+         * @brief Whether frames are made whenever they are asked for, rather than arriving at a rate of their own.
+         *
+         * Grabbing from such a source faster than the frames are consumed only throws work away.
+         */
+        [[nodiscard]] virtual bool isOnDemand() const { return false; }
+
+        /**
+         * @brief Pose of the left camera from the source's own visual odometry, only available right after a grab.
+         */
+        virtual std::optional<SE3> leftCameraInOdom() { return std::nullopt; }
+
+        /**
+         * @brief Latest inertial readings, only for sources that have an IMU.
+         *
+         * @return Whether the messages were filled
+         */
+        virtual bool readInertial(sensor_msgs::Imu&, sensor_msgs::MagneticField&) { return false; }
+    };
+
+    /**
+     * @brief Replays frames from a file written by #FrameRecorder.
+     *
+     * The file is memory mapped and frames point straight into the mapping, nothing is copied on the way to the publish pipeline.
+     * Frames are stamped with the time they are replayed at, the same as a ZED replaying an SVO file.
+     */
+    class RecordedFrameSource final : public FrameSource {
+        int mFd = -1;
+        uint8_t const* mMapping = nullptr;
+        size_t mMappingSize = 0;
+
+        uint32_t mWidth = 0, mHeight = 0;
+        size_t mFrameCount = 0, mFrameSize = 0, mNextFrame = 0;
+        StereoCalibration mCalibration;
+        bool mLoop;
+        std::chrono::steady_clock::duration mPeriod{};
+        std::chrono::steady_clock::time_point mNextGrab;
+
+    public:
+        /**
+         * @param path  Recording to replay
+         * @param loop  Start over from the first frame instead of finishing at the end
+         * @param fps   Rate to replay at, zero replays as fast as the pipeline takes frames
+         * @throws std::runtime_error If the file can not be mapped or is not a valid recording
+         */
+        RecordedFrameSource(std::string const& path, bool loop, double fps);
+
+        RecordedFrameSource(RecordedFrameSource const&) = delete;
+        RecordedFrameSource& operator=(RecordedFrameSource const&) = delete;
+
+        ~RecordedFrameSource() override;
+
+        bool grab(StereoFrame& frame, FrameRequest const& request) override;
+
+        [[nodiscard]] StereoCalibration calibration() const override { return mCalibration; }
+
+        [[nodiscard]] bool isOnDemand() const override { return !mPeriod.count(); }
+
+        [[nodiscard]] size_t frameCount() const { return mFrameCount; }
+    };
+
+    /**
+     * @brief Writes frames into a file #RecordedFrameSource can replay. Frames may be in host or device memory.
+     *
+     * Every frame has to have the right image and depth, request them while recording.
+     */
+    class FrameRecorder {
+        std::FILE* mFile = nullptr;
+        uint32_t mWidth = 0, mHeight = 0;
+        std::vector<uint8_t> mScratch;
+
+        void writePlane(FrameBuffer const& plane, FrameMemory memory, size_t rowBytes);
+
+    public:
+        /**
+         * @throws std::runtime_error If the file can not be created
+         */
+        FrameRecorder(std::string const& path, uint32_t width, uint32_t height, StereoCalibration const& calibration);
+
+        FrameRecorder(FrameRecorder const&) = delete;
+        FrameRecorder& operator=(FrameRecorder const&) = delete;
+
+        ~FrameRecorder();
+
+        /**
+         * @throws std::runtime_error If writing fails or the frame does not match the recording
+         */
+        void write(StereoFrame const& frame);
+    };
+
+    /**
+     * @brief Generates a textured scene of a ground plane and a wall that slides sideways from frame to frame.
+     *
+     * A handful of frames are generated up front and cycled through, so grabbing costs next to nothing
+     * and the pipeline downstream can be measured on its own.
+     */
+    class SyntheticFrameSource final : public FrameSource {
+        struct Storage;
+
+        uint32_t mWidth, mHeight;
+        StereoCalibration mCalibration;
+        std::vector<std::unique_ptr<Storage>> mFrames;
+        size_t mNextFrame = 0;
+        std::chrono::steady_clock::duration mPeriod{};
+        std::chrono::steady_clock::time_point mNextGrab;
+
+    public:
+        /**
+         * @param fps   Rate to generate at, zero generates as fast as the pipeline takes frames
+         */
+        SyntheticFrameSource(uint32_t width, uint32_t height, double fps, size_t frameCount = 8);
+
+        ~SyntheticFrameSource() override;
+
+        bool grab(StereoFrame& frame, FrameRequest const& request) override;
+
+        [[nodiscard]] StereoCalibration calibration() const override { return mCalibration; }
+
+        [[nodiscard]] bool isOnDemand() const override { return !mPeriod.count(); }
+    };
+
+} // namespace mrover
@@ -0,0 +1,161 @@
+#include "zed_wrapper.hpp"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace mrover {
+
+    namespace {
+
+        constexpr std::array<char, 8> RECORDING_MAGIC{'M', 'R', 'Z', 'E', 'D', 'R', 'E', 'C'};
+        constexpr uint32_t RECORDING_VERSION = 1;
+
+        /**
+         * @brief Start of a recording, followed by the frames back to back.
+         *
+         * Each frame is its stamp in nanoseconds followed by the dense left BGRA, right BGRA, left XYZ, and left depth planes.
+         * Everything is in the byte order of the machine that recorded it.
+         */
+        struct RecordingHeader {
+            std::array<char, 8> magic;
+            uint32_t version;
+            uint32_t width, height;
+            uint32_t reserved;
+            StereoCalibration calibration;
+        };
+
+        // Frames start at multiples of four bytes, which keeps every float plane aligned inside the mapping
+        static_assert(sizeof(RecordingHeader) % 8 == 0);
+
+        constexpr size_t BGRA_BYTES_PER_PIXEL = 4;
+        constexpr size_t XYZ_BYTES_PER_PIXEL = 4 * sizeof(float);
+        constexpr size_t DEPTH_BYTES_PER_PIXEL = sizeof(float);
+
+        size_t recordedFrameSize(uint32_t width, uint32_t height) {
+            return sizeof(int64_t) + static_cast<size_t>(width) * height * (2 * BGRA_BYTES_PER_PIXEL + XYZ_BYTES_PER_PIXEL + DEPTH_BYTES_PER_PIXEL);
+        }
+
+        std::chrono::steady_clock::duration periodFromFps(double fps) {
+            if (fps <= 0) return {};
+            return std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>{1 / fps});
+        }
+
+    } // namespace
+
+    RecordedFrameSource::RecordedFrameSource(std::string const& path, bool loop, double fps)
+        : mLoop{loop}, mPeriod{periodFromFps(fps)}, mNextGrab{std::chrono::steady_clock::now()} {
+        mFd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        if (mFd < 0) throw std::runtime_error{"Failed to open recording " + path + ": " + std::strerror(errno)};
+
+        struct stat status{};
+        if (::fstat(mFd, &status) != 0 || static_cast<size_t>(status.st_size) < sizeof(RecordingHeader)) {
+            ::close(mFd);
+            throw std::runtime_error{"Recording " + path + " is too short"};
+        }
+        mMappingSize = static_cast<size_t>(status.st_size);
+        void* mapping = ::mmap(nullptr, mMappingSize, PROT_READ, MAP_PRIVATE, mFd, 0);
+        if (mapping == MAP_FAILED) {
+            ::close(mFd);
+            throw std::runtime_error{"Failed to map recording " + path + ": " + std::strerror(errno)};
+        }
+        mMapping = static_cast<uint8_t const*>(mapping);
+        // Frames are read front to back, let the kernel read ahead aggressively
+        ::madvise(mapping, mMappingSize, MADV_SEQUENTIAL);
+
+        RecordingHeader header{};
+        std::memcpy(&header, mMapping, sizeof(header));
+        mWidth = header.width;
+        mHeight = header.height;
+        mCalibration = header.calibration;
+        if (header.magic != RECORDING_MAGIC || header.version != RECORDING_VERSION || mWidth == 0 || mHeight == 0) {
+            ::munmap(mapping, mMappingSize);
+            ::close(mFd);
+            throw std::runtime_error{"Recording " + path + " has an unknown format"};
+        }
+        mFrameSize = recordedFrameSize(mWidth, mHeight);
+        mFrameCount = (mMappingSize - sizeof(RecordingHeader)) / mFrameSize;
+        if (mFrameCount == 0) {
+            ::munmap(mapping, mMappingSize);
+            ::close(mFd);
+            throw std::runtime_error{"Recording " + path + " has no frames"};
+        }
+    }
+
+    RecordedFrameSource::~RecordedFrameSource() {
+        ::munmap(const_cast<uint8_t*>(mMapping), mMappingSize);
+        ::close(mFd);
+    }
+
+    bool RecordedFrameSource::grab(StereoFrame& frame, FrameRequest const&) {
+        if (mNextFrame == mFrameCount) {
+            if (!mLoop) return false;
+
+            mNextFrame = 0;
+        }
+
+        if (mPeriod.count()) {
+            std::this_thread::sleep_until(mNextGrab);
+            // Do not try to catch up after falling behind, that would only burst frames
+            mNextGrab = std::max(mNextGrab + mPeriod, std::chrono::steady_clock::now());
+        }
+
+        // Every plane is always recorded, so they are handed out whether they were requested or not, it costs nothing
+        uint8_t const* record = mMapping + sizeof(RecordingHeader) + mNextFrame++ * mFrameSize;
+        size_t pixels = static_cast<size_t>(mWidth) * mHeight;
+        frame.time = ros::Time::now();
+        frame.memory = FrameMemory::Host;
+        frame.width = mWidth;
+        frame.height = mHeight;
+        record += sizeof(int64_t);
+        frame.leftBgra = {record, mWidth * BGRA_BYTES_PER_PIXEL};
+        record += pixels * BGRA_BYTES_PER_PIXEL;
+        frame.rightBgra = {record, mWidth * BGRA_BYTES_PER_PIXEL};
+        record += pixels * BGRA_BYTES_PER_PIXEL;
+        frame.leftXyz = {record, mWidth * XYZ_BYTES_PER_PIXEL};
+        record += pixels * XYZ_BYTES_PER_PIXEL;
+        frame.leftDepth = {record, mWidth * DEPTH_BYTES_PER_PIXEL};
+        return true;
+    }
+
+    FrameRecorder::FrameRecorder(std::string const& path, uint32_t width, uint32_t height, StereoCalibration const& calibration)
+        : mWidth{width}, mHeight{height} {
+        mFile = std::fopen(path.c_str(), "wb");
+        if (!mFile) throw std::runtime_error{"Failed to create recording " + path + ": " + std::strerror(errno)};
+
+        RecordingHeader header{};
+        header.magic = RECORDING_MAGIC;
+        header.version = RECORDING_VERSION;
+        header.width = width;
+        header.height = height;
+        header.calibration = calibration;
+        if (std::fwrite(&header, sizeof(header), 1, mFile) != 1) {
+            std::fclose(mFile);
+            throw std::runtime_error{"Failed to write recording " + path};
+        }
+    }
+
+    FrameRecorder::~FrameRecorder() {
+        if (mFile) std::fclose(mFile);
+    }
+
+    void FrameRecorder::writePlane(FrameBuffer const& plane, FrameMemory memory, size_t rowBytes) {
+        mScratch.resize(rowBytes * mHeight);
+        copyFrameBuffer(plane, memory, rowBytes, mHeight, mScratch.data());
+        if (std::fwrite(mScratch.data(), mScratch.size(), 1, mFile) != 1) throw std::runtime_error{"Failed to write recorded frame"};
+    }
+
+    void FrameRecorder::write(StereoFrame const& frame) {
+        if (frame.width != mWidth || frame.height != mHeight) throw std::runtime_error{"Frame resolution does not match the recording"};
+        if (!frame.leftBgra || !frame.rightBgra || !frame.leftXyz || !frame.leftDepth) throw std::runtime_error{"Recorded frames need every plane"};
+
+        int64_t stamp = static_cast<int64_t>(frame.time.toNSec());
+        if (std::fwrite(&stamp, sizeof(stamp), 1, mFile) != 1) throw std::runtime_error{"Failed to write recorded frame"};
+        writePlane(frame.leftBgra, frame.memory, mWidth * BGRA_BYTES_PER_PIXEL);
+        writePlane(frame.rightBgra, frame.memory, mWidth * BGRA_BYTES_PER_PIXEL);
+        writePlane(frame.leftXyz, frame.memory, mWidth * XYZ_BYTES_PER_PIXEL);
+        writePlane(frame.leftDepth, frame.memory, mWidth * DEPTH_BYTES_PER_PIXEL);
+    }
+
+} // namespace mrover
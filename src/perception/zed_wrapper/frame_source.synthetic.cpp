@@ -0,0 +1,112 @@
+#include "zed_wrapper.hpp"
+
+namespace mrover {
+
+    struct SyntheticFrameSource::Storage {
+        std::vector<uint8_t> leftBgra, rightBgra;
+        std::vector<float> leftXyz, leftDepth;
+    };
+
+    namespace {
+
+        constexpr float CAMERA_HEIGHT = 0.5f;  // Meters above the ground plane
+        constexpr float WALL_DISTANCE = 4.0f;  // Meters in front of the camera
+        constexpr float WALL_SLIDE = 0.05f;    // Meters the wall texture moves sideways every frame
+        constexpr float CHECKER_SIZE = 0.25f;  // Meters
+        constexpr double BASELINE = 0.12;      // Meters, close to a ZED 2i
+
+    } // namespace
+
+    SyntheticFrameSource::SyntheticFrameSource(uint32_t width, uint32_t height, double fps, size_t frameCount)
+        : mWidth{width}, mHeight{height}, mNextGrab{std::chrono::steady_clock::now()} {
+        if (width == 0 || height == 0 || frameCount == 0) throw std::invalid_argument{"Invalid synthetic frame dimensions"};
+        if (fps > 0) mPeriod = std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>{1 / fps});
+
+        // Roughly the 110 degree horizontal field of view of the ZED 2i
+        CameraIntrinsics intrinsics;
+        intrinsics.fx = intrinsics.fy = width * 0.35;
+        intrinsics.cx = width / 2.0;
+        intrinsics.cy = height / 2.0;
+        mCalibration = {intrinsics, intrinsics, BASELINE};
+
+        auto fx = static_cast<float>(intrinsics.fx), fy = static_cast<float>(intrinsics.fy);
+        auto cx = static_cast<float>(intrinsics.cx), cy = static_cast<float>(intrinsics.cy);
+        auto disparity = static_cast<float>(intrinsics.fx * BASELINE);
+        size_t pixels = static_cast<size_t>(width) * height;
+        for (size_t i = 0; i < frameCount; ++i) {
+            auto storage = std::make_unique<Storage>();
+            storage->leftBgra.resize(pixels * 4);
+            storage->rightBgra.resize(pixels * 4);
+            storage->leftXyz.resize(pixels * 4);
+            storage->leftDepth.resize(pixels);
+            float slide = static_cast<float>(i) * WALL_SLIDE;
+
+            for (uint32_t v = 0; v < height; ++v) {
+                for (uint32_t u = 0; u < width; ++u) {
+                    // Ray through the pixel in the camera frame, x forward y left z up
+                    float rayY = (cx - static_cast<float>(u)) / fx, rayZ = (cy - static_cast<float>(v)) / fy;
+                    // Whichever of the wall and the ground plane the ray hits first
+                    float distance = rayZ < 0 ? std::min(WALL_DISTANCE, CAMERA_HEIGHT / -rayZ) : WALL_DISTANCE;
+                    float x = distance, y = rayY * distance, z = rayZ * distance;
+                    bool isWall = distance == WALL_DISTANCE;
+
+                    float along = isWall ? y + slide : x, across = isWall ? z : y;
+                    bool isDark = (static_cast<int>(std::floor(along / CHECKER_SIZE)) + static_cast<int>(std::floor(across / CHECKER_SIZE))) & 1;
+                    auto shade = static_cast<uint8_t>(isDark ? 40 : 210);
+
+                    size_t pixel = static_cast<size_t>(v) * width + u;
+                    uint8_t* bgra = storage->leftBgra.data() + pixel * 4;
+                    bgra[0] = isWall ? shade : static_cast<uint8_t>(shade / 2);
+                    bgra[1] = shade;
+                    bgra[2] = isWall ? static_cast<uint8_t>(shade / 2) : shade;
+                    bgra[3] = 255;
+
+                    float* xyz = storage->leftXyz.data() + pixel * 4;
+                    xyz[0] = x;
+                    xyz[1] = y;
+                    xyz[2] = z;
+                    xyz[3] = 0;
+                    storage->leftDepth[pixel] = x;
+                }
+            }
+
+            // Right view of the same scene, shifted by the disparity of each left pixel, holes keep the left color
+            storage->rightBgra = storage->leftBgra;
+            for (uint32_t v = 0; v < height; ++v) {
+                for (uint32_t u = 0; u < width; ++u) {
+                    size_t pixel = static_cast<size_t>(v) * width + u;
+                    auto shift = static_cast<int64_t>(std::lround(disparity / storage->leftDepth[pixel]));
+                    int64_t rightU = static_cast<int64_t>(u) - shift;
+                    if (rightU < 0) continue;
+
+                    std::memcpy(storage->rightBgra.data() + (static_cast<size_t>(v) * width + static_cast<size_t>(rightU)) * 4, storage->leftBgra.data() + pixel * 4, 4);
+                }
+            }
+
+            mFrames.push_back(std::move(storage));
+        }
+    }
+
+    SyntheticFrameSource::~SyntheticFrameSource() = default;
+
+    bool SyntheticFrameSource::grab(StereoFrame& frame, FrameRequest const&) {
+        if (mPeriod.count()) {
+            std::this_thread::sleep_until(mNextGrab);
+            // Do not try to catch up after falling behind, that would only burst frames
+            mNextGrab = std::max(mNextGrab + mPeriod, std::chrono::steady_clock::now());
+        }
+
+        Storage const& storage = *mFrames[mNextFrame];
+        mNextFrame = (mNextFrame + 1) % mFrames.size();
+        frame.time = ros::Time::now();
+        frame.memory = FrameMemory::Host;
+        frame.width = mWidth;
+        frame.height = mHeight;
+        frame.leftBgra = {storage.leftBgra.data(), mWidth * 4};
+        frame.rightBgra = {storage.rightBgra.data(), mWidth * 4};
+        frame.leftXyz = {reinterpret_cast<uint8_t const*>(storage.leftXyz.data()), mWidth * 4 * sizeof(float)};
+        frame.leftDepth = {reinterpret_cast<uint8_t const*>(storage.leftDepth.data()), mWidth * sizeof(float)};
+        return true;
+    }
+
+} // namespace mrover
@@ -0,0 +1,160 @@
+#include "zed_wrapper.hpp"
+
+namespace mrover {
+
+    namespace {
+
+        /**
+         * Allows us to store enums as strings in the config file.
+         * This avoids problems when ZED updates their enum integer values.
+         *
+         * @tparam TEnum    ZED enum type
+         * @param string    String to convert to enum
+         * @return          Enum value
+         */
+        template<typename TEnum>
+        [[nodiscard]] TEnum stringToZedEnum(std::string_view string) {
+            using int_t = std::underlying_type_t<TEnum>;
+            for (int_t i = 0; i < static_cast<int_t>(TEnum::LAST); ++i) {
+                if (sl::String{string.data()} == sl::toString(static_cast<TEnum>(i))) {
+                    return static_cast<TEnum>(i);
+                }
+            }
+            throw std::invalid_argument("Invalid enum string");
+        }
+
+        CameraIntrinsics toIntrinsics(sl::CameraParameters const& camera) {
+            CameraIntrinsics intrinsics;
+            intrinsics.fx = camera.fx;
+            intrinsics.fy = camera.fy;
+            intrinsics.cx = camera.cx;
+            intrinsics.cy = camera.cy;
+            intrinsics.distortion = {camera.disto[0], camera.disto[1], camera.disto[4], camera.disto[2], camera.disto[3]};
+            return intrinsics;
+        }
+
+    } // namespace
+
+    struct ZedFrameSource::Storage : FrameStorage {
+        sl::Mat leftImage;
+        sl::Mat rightImage;
+        sl::Mat leftPoints;
+        sl::Mat leftDepth;
+    };
+
+    ZedFrameSource::ZedFrameSource(ZedParameters const& parameters) : mParameters{parameters} {
+        sl::InitParameters initParameters;
+        if (!mParameters.svoFile.empty()) {
+            initParameters.input.setFromSVOFile(mParameters.svoFile.c_str());
+        } else {
+            initParameters.input.setFromCameraID(-1, sl::BUS_TYPE::USB);
+        }
+        initParameters.depth_stabilization = mParameters.useDepthStabilization;
+        initParameters.camera_resolution = stringToZedEnum<sl::RESOLUTION>(mParameters.grabResolution);
+        initParameters.depth_mode = stringToZedEnum<sl::DEPTH_MODE>(mParameters.depthMode);
+        initParameters.coordinate_units = sl::UNIT::METER;
+        initParameters.sdk_verbose = true; // Log useful information
+        initParameters.camera_fps = mParameters.grabTargetFps;
+        initParameters.coordinate_system = sl::COORDINATE_SYSTEM::RIGHT_HANDED_Z_UP_X_FWD; // Match ROS
+        initParameters.depth_maximum_distance = mParameters.depthMaximumDistance;
+
+        if (mZed.open(initParameters) != sl::ERROR_CODE::SUCCESS) {
+            throw std::runtime_error("ZED failed to open");
+        }
+        mZedInfo = mZed.getCameraInformation();
+
+        if (mParameters.useBuiltinPosTracking) {
+            sl::PositionalTrackingParameters positionalTrackingParameters;
+            positionalTrackingParameters.enable_pose_smoothing = mParameters.usePoseSmoothing;
+            positionalTrackingParameters.enable_area_memory = mParameters.useAreaMemory;
+            mZed.enablePositionalTracking(positionalTrackingParameters);
+        }
+
+        mRuntimeParameters.confidence_threshold = mParameters.depthConfidence;
+        mRuntimeParameters.texture_confidence_threshold = mParameters.textureConfidence;
+
+        cudaDeviceProp prop{};
+        cudaGetDeviceProperties(&prop, 0);
+        ROS_INFO("MP count: %d, Max threads/MP: %d, Max blocks/MP: %d, max threads/block: %d",
+                 prop.multiProcessorCount, prop.maxThreadsPerMultiProcessor, prop.maxBlocksPerMultiProcessor, prop.maxThreadsPerBlock);
+    }
+
+    ZedFrameSource::~ZedFrameSource() {
+        mZed.close();
+    }
+
+    /**
+     * grab() on the ZED updates positional tracking (visual odometry) which works best at high update rates.
+     * As such the images and point cloud are only retrieved on the GPU, leaving the copies to the point cloud thread.
+     * Unless retrieving to host memory, where the SDK does the copy and the point cloud is interleaved on the CPU.
+     */
+    bool ZedFrameSource::grab(StereoFrame& frame, FrameRequest const& request) {
+        if (mZed.grab(mRuntimeParameters) != sl::ERROR_CODE::SUCCESS)
+            throw std::runtime_error("ZED failed to grab");
+
+        // Matrices stay with the frame, so retrieving into it again reuses their memory
+        if (!dynamic_cast<Storage*>(frame.storage.get())) frame.storage = std::make_unique<Storage>();
+        auto& storage = static_cast<Storage&>(*frame.storage);
+        sl::Resolution resolution{mParameters.imageWidth, mParameters.imageHeight};
+        sl::MEM memory = mParameters.retrieveToHost ? sl::MEM::CPU : sl::MEM::GPU;
+
+        // Retrieval has to happen on the same thread as grab so that the image and point cloud are synced
+        if (request.rightImage)
+            if (mZed.retrieveImage(storage.rightImage, sl::VIEW::RIGHT, memory, resolution) != sl::ERROR_CODE::SUCCESS)
+                throw std::runtime_error("ZED failed to retrieve right image");
+        // Only left set is used for processing
+        if (mZed.retrieveImage(storage.leftImage, sl::VIEW::LEFT, memory, resolution) != sl::ERROR_CODE::SUCCESS)
+            throw std::runtime_error("ZED failed to retrieve left image");
+        if (mZed.retrieveMeasure(storage.leftPoints, sl::MEASURE::XYZ, memory, resolution) != sl::ERROR_CODE::SUCCESS)
+            throw std::runtime_error("ZED failed to retrieve point cloud");
+        if (request.leftDepth)
+            if (mZed.retrieveMeasure(storage.leftDepth, sl::MEASURE::DEPTH, memory, resolution) != sl::ERROR_CODE::SUCCESS)
+                throw std::runtime_error("ZED failed to retrieve depth");
+
+        assert(storage.leftImage.timestamp == storage.leftPoints.timestamp);
+
+        auto toBuffer = [memory](sl::Mat& mat) {
+            return FrameBuffer{mat.getPtr<sl::uchar1>(memory), mat.getStepBytes(memory)};
+        };
+        frame.time = mParameters.svoFile.empty() ? slTime2Ros(mZed.getTimestamp(sl::TIME_REFERENCE::IMAGE)) : ros::Time::now();
+        frame.memory = mParameters.retrieveToHost ? FrameMemory::Host : FrameMemory::Device;
+        frame.width = storage.leftImage.getWidth();
+        frame.height = storage.leftImage.getHeight();
+        frame.leftBgra = toBuffer(storage.leftImage);
+        frame.rightBgra = request.rightImage ? toBuffer(storage.rightImage) : FrameBuffer{};
+        frame.leftXyz = toBuffer(storage.leftPoints);
+        frame.leftDepth = request.leftDepth ? toBuffer(storage.leftDepth) : FrameBuffer{};
+        return true;
+    }
+
+    StereoCalibration ZedFrameSource::calibration() const {
+        sl::CalibrationParameters const& calibration = mZedInfo.camera_configuration.calibration_parameters;
+        return {toIntrinsics(calibration.left_cam), toIntrinsics(calibration.right_cam), calibration.getCameraBaseline()};
+    }
+
+    std::optional<SE3> ZedFrameSource::leftCameraInOdom() {
+        if (!mParameters.useBuiltinPosTracking) return std::nullopt;
+
+        sl::Pose pose;
+        sl::POSITIONAL_TRACKING_STATE status = mZed.getPosition(pose);
+        if (status != sl::POSITIONAL_TRACKING_STATE::OK) {
+            ROS_WARN_STREAM("Positional tracking failed: " << status);
+            return std::nullopt;
+        }
+        sl::Translation const& translation = pose.getTranslation();
+        sl::Orientation const& orientation = pose.getOrientation();
+        return SE3{{translation.x, translation.y, translation.z},
+                   Eigen::Quaterniond{orientation.w, orientation.x, orientation.y, orientation.z}.normalized()};
+    }
+
+    bool ZedFrameSource::readInertial(sensor_msgs::Imu& imuMsg, sensor_msgs::MagneticField& magMsg) {
+        if (mZedInfo.camera_model != sl::MODEL::ZED2i) return false;
+
+        sl::SensorsData sensorData;
+        mZed.getSensorsData(sensorData, sl::TIME_REFERENCE::CURRENT);
+        fillImuMessage(sensorData.imu, imuMsg);
+        fillMagMessage(sensorData.magnetometer, magMsg);
+        return true;
+    }
+
+} // namespace mrover
@@ -1,16 +1,29 @@
 #pragma once
 
+#include <algorithm>
+#include <array>
 #include <cassert>
+#include <cerrno>
 #include <chrono>
-#include <condition_variable>
+#include <cmath>
 #include <cstdint>
-#include <mutex>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <string_view>
 #include <thread>
+#include <vector>
 
 #include <boost_cpp23_workaround.hpp>
 
+// Only the ZED frame source and the CUDA bridge need these, everything else builds without a GPU
+#ifdef MROVER_WITH_ZED
 #include <sl/Camera.hpp>
 #include <thrust/device_vector.h>
+#endif
 
 #include <nodelet/loader.h>
 #include <nodelet/nodelet.h>
@@ -28,4 +41,7 @@
 #include <tf2_ros/transform_listener.h>
 
 #include <loop_profiler.hpp>
+#include <loop_profiler_reporter.hpp>
+#include <message_pool.hpp>
 #include <se3.hpp>
+#include <triple_buffer.hpp>
@@ -14,21 +14,6 @@ namespace mrover {
                 static_cast<uint32_t>(t.getNanoseconds() % NS_PER_S)};
     }
 
-    void fillImageMessage(sl::Mat& bgra, sensor_msgs::ImagePtr const& msg) {
-        assert(bgra.getChannels() == 4);
-        assert(msg);
-
-        msg->height = bgra.getHeight();
-        msg->width = bgra.getWidth();
-        msg->encoding = sensor_msgs::image_encodings::BGRA8;
-        msg->step = bgra.getStepBytes();
-        msg->is_bigendian = __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__;
-        auto* bgrGpuPtr = bgra.getPtr<sl::uchar1>(sl::MEM::GPU);
-        size_t size = msg->step * msg->height;
-        msg->data.resize(size);
-        checkCudaError(cudaMemcpy(msg->data.data(), bgrGpuPtr, size, cudaMemcpyDeviceToHost));
-    }
-
     void fillImuMessage(sl::SensorsData::IMUData& imuData, sensor_msgs::Imu& msg) {
         msg.header.stamp = ros::Time::now();
         msg.orientation.x = imuData.pose.getOrientation().x;
@@ -63,60 +48,4 @@ namespace mrover {
         msg.magnetic_field_covariance[8] = 0.047e-6;
     }
 
-    void fillCameraInfoMessages(sl::CalibrationParameters& calibration, const sl::Resolution& resolution,
-                                sensor_msgs::CameraInfoPtr const& leftInfoMsg, sensor_msgs::CameraInfoPtr const& rightInfoMsg) {
-        assert(leftInfoMsg);
-        assert(rightInfoMsg);
-
-        leftInfoMsg->width = resolution.width;
-        leftInfoMsg->height = resolution.height;
-        rightInfoMsg->width = resolution.width;
-        rightInfoMsg->height = resolution.height;
-        leftInfoMsg->distortion_model = sensor_msgs::distortion_models::PLUMB_BOB;
-        rightInfoMsg->distortion_model = sensor_msgs::distortion_models::PLUMB_BOB;
-        leftInfoMsg->D.resize(5);
-        rightInfoMsg->D.resize(5);
-        leftInfoMsg->D[0] = calibration.left_cam.disto[0];
-        leftInfoMsg->D[1] = calibration.left_cam.disto[1];
-        leftInfoMsg->D[2] = calibration.left_cam.disto[4];
-        leftInfoMsg->D[3] = calibration.left_cam.disto[2];
-        leftInfoMsg->D[4] = calibration.left_cam.disto[3];
-        rightInfoMsg->D[0] = calibration.right_cam.disto[0];
-        rightInfoMsg->D[1] = calibration.right_cam.disto[1];
-        rightInfoMsg->D[2] = calibration.right_cam.disto[4];
-        rightInfoMsg->D[3] = calibration.right_cam.disto[2];
-        rightInfoMsg->D[4] = calibration.right_cam.disto[3];
-        leftInfoMsg->K.fill(0.0);
-        rightInfoMsg->K.fill(0.0);
-        leftInfoMsg->K[0] = calibration.left_cam.fx;
-        leftInfoMsg->K[2] = calibration.left_cam.cx;
-        leftInfoMsg->K[4] = calibration.left_cam.fy;
-        leftInfoMsg->K[5] = calibration.left_cam.cy;
-        leftInfoMsg->K[8] = 1.0;
-        rightInfoMsg->K[0] = calibration.right_cam.fx;
-        rightInfoMsg->K[2] = calibration.right_cam.cx;
-        rightInfoMsg->K[4] = calibration.right_cam.fy;
-        rightInfoMsg->K[5] = calibration.right_cam.cy;
-        rightInfoMsg->K[8] = 1;
-        leftInfoMsg->R.fill(0.0);
-        rightInfoMsg->R.fill(0.0);
-        for (size_t i = 0; i < 3; ++i) {
-            leftInfoMsg->R[i * 3 + i] = 1.0;
-            rightInfoMsg->R[i * 3 + i] = 1.0;
-        }
-        leftInfoMsg->P.fill(0.0);
-        rightInfoMsg->P.fill(0.0);
-        leftInfoMsg->P[0] = calibration.left_cam.fx;
-        leftInfoMsg->P[2] = calibration.left_cam.cx;
-        leftInfoMsg->P[5] = calibration.left_cam.fy;
-        leftInfoMsg->P[6] = calibration.left_cam.cy;
-        leftInfoMsg->P[10] = 1.0;
-        rightInfoMsg->P[3] = -1.0 * calibration.left_cam.fx * calibration.getCameraBaseline();
-        rightInfoMsg->P[0] = calibration.right_cam.fx;
-        rightInfoMsg->P[2] = calibration.right_cam.cx;
-        rightInfoMsg->P[5] = calibration.right_cam.fy;
-        rightInfoMsg->P[6] = calibration.right_cam.cy;
-        rightInfoMsg->P[10] = 1.0;
-    }
-
 } // namespace mrover
@@ -9,16 +9,15 @@ namespace mrover {
     constexpr uint BLOCK_SIZE = 1024;
 
     /**
-     * @brief Runs on the GPU, interleaving the XYZ and BGRA buffers into a single buffer of #Point structs.
+     * @brief Runs on the GPU, interleaving the XYZ and BGRA buffers into a single buffer of @p PointT structs.
      */
-    __global__ void fillPointCloudMessageKernel(sl::float4* xyzGpuPtr, sl::uchar4* bgraGpuPtr, Point* pcGpuPtr, size_t size) {
+    template<typename PointT>
+    __global__ void fillPointCloudMessageKernel(sl::float4 const* xyzGpuPtr, sl::uchar4 const* bgraGpuPtr, PointT* pcGpuPtr, size_t size) {
         // This function is invoked once per element at index #i in the point cloud
         size_t i = blockIdx.x * blockDim.x + threadIdx.x;
         if (i >= size) return;
 
-        pcGpuPtr[i].x = xyzGpuPtr[i].x;
-        pcGpuPtr[i].y = xyzGpuPtr[i].y;
-        pcGpuPtr[i].z = xyzGpuPtr[i].z;
+        setPosition(pcGpuPtr[i], xyzGpuPtr[i].x, xyzGpuPtr[i].y, xyzGpuPtr[i].z);
         pcGpuPtr[i].b = bgraGpuPtr[i].r;
         pcGpuPtr[i].g = bgraGpuPtr[i].g;
         pcGpuPtr[i].r = bgraGpuPtr[i].b;
@@ -26,36 +25,35 @@ namespace mrover {
     }
 
     /**
-     * Fills a PointCloud2 message residing on the CPU from two GPU buffers (one for XYZ and one for BGRA).
+     * Fills a PointCloud2 message residing on the CPU from the XYZ and BGRA planes of a frame in GPU memory.
      *
-     * @param xyzGpu    XYZ buffer on the GPU
-     * @param bgraGpu   BGRA buffer on the GPU
-     * @param pcGpu     Point cloud buffer on the GPU (@see Point)
+     * @param frame     Frame with dense planes on the GPU
+     * @param pcGpu     Point cloud buffer on the GPU (@see ZedPoint)
      * @param msg       Point cloud message with buffer on the CPU
      */
-    void fillPointCloudMessageFromGpu(sl::Mat& xyzGpu, sl::Mat& bgraGpu, PointCloudGpu& pcGpu, sensor_msgs::PointCloud2Ptr const& msg) {
-        assert(bgraGpu.getWidth() >= xyzGpu.getWidth());
-        assert(bgraGpu.getHeight() >= xyzGpu.getHeight());
-        assert(bgraGpu.getChannels() == 4);
-        assert(xyzGpu.getChannels() == 4); // Last channel is unused
+    void fillPointCloudMessageFromGpu(StereoFrame const& frame, PointCloudGpu& pcGpu, sensor_msgs::PointCloud2Ptr const& msg) {
+        assert(frame.memory == FrameMemory::Device);
+        assert(frame.leftXyz && frame.leftBgra);
+        // The kernel indexes both planes as one flat array
+        assert(frame.leftXyz.step == frame.width * sizeof(sl::float4));
+        assert(frame.leftBgra.step == frame.width * sizeof(sl::uchar4));
         assert(msg);
 
-        auto* bgraGpuPtr = bgraGpu.getPtr<sl::uchar4>(sl::MEM::GPU);
-        auto* xyzGpuPtr = xyzGpu.getPtr<sl::float4>(sl::MEM::GPU);
-        msg->is_bigendian = __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__;
+        auto const* bgraGpuPtr = reinterpret_cast<sl::uchar4 const*>(frame.leftBgra.data);
+        auto const* xyzGpuPtr = reinterpret_cast<sl::float4 const*>(frame.leftXyz.data);
         msg->is_dense = true;
-        msg->height = bgraGpu.getHeight();
-        msg->width = bgraGpu.getWidth();
-        fillPointCloudMessageHeader(msg);
+        msg->height = frame.height;
+        msg->width = frame.width;
+        fillPointCloudMessageHeader<ZedPoint>(*msg);
         size_t size = msg->width * msg->height;
 
         pcGpu.resize(size);
-        Point* pcGpuPtr = pcGpu.data().get();
+        ZedPoint* pcGpuPtr = pcGpu.data().get();
         dim3 threadsPerBlock{BLOCK_SIZE};
         dim3 numBlocks{static_cast<uint>(std::ceil(static_cast<float>(size) / BLOCK_SIZE))};
         fillPointCloudMessageKernel<<<numBlocks, threadsPerBlock>>>(xyzGpuPtr, bgraGpuPtr, pcGpuPtr, size);
         checkCudaError(cudaPeekAtLastError());
-        checkCudaError(cudaMemcpy(msg->data.data(), pcGpuPtr, size * sizeof(Point), cudaMemcpyDeviceToHost));
+        checkCudaError(cudaMemcpy(msg->data.data(), pcGpuPtr, size * sizeof(ZedPoint), cudaMemcpyDeviceToHost));
     }
 
     void checkCudaError(cudaError_t err) {
@@ -5,26 +5,7 @@ namespace mrover {
     using namespace std::chrono_literals;
 
     /**
-     * Allows us to store enums as strings in the config file.
-     * This avoids problems when ZED updates their enum integer values.
-     *
-     * @tparam TEnum    ZED enum type
-     * @param string    String to convert to enum
-     * @return          Enum value
-     */
-    template<typename TEnum>
-    [[nodiscard]] TEnum stringToZedEnum(std::string_view string) {
-        using int_t = std::underlying_type_t<TEnum>;
-        for (int_t i = 0; i < static_cast<int_t>(TEnum::LAST); ++i) {
-            if (sl::String{string.data()} == sl::toString(static_cast<TEnum>(i))) {
-                return static_cast<TEnum>(i);
-            }
-        }
-        throw std::invalid_argument("Invalid enum string");
-    }
-
-    /**
-     * @brief Load config, open the ZED, and start our threads
+     * @brief Load config, open the frame source, and start our threads
      */
     void ZedNodelet::onInit() {
         try {
@@ -39,73 +20,81 @@ namespace mrover {
             mRightCamInfoPub = mNh.advertise<sensor_msgs::CameraInfo>("camera/right/camera_info", 1);
             mLeftImgPub = mNh.advertise<sensor_msgs::Image>("camera/left/image", 1);
             mRightImgPub = mNh.advertise<sensor_msgs::Image>("camera/right/image", 1);
+            mLeftDepthPub = mNh.advertise<sensor_msgs::Image>("camera/left/depth", 1);
 
-            std::string grabResolutionString;
-            mPnh.param("grab_resolution", grabResolutionString, std::string{sl::toString(sl::RESOLUTION::HD720)});
-            std::string depthModeString{};
-            mPnh.param("depth_mode", depthModeString, std::string{sl::toString(sl::DEPTH_MODE::PERFORMANCE)});
-            mPnh.param("grab_target_fps", mGrabTargetFps, 50);
+            std::string source;
+            mPnh.param("source", source, std::string{"zed"});
             int imageWidth{};
             int imageHeight{};
             mPnh.param("image_width", imageWidth, 1280);
             mPnh.param("image_height", imageHeight, 720);
-            mPnh.param("depth_confidence", mDepthConfidence, 70);
-            mPnh.param("texture_confidence", mTextureConfidence, 100);
-            std::string svoFile{};
-            mPnh.param("svo_file", svoFile, {});
-            mSvoPath = svoFile.c_str();
+            double sourceFps{};
+            mPnh.param("source_fps", sourceFps, 0.0);
             mPnh.param("use_builtin_visual_odom", mUseBuiltinPosTracking, false);
-            mPnh.param("use_area_memory", mUseAreaMemory, true);
-            mPnh.param("use_pose_smoothing", mUsePoseSmoothing, true);
             mPnh.param("use_loop_profiler", mUseLoopProfiler, true);
-            mPnh.param("use_depth_stabilization", mUseDepthStabilization, false);
-            mPnh.param("depth_maximum_distance", mDepthMaximumDistance, 12.0f);
 
-            if (imageWidth < 0 || imageHeight < 0) {
+            if (imageWidth <= 0 || imageHeight <= 0) {
                 throw std::invalid_argument("Invalid image dimensions");
             }
-            if (mGrabTargetFps < 0) {
-                throw std::invalid_argument("Invalid grab target framerate");
-            }
 
-            mImageResolution = sl::Resolution(imageWidth, imageHeight);
-            mPointResolution = sl::Resolution(imageWidth, imageHeight);
-
-            NODELET_INFO("Resolution: %s image: %zux%zu points: %zux%zu",
-                         grabResolutionString.c_str(), mImageResolution.width, mImageResolution.height, mPointResolution.width, mPointResolution.height);
-            NODELET_INFO("Use builtin visual odometry: %s", mUseBuiltinPosTracking ? "true" : "false");
+            NODELET_INFO("Frame source: %s", source.c_str());
+            if (source == "zed") {
+#ifdef MROVER_WITH_ZED
+                ZedParameters parameters;
+                mPnh.param("grab_resolution", parameters.grabResolution, std::string{sl::toString(sl::RESOLUTION::HD720)});
+                mPnh.param("depth_mode", parameters.depthMode, std::string{sl::toString(sl::DEPTH_MODE::PERFORMANCE)});
+                mPnh.param("grab_target_fps", parameters.grabTargetFps, 50);
+                mPnh.param("depth_confidence", parameters.depthConfidence, 70);
+                mPnh.param("texture_confidence", parameters.textureConfidence, 100);
+                mPnh.param("svo_file", parameters.svoFile, {});
+                mPnh.param("use_area_memory", parameters.useAreaMemory, true);
+                mPnh.param("use_pose_smoothing", parameters.usePoseSmoothing, true);
+                mPnh.param("use_depth_stabilization", parameters.useDepthStabilization, false);
+                mPnh.param("depth_maximum_distance", parameters.depthMaximumDistance, 12.0f);
+                mPnh.param("retrieve_to_host", parameters.retrieveToHost, false);
+                parameters.useBuiltinPosTracking = mUseBuiltinPosTracking;
+                parameters.imageWidth = imageWidth;
+                parameters.imageHeight = imageHeight;
+
+                if (parameters.grabTargetFps < 0) {
+                    throw std::invalid_argument("Invalid grab target framerate");
+                }
 
-            sl::InitParameters initParameters;
-            if (mSvoPath) {
-                initParameters.input.setFromSVOFile(mSvoPath);
+                NODELET_INFO("Resolution: %s image: %dx%d", parameters.grabResolution.c_str(), imageWidth, imageHeight);
+                NODELET_INFO("Use builtin visual odometry: %s", mUseBuiltinPosTracking ? "true" : "false");
+                mSource = std::make_unique<ZedFrameSource>(parameters);
+#else
+                throw std::invalid_argument("Built without the ZED SDK, use the recorded or synthetic source");
+#endif
+            } else if (source == "recorded") {
+                std::string recordedFile;
+                bool loopRecording{};
+                mPnh.param("recorded_file", recordedFile, {});
+                mPnh.param("loop_recording", loopRecording, true);
+                auto recorded = std::make_unique<RecordedFrameSource>(recordedFile, loopRecording, sourceFps);
+                NODELET_INFO("Replaying %zu frames from %s", recorded->frameCount(), recordedFile.c_str());
+                mSource = std::move(recorded);
+            } else if (source == "synthetic") {
+                mSource = std::make_unique<SyntheticFrameSource>(imageWidth, imageHeight, sourceFps);
             } else {
-                initParameters.input.setFromCameraID(-1, sl::BUS_TYPE::USB);
-            }
-            initParameters.depth_stabilization = mUseDepthStabilization;
-            initParameters.camera_resolution = stringToZedEnum<sl::RESOLUTION>(grabResolutionString);
-            initParameters.depth_mode = stringToZedEnum<sl::DEPTH_MODE>(depthModeString);
-            initParameters.coordinate_units = sl::UNIT::METER;
-            initParameters.sdk_verbose = true; // Log useful information
-            initParameters.camera_fps = mGrabTargetFps;
-            initParameters.coordinate_system = sl::COORDINATE_SYSTEM::RIGHT_HANDED_Z_UP_X_FWD; // Match ROS
-            initParameters.depth_maximum_distance = mDepthMaximumDistance;
-
-            if (mZed.open(initParameters) != sl::ERROR_CODE::SUCCESS) {
-                throw std::runtime_error("ZED failed to open");
+                throw std::invalid_argument("Invalid frame source: " + source);
             }
-            mZedInfo = mZed.getCameraInformation();
 
-            if (mUseBuiltinPosTracking) {
-                sl::PositionalTrackingParameters positionalTrackingParameters;
-                positionalTrackingParameters.enable_pose_smoothing = mUsePoseSmoothing;
-                positionalTrackingParameters.enable_area_memory = mUseAreaMemory;
-                mZed.enablePositionalTracking(positionalTrackingParameters);
+            std::string recordFile;
+            mPnh.param("record_file", recordFile, {});
+            if (!recordFile.empty()) {
+                NODELET_INFO("Recording frames to %s", recordFile.c_str());
+                mRecorder = std::make_unique<FrameRecorder>(recordFile, imageWidth, imageHeight, mSource->calibration());
             }
 
-            cudaDeviceProp prop{};
-            cudaGetDeviceProperties(&prop, 0);
-            ROS_INFO("MP count: %d, Max threads/MP: %d, Max blocks/MP: %d, max threads/block: %d",
-                     prop.multiProcessorCount, prop.maxThreadsPerMultiProcessor, prop.maxBlocksPerMultiProcessor, prop.maxThreadsPerBlock);
+            if (mUseLoopProfiler) {
+                double profilerPeriod{};
+                bool logProfiler{}, traceProfiler{};
+                mPnh.param("loop_profiler_period", profilerPeriod, 1.0);
+                mPnh.param("log_loop_profiler", logProfiler, false);
+                mPnh.param("trace_loop_profiler", traceProfiler, false);
+                mProfilerReporter.emplace(mNh, mPnh, std::vector{&mGrabThreadProfiler, &mPcThreadProfiler}, profilerPeriod, logProfiler, traceProfiler);
+            }
 
             mGrabThread = std::thread(&ZedNodelet::grabUpdate, this);
             mPointCloudThread = std::thread(&ZedNodelet::pointCloudUpdate, this);
@@ -116,55 +105,68 @@ namespace mrover {
         }
     }
 
+    void ZedNodelet::fillPointCloudMessage(StereoFrame const& frame, sensor_msgs::PointCloud2Ptr const& msg) {
+#ifdef MROVER_WITH_ZED
+        if (frame.memory == FrameMemory::Device) return fillPointCloudMessageFromGpu(frame, mPointCloudGpu, msg);
+#endif
+        fillPointCloudMessageFromHost(frame, msg);
+    }
+
     /**
-     * @brief Processes grabbed data from ZED.
+     * @brief Processes frames from the grab thread.
      *
-     * Takes in the GPU pointers to the image and the point cloud.
+     * Takes in the image and point cloud planes, on the GPU for the ZED and on the CPU for the other sources.
      * It fuses these into a point cloud 2 message which is published.
      */
     void ZedNodelet::pointCloudUpdate() {
         try {
             NODELET_INFO("Starting point cloud thread");
 
-            while (ros::ok()) {
-                mPcThreadProfiler.beginLoop();
-
-                // TODO: probably bad that this allocation, best case optimized by tcache
-                // Needed because publish directly shares the pointer to other nodelets running in this process
-                auto pointCloudMsg = boost::make_shared<sensor_msgs::PointCloud2>();
-
-                // Swap critical section
-                {
-                    std::unique_lock lock{mSwapMutex};
-                    // Waiting on the condition variable will drop the lock and reacquire it when the condition is met
-                    mSwapCv.wait(lock, [this] { return mIsSwapReady; });
-                    mIsSwapReady = false;
-                    mPcThreadProfiler.measureEvent("Wait");
-
-                    fillPointCloudMessageFromGpu(mPcMeasures.leftPoints, mPcMeasures.leftImage, mPointCloudGpu, pointCloudMsg);
-                    pointCloudMsg->header.seq = mPointCloudUpdateTick;
-                    pointCloudMsg->header.stamp = mPcMeasures.time;
-                    pointCloudMsg->header.frame_id = "zed2i_left_camera_frame";
-                    mPcThreadProfiler.measureEvent("Fill Message");
-
-                    if (mLeftImgPub.getNumSubscribers()) {
-                        auto leftImgMsg = boost::make_shared<sensor_msgs::Image>();
-                        fillImageMessage(mPcMeasures.leftImage, leftImgMsg);
-                        leftImgMsg->header.frame_id = "zed2i_left_camera_optical_frame";
-                        leftImgMsg->header.stamp = mPcMeasures.time;
-                        leftImgMsg->header.seq = mPointCloudUpdateTick;
-                        mLeftImgPub.publish(leftImgMsg);
-                    }
-                    if (mRightImgPub.getNumSubscribers()) {
-                        auto rightImgMsg = boost::make_shared<sensor_msgs::Image>();
-                        fillImageMessage(mPcMeasures.rightImage, rightImgMsg);
-                        rightImgMsg->header.frame_id = "zed2i_right_camera_optical_frame";
-                        rightImgMsg->header.stamp = mPcMeasures.time;
-                        rightImgMsg->header.seq = mPointCloudUpdateTick;
-                        mRightImgPub.publish(rightImgMsg);
-                    }
-                    mPcThreadProfiler.measureEvent("Publish Message");
+            // Blocks until the grab thread has a frame this thread has not seen, stops once the grab thread is done
+            while (mFrames.waitAndConsume()) {
+                // Same as the header sequence of the messages made from this frame, so downstream nodelets line up in a trace
+                mPcThreadProfiler.beginLoop(mPointCloudUpdateTick);
+                mPcThreadProfiler.measureEvent("Wait");
+
+                // The grab thread never writes into this buffer, so it can be read without holding anything
+                StereoFrame const& frame = mFrames.front();
+
+                // Publish directly shares the pointer to other nodelets running in this process, so the message comes from a pool
+                // Once they are all done with it, it is reused without reallocating its buffer
+                sensor_msgs::PointCloud2Ptr pointCloudMsg = mPointCloudMsgPool.acquire();
+
+                fillPointCloudMessage(frame, pointCloudMsg);
+                pointCloudMsg->header.seq = mPointCloudUpdateTick;
+                pointCloudMsg->header.stamp = frame.time;
+                pointCloudMsg->header.frame_id = "zed2i_left_camera_frame";
+                mPcThreadProfiler.measureEvent("Fill Message");
+
+                if (mLeftImgPub.getNumSubscribers()) {
+                    sensor_msgs::ImagePtr leftImgMsg = mLeftImgMsgPool.acquire();
+                    fillImageMessage(frame.leftBgra, frame.memory, frame.width, frame.height, leftImgMsg);
+                    leftImgMsg->header.frame_id = "zed2i_left_camera_optical_frame";
+                    leftImgMsg->header.stamp = frame.time;
+                    leftImgMsg->header.seq = mPointCloudUpdateTick;
+                    mLeftImgPub.publish(leftImgMsg);
+                }
+                if (mRightImgPub.getNumSubscribers() && frame.rightBgra) {
+                    sensor_msgs::ImagePtr rightImgMsg = mRightImgMsgPool.acquire();
+                    fillImageMessage(frame.rightBgra, frame.memory, frame.width, frame.height, rightImgMsg);
+                    rightImgMsg->header.frame_id = "zed2i_right_camera_optical_frame";
+                    rightImgMsg->header.stamp = frame.time;
+                    rightImgMsg->header.seq = mPointCloudUpdateTick;
+                    mRightImgPub.publish(rightImgMsg);
                 }
+                if (mLeftDepthPub.getNumSubscribers() && frame.leftDepth) {
+                    // Depth along the optical axis in meters, together with the left image and camera info this is a much smaller alternative to the point cloud
+                    sensor_msgs::ImagePtr leftDepthMsg = mLeftDepthMsgPool.acquire();
+                    fillDepthMessage(frame.leftDepth, frame.memory, frame.width, frame.height, leftDepthMsg);
+                    leftDepthMsg->header.frame_id = "zed2i_left_camera_optical_frame";
+                    leftDepthMsg->header.stamp = frame.time;
+                    leftDepthMsg->header.seq = mPointCloudUpdateTick;
+                    mLeftDepthPub.publish(leftDepthMsg);
+                }
+                mPcThreadProfiler.measureEvent("Publish Message");
 
                 if (mPcPub.getNumSubscribers()) {
                     mPcPub.publish(pointCloudMsg);
@@ -172,21 +174,30 @@ namespace mrover {
                 }
 
                 if (mLeftCamInfoPub.getNumSubscribers() || mRightCamInfoPub.getNumSubscribers()) {
-                    sl::CalibrationParameters calibration = mZedInfo.camera_configuration.calibration_parameters;
                     auto leftCamInfoMsg = boost::make_shared<sensor_msgs::CameraInfo>();
                     auto rightCamInfoMsg = boost::make_shared<sensor_msgs::CameraInfo>();
-                    fillCameraInfoMessages(calibration, mImageResolution, leftCamInfoMsg, rightCamInfoMsg);
+                    fillCameraInfoMessages(mSource->calibration(), frame.width, frame.height, leftCamInfoMsg, rightCamInfoMsg);
                     leftCamInfoMsg->header.frame_id = "zed2i_left_camera_optical_frame";
-                    leftCamInfoMsg->header.stamp = mPcMeasures.time;
+                    leftCamInfoMsg->header.stamp = frame.time;
                     leftCamInfoMsg->header.seq = mPointCloudUpdateTick;
                     rightCamInfoMsg->header.frame_id = "zed2i_right_camera_optical_frame";
-                    rightCamInfoMsg->header.stamp = mPcMeasures.time;
+                    rightCamInfoMsg->header.stamp = frame.time;
                     rightCamInfoMsg->header.seq = mPointCloudUpdateTick;
                     mLeftCamInfoPub.publish(leftCamInfoMsg);
                     mRightCamInfoPub.publish(rightCamInfoMsg);
                     mPcThreadProfiler.measureEvent("Image + camera info publish");
                 }
 
+                if (mRecorder) {
+                    mRecorder->write(frame);
+                    mPcThreadProfiler.measureEvent("Record");
+                }
+
+                if (mPointCloudUpdateTick % 300 == 0) {
+                    MessagePoolStats stats = mPointCloudMsgPool.stats();
+                    NODELET_DEBUG("Point cloud message pool hits: %zu misses: %zu outstanding: %zu idle: %zu", stats.hits, stats.misses, stats.outstanding, stats.idle);
+                }
+
                 mPointCloudUpdateTick++;
             }
             NODELET_INFO("Tag thread finished");
@@ -199,105 +210,78 @@ namespace mrover {
     }
 
     /**
-     * @brief Grabs measures from the ZED.
+     * @brief Grabs frames from the source.
      *
-     * This update loop needs to happen as fast as possible.
-     * grab() on the ZED updates positional tracking (visual odometry) which works best at high update rates.
-     * As such we retrieve the image and point cloud on the GPU to send to the other thread for processing.
-     * This only happens if the other thread is ready to avoid blocking, hence the try lock.
+     * This update loop needs to happen as fast as possible, the ZED runs positional tracking (visual odometry) in grab.
+     * Frames are handed to the point cloud thread through a triple buffer so this thread never blocks on the other one.
      */
     void ZedNodelet::grabUpdate() {
         try {
             NODELET_INFO("Starting grab thread");
             while (ros::ok()) {
-                mGrabThreadProfiler.beginLoop();
+                mGrabThreadProfiler.beginLoop(mGrabUpdateTick);
 
-                sl::RuntimeParameters runtimeParameters;
-                runtimeParameters.confidence_threshold = mDepthConfidence;
-                runtimeParameters.texture_confidence_threshold = mTextureConfidence;
+                // Replaying or generating as fast as possible, only make a frame once the point cloud thread took the last one
+                if (mSource->isOnDemand()) {
+                    mFrames.waitUntilConsumed();
+                    mGrabThreadProfiler.measureEvent("Wait");
+                }
 
-                if (mZed.grab(runtimeParameters) != sl::ERROR_CODE::SUCCESS)
-                    throw std::runtime_error("ZED failed to grab");
+                StereoFrame& frame = mFrames.back();
+                // A recording has to hold every plane whoever is subscribed
+                FrameRequest request{mRightImgPub.getNumSubscribers() > 0 || mRecorder, mLeftDepthPub.getNumSubscribers() > 0 || mRecorder};
+                if (!mSource->grab(frame, request)) {
+                    NODELET_INFO("Frame source has no more frames");
+                    break;
+                }
                 mGrabThreadProfiler.measureEvent("Grab");
 
-                // Retrieval has to happen on the same thread as grab so that the image and point cloud are synced
-                if (mRightImgPub.getNumSubscribers())
-                    if (mZed.retrieveImage(mGrabMeasures.rightImage, sl::VIEW::RIGHT, sl::MEM::GPU, mImageResolution) != sl::ERROR_CODE::SUCCESS)
-                        throw std::runtime_error("ZED failed to retrieve right image");
-                // Only left set is used for processing
-                if (mZed.retrieveImage(mGrabMeasures.leftImage, sl::VIEW::LEFT, sl::MEM::GPU, mImageResolution) != sl::ERROR_CODE::SUCCESS)
-                    throw std::runtime_error("ZED failed to retrieve left image");
-                if (mZed.retrieveMeasure(mGrabMeasures.leftPoints, sl::MEASURE::XYZ, sl::MEM::GPU, mPointResolution) != sl::ERROR_CODE::SUCCESS)
-                    throw std::runtime_error("ZED failed to retrieve point cloud");
-
-                assert(mGrabMeasures.leftImage.timestamp == mGrabMeasures.leftPoints.timestamp);
-
-
-                mGrabMeasures.time = mSvoPath ? ros::Time::now() : slTime2Ros(mZed.getTimestamp(sl::TIME_REFERENCE::IMAGE));
-                mGrabThreadProfiler.measureEvent("Retrieve");
-
-                // If the processing thread is busy skip
+                // Never waits on the processing thread, if it is still busy it gets this frame instead of the last one when it is done
                 // We want this thread to run as fast as possible for grab and positional tracking
-                if (mSwapMutex.try_lock()) {
-                    std::swap(mGrabMeasures, mPcMeasures);
-                    mIsSwapReady = true;
-                    mSwapMutex.unlock();
-                    mSwapCv.notify_one();
-                }
-                mGrabThreadProfiler.measureEvent("Try swap");
+                mFrames.publish();
+                mGrabThreadProfiler.measureEvent("Publish");
 
                 // Positional tracking module publishing
                 if (mUseBuiltinPosTracking) {
-                    sl::Pose pose;
-                    sl::POSITIONAL_TRACKING_STATE status = mZed.getPosition(pose);
-                    if (status == sl::POSITIONAL_TRACKING_STATE::OK) {
-                        sl::Translation const& translation = pose.getTranslation();
-                        sl::Orientation const& orientation = pose.getOrientation();
+                    if (std::optional<SE3> leftCameraInOdom = mSource->leftCameraInOdom()) {
                         try {
-                            SE3 leftCameraInOdom{{translation.x, translation.y, translation.z},
-                                                 Eigen::Quaterniond{orientation.w, orientation.x, orientation.y, orientation.z}.normalized()};
                             SE3 leftCameraInBaseLink = SE3::fromTfTree(mTfBuffer, "base_link", "zed2i_left_camera_frame");
-                            SE3 baseLinkInOdom = leftCameraInBaseLink * leftCameraInOdom;
+                            SE3 baseLinkInOdom = leftCameraInBaseLink * leftCameraInOdom.value();
                             SE3::pushToTfTree(mTfBroadcaster, "base_link", "odom", baseLinkInOdom);
                         } catch (tf2::TransformException& e) {
                             NODELET_WARN_STREAM("Failed to get transform: " << e.what());
                         }
-                    } else {
-                        NODELET_WARN_STREAM("Positional tracking failed: " << status);
                     }
                     mGrabThreadProfiler.measureEvent("Positional tracking");
                 }
 
                 // Publish IMU and magnetometer data
-                if (mZedInfo.camera_model == sl::MODEL::ZED2i && mImuPub.getNumSubscribers()) {
-                    sl::SensorsData sensorData;
-                    mZed.getSensorsData(sensorData, sl::TIME_REFERENCE::CURRENT);
-
+                if (mImuPub.getNumSubscribers()) {
                     sensor_msgs::Imu imuMsg;
-                    fillImuMessage(sensorData.imu, imuMsg);
-                    imuMsg.header.frame_id = "zed2i_mag_frame";
-                    imuMsg.header.stamp = ros::Time::now();
-                    imuMsg.header.seq = mGrabUpdateTick;
-                    mImuPub.publish(imuMsg);
-
                     sensor_msgs::MagneticField magMsg;
-                    fillMagMessage(sensorData.magnetometer, magMsg);
-                    magMsg.header.frame_id = "zed2i_mag_frame";
-                    magMsg.header.stamp = ros::Time::now();
-                    magMsg.header.seq = mGrabUpdateTick;
-                    mMagPub.publish(magMsg);
-                    mGrabThreadProfiler.measureEvent("Sensor data");
+                    if (mSource->readInertial(imuMsg, magMsg)) {
+                        imuMsg.header.frame_id = "zed2i_mag_frame";
+                        imuMsg.header.stamp = ros::Time::now();
+                        imuMsg.header.seq = mGrabUpdateTick;
+                        mImuPub.publish(imuMsg);
+
+                        magMsg.header.frame_id = "zed2i_mag_frame";
+                        magMsg.header.stamp = ros::Time::now();
+                        magMsg.header.seq = mGrabUpdateTick;
+                        mMagPub.publish(magMsg);
+                        mGrabThreadProfiler.measureEvent("Sensor data");
+                    }
                 }
 
                 mGrabUpdateTick++;
             }
 
-            mZed.close();
+            mFrames.close();
             NODELET_INFO("Grab thread finished");
 
         } catch (std::exception const& e) {
             NODELET_FATAL("Exception while running grab thread: %s", e.what());
-            mZed.close();
+            mSource.reset();
             ros::shutdown();
             std::exit(EXIT_FAILURE);
         }
@@ -305,20 +289,8 @@ namespace mrover {
 
     ZedNodelet::~ZedNodelet() {
         NODELET_INFO("ZED node shutting down");
-        mPointCloudThread.join();
-        mGrabThread.join();
-    }
-
-    ZedNodelet::Measures::Measures(ZedNodelet::Measures&& other) noexcept {
-        *this = std::move(other);
-    }
-
-    ZedNodelet::Measures& ZedNodelet::Measures::operator=(ZedNodelet::Measures&& other) noexcept {
-        sl::Mat::swap(other.leftImage, leftImage);
-        sl::Mat::swap(other.rightImage, rightImage);
-        sl::Mat::swap(other.leftPoints, leftPoints);
-        std::swap(time, other.time);
-        return *this;
+        if (mPointCloudThread.joinable()) mPointCloudThread.join();
+        if (mGrabThread.joinable()) mGrabThread.join();
     }
 } // namespace mrover
 
@@ -0,0 +1,176 @@
+#include "zed_wrapper.hpp"
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+#include <tbb/blocked_range.h>
+#include <tbb/parallel_for.h>
+
+namespace mrover {
+
+    // The vector paths copy XYZW and replace W with the color, which only works for this layout
+    static_assert(sizeof(ZedPoint) == 16 && offsetof(ZedPoint, x) == 0 && offsetof(ZedPoint, b) == 12);
+
+    /**
+     * @brief Interleaves one row of points, returns how many were handled so the caller can finish the tail.
+     *
+     * @param xyzw  Four floats per point, the fourth is dropped
+     * @param bgra  Four bytes per point, stored in the point in the same order
+     */
+    size_t interleaveRowSimd([[maybe_unused]] uint8_t const* xyzw, [[maybe_unused]] uint8_t const* bgra, [[maybe_unused]] ZedPoint* points, [[maybe_unused]] size_t count) {
+        [[maybe_unused]] constexpr size_t LANES = 4;
+
+        size_t i = 0;
+#if defined(__SSE2__)
+        // Message buffers come from operator new, which aligns to 16 bytes, so every point is aligned
+        if (reinterpret_cast<uintptr_t>(points) % alignof(__m128i)) return 0;
+
+        __m128i const colorMask = _mm_setr_epi32(0, 0, 0, -1);
+        // Positions are moved as integers, NaNs for missing depth come through bit for bit
+        auto store = [&](size_t j, __m128i color) {
+            __m128i position = _mm_loadu_si128(reinterpret_cast<__m128i const*>(xyzw + j * 16));
+            __m128i point = _mm_or_si128(_mm_andnot_si128(colorMask, position), _mm_and_si128(colorMask, color));
+            // A whole cloud is far larger than the cache, streaming skips reading in lines that are about to be overwritten
+            _mm_stream_si128(reinterpret_cast<__m128i*>(points + j), point);
+        };
+        for (; i + LANES <= count; i += LANES) {
+            __m128i colors = _mm_loadu_si128(reinterpret_cast<__m128i const*>(bgra + i * 4));
+            // Broadcast each color into the last lane of its point
+            store(i + 0, _mm_shuffle_epi32(colors, _MM_SHUFFLE(0, 0, 0, 0)));
+            store(i + 1, _mm_shuffle_epi32(colors, _MM_SHUFFLE(1, 1, 1, 1)));
+            store(i + 2, _mm_shuffle_epi32(colors, _MM_SHUFFLE(2, 2, 2, 2)));
+            store(i + 3, _mm_shuffle_epi32(colors, _MM_SHUFFLE(3, 3, 3, 3)));
+        }
+        // Streaming stores are weakly ordered, make them visible before anyone else reads the message
+        _mm_sfence();
+#elif defined(__ARM_NEON)
+        for (; i + LANES <= count; i += LANES) {
+            // De-interleave into x, y, z, w planes, swap the w plane for the colors, and interleave again
+            uint32x4x4_t planes = vld4q_u32(reinterpret_cast<uint32_t const*>(xyzw + i * 16));
+            planes.val[3] = vld1q_u32(reinterpret_cast<uint32_t const*>(bgra + i * 4));
+            vst4q_u32(reinterpret_cast<uint32_t*>(points + i), planes);
+        }
+#endif
+        return i;
+    }
+
+    void interleaveRow(uint8_t const* xyzw, uint8_t const* bgra, ZedPoint* points, size_t count) {
+        for (size_t i = interleaveRowSimd(xyzw, bgra, points, count); i < count; ++i) {
+            auto* point = reinterpret_cast<uint8_t*>(points + i);
+            std::memcpy(point + offsetof(ZedPoint, x), xyzw + i * 16, 3 * sizeof(float));
+            std::memcpy(point + offsetof(ZedPoint, b), bgra + i * 4, 4);
+        }
+    }
+
+    /**
+     * @brief Copies a plane into dense host memory, from wherever the frame lives.
+     *
+     * @param rowBytes  Bytes of a row without padding, @p dst has to hold this times @p rows
+     */
+    void copyFrameBuffer(FrameBuffer const& src, FrameMemory memory, size_t rowBytes, size_t rows, uint8_t* dst) {
+        assert(src);
+        assert(src.step >= rowBytes);
+
+#ifdef MROVER_WITH_ZED
+        if (memory == FrameMemory::Device) {
+            checkCudaError(cudaMemcpy2D(dst, rowBytes, src.data, src.step, rowBytes, rows, cudaMemcpyDeviceToHost));
+            return;
+        }
+#endif
+        if (memory != FrameMemory::Host) throw std::runtime_error{"Frame is in device memory but CUDA is not available"};
+
+        if (src.step == rowBytes) {
+            std::memcpy(dst, src.data, rowBytes * rows);
+            return;
+        }
+        for (size_t row = 0; row < rows; ++row) {
+            std::memcpy(dst + row * rowBytes, src.data + row * src.step, rowBytes);
+        }
+    }
+
+    /**
+     * Fills a PointCloud2 message from the XYZ and BGRA planes of a frame in host memory.
+     *
+     * Produces the same bytes as the GPU kernel: the position followed by the color bytes in the order of the image.
+     * The kernel's "b = bgra.r" is only a naming quirk of sl::uchar4, whose r is the first byte, which is blue.
+     * Rows are split across threads and each row runs a vectorized kernel (SSE2 on x86-64, NEON on ARM).
+     * On boards where the GPU shares memory with the CPU this can beat a kernel launch followed by a blocking copy.
+     */
+    void fillPointCloudMessageFromHost(StereoFrame const& frame, sensor_msgs::PointCloud2Ptr const& msg) {
+        assert(frame.memory == FrameMemory::Host);
+        assert(frame.leftXyz && frame.leftBgra);
+        assert(msg);
+
+        msg->is_dense = true;
+        msg->height = frame.height;
+        msg->width = frame.width;
+        fillPointCloudMessageHeader<ZedPoint>(*msg);
+
+        PointCloudView<ZedPoint> points{*msg};
+        tbb::parallel_for(tbb::blocked_range<uint32_t>{0, frame.height}, [&](tbb::blocked_range<uint32_t> const& rows) {
+            for (uint32_t v = rows.begin(); v < rows.end(); ++v) {
+                interleaveRow(frame.leftXyz.data + v * frame.leftXyz.step, frame.leftBgra.data + v * frame.leftBgra.step, points.row(v), frame.width);
+            }
+        });
+    }
+
+    void fillImageMessage(FrameBuffer const& bgra, FrameMemory memory, uint32_t width, uint32_t height, sensor_msgs::ImagePtr const& msg) {
+        assert(msg);
+
+        msg->height = height;
+        msg->width = width;
+        msg->encoding = sensor_msgs::image_encodings::BGRA8;
+        msg->step = width * 4;
+        msg->is_bigendian = __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__;
+        msg->data.resize(static_cast<size_t>(msg->step) * msg->height);
+        copyFrameBuffer(bgra, memory, msg->step, msg->height, msg->data.data());
+    }
+
+    void fillDepthMessage(FrameBuffer const& depth, FrameMemory memory, uint32_t width, uint32_t height, sensor_msgs::ImagePtr const& msg) {
+        assert(msg);
+
+        msg->height = height;
+        msg->width = width;
+        msg->encoding = sensor_msgs::image_encodings::TYPE_32FC1;
+        msg->step = width * sizeof(float);
+        msg->is_bigendian = __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__;
+        msg->data.resize(static_cast<size_t>(msg->step) * msg->height);
+        copyFrameBuffer(depth, memory, msg->step, msg->height, msg->data.data());
+    }
+
+    void fillCameraInfoMessages(StereoCalibration const& calibration, uint32_t width, uint32_t height,
+                                sensor_msgs::CameraInfoPtr const& leftInfoMsg, sensor_msgs::CameraInfoPtr const& rightInfoMsg) {
+        assert(leftInfoMsg);
+        assert(rightInfoMsg);
+
+        auto fill = [&](CameraIntrinsics const& intrinsics, sensor_msgs::CameraInfo& msg) {
+            msg.width = width;
+            msg.height = height;
+            msg.distortion_model = sensor_msgs::distortion_models::PLUMB_BOB;
+            msg.D.assign(intrinsics.distortion.begin(), intrinsics.distortion.end());
+            msg.K.fill(0.0);
+            msg.K[0] = intrinsics.fx;
+            msg.K[2] = intrinsics.cx;
+            msg.K[4] = intrinsics.fy;
+            msg.K[5] = intrinsics.cy;
+            msg.K[8] = 1.0;
+            msg.R.fill(0.0);
+            for (size_t i = 0; i < 3; ++i) {
+                msg.R[i * 3 + i] = 1.0;
+            }
+            msg.P.fill(0.0);
+            msg.P[0] = intrinsics.fx;
+            msg.P[2] = intrinsics.cx;
+            msg.P[5] = intrinsics.fy;
+            msg.P[6] = intrinsics.cy;
+            msg.P[10] = 1.0;
+        };
+        fill(calibration.left, *leftInfoMsg);
+        fill(calibration.right, *rightInfoMsg);
+        rightInfoMsg->P[3] = -1.0 * calibration.left.fx * calibration.baseline;
+    }
+
+} // namespace mrover
@@ -3,64 +3,98 @@
 #include "pch.hpp"
 
 #include "../point.hpp"
+#include "frame_source.hpp"
 
 namespace mrover {
 
-    using PointCloudGpu = thrust::device_vector<Point>;
+    // Layout of the published point cloud, normals are never filled so the full #Point layout would only waste bandwidth
+    using ZedPoint = PointXYZRGB;
+
+#ifdef MROVER_WITH_ZED
+    using PointCloudGpu = thrust::device_vector<ZedPoint>;
+
+    struct ZedParameters {
+        std::string grabResolution;
+        std::string depthMode;
+        std::string svoFile;
+        int grabTargetFps{};
+        size_t imageWidth{}, imageHeight{};
+        int depthConfidence{};
+        int textureConfidence{};
+        bool useBuiltinPosTracking{};
+        bool useAreaMemory{};
+        bool usePoseSmoothing{};
+        bool useDepthStabilization{};
+        bool retrieveToHost{};
+        float depthMaximumDistance{};
+    };
 
-    class ZedNodelet : public nodelet::Nodelet {
-    private:
-        struct Measures {
-            ros::Time time;
-            sl::Mat leftImage;
-            sl::Mat rightImage;
-            sl::Mat leftPoints;
+    /**
+     * @brief Frames from a ZED, either live or replaying an SVO file. They stay in GPU memory unless retrieved to the host.
+     */
+    class ZedFrameSource final : public FrameSource {
+        struct Storage;
+
+        ZedParameters mParameters;
+        sl::Camera mZed;
+        sl::CameraInformation mZedInfo;
+        sl::RuntimeParameters mRuntimeParameters;
 
-            Measures() = default;
+    public:
+        /**
+         * @throws std::runtime_error If the ZED fails to open
+         */
+        explicit ZedFrameSource(ZedParameters const& parameters);
+
+        ~ZedFrameSource() override;
+
+        bool grab(StereoFrame& frame, FrameRequest const& request) override;
 
-            Measures(Measures&) = delete;
-            Measures& operator=(Measures&) = delete;
+        [[nodiscard]] StereoCalibration calibration() const override;
 
-            Measures(Measures&&) noexcept;
-            Measures& operator=(Measures&&) noexcept;
-        };
+        std::optional<SE3> leftCameraInOdom() override;
 
+        bool readInertial(sensor_msgs::Imu& imuMsg, sensor_msgs::MagneticField& magMsg) override;
+    };
+#endif
+
+    class ZedNodelet : public nodelet::Nodelet {
+    private:
         ros::NodeHandle mNh, mPnh;
 
         tf2_ros::Buffer mTfBuffer;
         tf2_ros::TransformListener mTfListener{mTfBuffer};
         tf2_ros::TransformBroadcaster mTfBroadcaster;
-        ros::Publisher mPcPub, mImuPub, mMagPub, mLeftCamInfoPub, mRightCamInfoPub, mLeftImgPub, mRightImgPub;
+        ros::Publisher mPcPub, mImuPub, mMagPub, mLeftCamInfoPub, mRightCamInfoPub, mLeftImgPub, mRightImgPub, mLeftDepthPub;
 
+#ifdef MROVER_WITH_ZED
         PointCloudGpu mPointCloudGpu;
+#endif
+
+        // Published messages are shared with nodelets in the same process, these recycle them once every subscriber is done
+        MessagePool<sensor_msgs::PointCloud2> mPointCloudMsgPool;
+        MessagePool<sensor_msgs::Image> mLeftImgMsgPool, mRightImgMsgPool, mLeftDepthMsgPool;
 
-        sl::Resolution mImageResolution, mPointResolution;
-        sl::String mSvoPath;
-        int mGrabTargetFps{};
-        int mDepthConfidence{};
-        int mTextureConfidence{};
         bool mUseBuiltinPosTracking{};
-        bool mUseAreaMemory{};
-        bool mUsePoseSmoothing{};
         bool mUseLoopProfiler{};
-        bool mUseDepthStabilization{};
-        float mDepthMaximumDistance{};
 
-        sl::Camera mZed;
-        sl::CameraInformation mZedInfo;
-        Measures mGrabMeasures, mPcMeasures;
+        std::unique_ptr<FrameSource> mSource;
+        // Every frame handed to the point cloud thread is also written here when recording
+        std::unique_ptr<FrameRecorder> mRecorder;
+        // The grab thread publishes every frame without waiting, the point cloud thread always takes the newest one
+        TripleBuffer<StereoFrame> mFrames;
 
         std::thread mPointCloudThread, mGrabThread;
-        std::mutex mSwapMutex;
-        std::condition_variable mSwapCv;
-        bool mIsSwapReady = false;
 
         LoopProfiler mPcThreadProfiler{"Zed Wrapper Point Cloud"}, mGrabThreadProfiler{"Zed Wrapper Grab"};
+        std::optional<LoopProfilerReporter> mProfilerReporter;
 
         size_t mGrabUpdateTick = 0, mPointCloudUpdateTick = 0;
 
         void onInit() override;
 
+        void fillPointCloudMessage(StereoFrame const& frame, sensor_msgs::PointCloud2Ptr const& msg);
+
     public:
         ZedNodelet() = default;
 
@@ -71,19 +105,29 @@ namespace mrover {
         void pointCloudUpdate();
     };
 
-    ros::Time slTime2Ros(sl::Timestamp t);
+    void copyFrameBuffer(FrameBuffer const& src, FrameMemory memory, size_t rowBytes, size_t rows, uint8_t* dst);
 
-    void fillPointCloudMessageFromGpu(sl::Mat& xyzGpu, sl::Mat& bgraGpu, PointCloudGpu& pcGpu, sensor_msgs::PointCloud2Ptr const& msg);
+    void interleaveRow(uint8_t const* xyzw, uint8_t const* bgra, ZedPoint* points, size_t count);
 
-    void fillCameraInfoMessages(sl::CalibrationParameters& calibration, sl::Resolution const& resolution,
+    void fillPointCloudMessageFromHost(StereoFrame const& frame, sensor_msgs::PointCloud2Ptr const& msg);
+
+    void fillCameraInfoMessages(StereoCalibration const& calibration, uint32_t width, uint32_t height,
                                 sensor_msgs::CameraInfoPtr const& leftInfoMsg, sensor_msgs::CameraInfoPtr const& rightInfoMsg);
 
-    void fillImageMessage(sl::Mat& bgra, sensor_msgs::ImagePtr const& msg);
+    void fillImageMessage(FrameBuffer const& bgra, FrameMemory memory, uint32_t width, uint32_t height, sensor_msgs::ImagePtr const& msg);
+
+    void fillDepthMessage(FrameBuffer const& depth, FrameMemory memory, uint32_t width, uint32_t height, sensor_msgs::ImagePtr const& msg);
+
+#ifdef MROVER_WITH_ZED
+    ros::Time slTime2Ros(sl::Timestamp t);
+
+    void fillPointCloudMessageFromGpu(StereoFrame const& frame, PointCloudGpu& pcGpu, sensor_msgs::PointCloud2Ptr const& msg);
 
     void fillImuMessage(sl::SensorsData::IMUData& imuData, sensor_msgs::Imu& msg);
 
     void fillMagMessage(sl::SensorsData::MagnetometerData& magData, sensor_msgs::MagneticField& msg);
 
     void checkCudaError(cudaError_t error);
+#endif
 
 } // namespace mrover
@@ -0,0 +1,269 @@
+#include "depth_projection.hpp"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <numeric>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#include <xmmintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+#include <tbb/blocked_range.h>
+#include <tbb/parallel_for.h>
+
+namespace mrover {
+
+    namespace {
+
+        constexpr uint32_t OPAQUE = 0xFFu << 24;
+
+        /**
+         * @brief Color of one pixel as it is stored in a point, blue in the lowest byte.
+         */
+        uint32_t packColor(DepthColors const& colors, size_t pixel) {
+            switch (colors.format) {
+                case DepthColors::Format::Rgb: {
+                    uint8_t const* rgb = colors.data + pixel * 3;
+                    return rgb[2] | rgb[1] << 8 | rgb[0] << 16 | OPAQUE;
+                }
+                case DepthColors::Format::Mono: {
+                    uint32_t gray = colors.data[pixel];
+                    return gray | gray << 8 | gray << 16 | OPAQUE;
+                }
+                case DepthColors::Format::None:
+                    break;
+            }
+            return OPAQUE;
+        }
+
+        /**
+         * @brief Largest float at or below @p value, a float compares against it the same way it would against @p value.
+         */
+        float floatAtOrBelow(double value) {
+            auto rounded = static_cast<float>(value);
+            return rounded > value ? std::nextafter(rounded, -std::numeric_limits<float>::infinity()) : rounded;
+        }
+
+        float floatAtOrAbove(double value) {
+            auto rounded = static_cast<float>(value);
+            return rounded < value ? std::nextafter(rounded, std::numeric_limits<float>::infinity()) : rounded;
+        }
+
+        struct RowContext {
+            // One per output column, already gathered when the stride is above one
+            float const* depth;
+            float const *columnX, *columnY, *columnZ;
+            float rowX, rowY, rowZ;
+            float near, far;
+            DepthColors colors;
+            // Pixel in the image of the first output column and the distance to the next
+            size_t firstPixel, pixelStride;
+
+            [[nodiscard]] size_t pixel(size_t i) const { return firstPixel + i * pixelStride; }
+
+            [[nodiscard]] bool isInRange(size_t i) const { return depth[i] > near && depth[i] < far; }
+
+            void setPoint(PointXYZRGB& point, size_t i) const {
+                float d = depth[i];
+                setPosition(point, d * (columnX[i] + rowX), d * (columnY[i] + rowY), d * (columnZ[i] + rowZ));
+            }
+        };
+
+        void setColor(PointXYZRGB& point, uint32_t color) {
+            std::memcpy(&point.b, &color, sizeof(color));
+        }
+
+        /**
+         * @brief Projects four columns at a time, returns how many were handled so the caller can finish the tail.
+         */
+        size_t projectRowSimd([[maybe_unused]] RowContext const& row, [[maybe_unused]] PointXYZRGB* points, [[maybe_unused]] size_t count, [[maybe_unused]] bool& isDense) {
+            [[maybe_unused]] constexpr size_t LANES = 4;
+
+            size_t i = 0;
+#if defined(__SSE2__)
+            __m128 const rowX = _mm_set1_ps(row.rowX), rowY = _mm_set1_ps(row.rowY), rowZ = _mm_set1_ps(row.rowZ);
+            __m128 const near = _mm_set1_ps(row.near), far = _mm_set1_ps(row.far);
+            __m128 const nan = _mm_set1_ps(std::numeric_limits<float>::quiet_NaN());
+            int allValid = 0xF;
+            for (; i + LANES <= count; i += LANES) {
+                __m128 depth = _mm_loadu_ps(row.depth + i);
+                // NaN and infinite depths fail one of the comparisons
+                __m128 isValid = _mm_and_ps(_mm_cmpgt_ps(depth, near), _mm_cmplt_ps(depth, far));
+                allValid &= _mm_movemask_ps(isValid);
+                auto coordinate = [&](float const* column, __m128 rowPart) {
+                    __m128 value = _mm_mul_ps(depth, _mm_add_ps(_mm_loadu_ps(column + i), rowPart));
+                    return _mm_or_ps(_mm_and_ps(isValid, value), _mm_andnot_ps(isValid, nan));
+                };
+                __m128 x = coordinate(row.columnX, rowX), y = coordinate(row.columnY, rowY), z = coordinate(row.columnZ, rowZ);
+                std::array<uint32_t, LANES> colors;
+                for (size_t lane = 0; lane < LANES; ++lane) colors[lane] = packColor(row.colors, row.pixel(i + lane));
+                __m128 color = _mm_castsi128_ps(_mm_loadu_si128(reinterpret_cast<__m128i const*>(colors.data())));
+                // Planes of x, y, z and color become four points
+                _MM_TRANSPOSE4_PS(x, y, z, color);
+                auto* out = reinterpret_cast<float*>(points + i);
+                _mm_storeu_ps(out + 0, x);
+                _mm_storeu_ps(out + 4, y);
+                _mm_storeu_ps(out + 8, z);
+                _mm_storeu_ps(out + 12, color);
+            }
+            if (allValid != 0xF) isDense = false;
+#elif defined(__ARM_NEON)
+            float32x4_t const rowX = vdupq_n_f32(row.rowX), rowY = vdupq_n_f32(row.rowY), rowZ = vdupq_n_f32(row.rowZ);
+            float32x4_t const near = vdupq_n_f32(row.near), far = vdupq_n_f32(row.far);
+            float32x4_t const nan = vdupq_n_f32(std::numeric_limits<float>::quiet_NaN());
+            uint32x4_t allValid = vdupq_n_u32(0xFFFFFFFF);
+            for (; i + LANES <= count; i += LANES) {
+                float32x4_t depth = vld1q_f32(row.depth + i);
+                uint32x4_t isValid = vandq_u32(vcgtq_f32(depth, near), vcltq_f32(depth, far));
+                allValid = vandq_u32(allValid, isValid);
+                float32x4x4_t planes;
+                planes.val[0] = vbslq_f32(isValid, vmulq_f32(depth, vaddq_f32(vld1q_f32(row.columnX + i), rowX)), nan);
+                planes.val[1] = vbslq_f32(isValid, vmulq_f32(depth, vaddq_f32(vld1q_f32(row.columnY + i), rowY)), nan);
+                planes.val[2] = vbslq_f32(isValid, vmulq_f32(depth, vaddq_f32(vld1q_f32(row.columnZ + i), rowZ)), nan);
+                std::array<uint32_t, LANES> colors;
+                for (size_t lane = 0; lane < LANES; ++lane) colors[lane] = packColor(row.colors, row.pixel(i + lane));
+                planes.val[3] = vreinterpretq_f32_u32(vld1q_u32(colors.data()));
+                vst4q_f32(reinterpret_cast<float*>(points + i), planes);
+            }
+            if (vminvq_u32(allValid) == 0) isDense = false;
+#endif
+            return i;
+        }
+
+        void projectRow(RowContext const& row, PointXYZRGB* points, size_t count, bool& isDense) {
+            for (size_t i = projectRowSimd(row, points, count, isDense); i < count; ++i) {
+                PointXYZRGB& point = points[i];
+                if (row.isInRange(i)) {
+                    row.setPoint(point, i);
+                } else {
+                    float nan = std::numeric_limits<float>::quiet_NaN();
+                    setPosition(point, nan, nan, nan);
+                    isDense = false;
+                }
+                setColor(point, packColor(row.colors, row.pixel(i)));
+            }
+        }
+
+        size_t countInRange(RowContext const& row, size_t count) {
+            size_t inRange = 0;
+            for (size_t i = 0; i < count; ++i) inRange += row.isInRange(i);
+            return inRange;
+        }
+
+        /**
+         * @brief Writes the points in range next to each other, @p points needs room for exactly as many as there are.
+         */
+        void projectRowInRange(RowContext const& row, PointXYZRGB* points, size_t count) {
+            for (size_t i = 0; i < count; ++i) {
+                if (!row.isInRange(i)) continue;
+
+                row.setPoint(*points, i);
+                setColor(*points, packColor(row.colors, row.pixel(i)));
+                ++points;
+            }
+        }
+
+    } // namespace
+
+    bool DepthProjection::configure(uint32_t width, uint32_t height, double horizontalFov, Eigen::Matrix3d const& rotation, uint32_t stride) {
+        stride = std::max(stride, 1u);
+        if (width == mSourceWidth && height == mSourceHeight && stride == mStride && horizontalFov == mHorizontalFov && rotation == mRotation) return false;
+
+        mSourceWidth = width;
+        mSourceHeight = height;
+        mStride = stride;
+        mWidth = (width + stride - 1) / stride;
+        mHeight = (height + stride - 1) / stride;
+        mHorizontalFov = horizontalFov;
+        mRotation = rotation;
+
+        // Pinhole model, the focal length in pixels is the same along both axes
+        double focalLength = static_cast<double>(width) / (2.0 * std::tan(horizontalFov / 2.0));
+        // A pixel at depth d is at d * (u, v, 1) in the optical frame, rotated that is d * (u * r0 + r2 + v * r1) for columns r0, r1, r2
+        mColumnX.resize(mWidth);
+        mColumnY.resize(mWidth);
+        mColumnZ.resize(mWidth);
+        for (uint32_t i = 0; i < mWidth; ++i) {
+            double u = (static_cast<double>(i) * stride - 0.5 * (width - 1)) / focalLength;
+            Eigen::Vector3d ray = u * rotation.col(0) + rotation.col(2);
+            mColumnX[i] = static_cast<float>(ray.x());
+            mColumnY[i] = static_cast<float>(ray.y());
+            mColumnZ[i] = static_cast<float>(ray.z());
+        }
+        mRowX.resize(mHeight);
+        mRowY.resize(mHeight);
+        mRowZ.resize(mHeight);
+        for (uint32_t j = 0; j < mHeight; ++j) {
+            double v = (static_cast<double>(j) * stride - 0.5 * (height - 1)) / focalLength;
+            Eigen::Vector3d ray = v * rotation.col(1);
+            mRowX[j] = static_cast<float>(ray.x());
+            mRowY[j] = static_cast<float>(ray.y());
+            mRowZ[j] = static_cast<float>(ray.z());
+        }
+        return true;
+    }
+
+    template<typename F>
+    void DepthProjection::forEachRow(float const* depth, DepthColors const& colors, double near, double far, F&& f) const {
+        // Rounded outward so comparing a float depth gives the same answer as comparing it in double precision
+        float nearBound = floatAtOrBelow(near), farBound = floatAtOrAbove(far);
+        tbb::parallel_for(tbb::blocked_range<uint32_t>{0, mHeight}, [&](tbb::blocked_range<uint32_t> const& rows) {
+            // Skipped columns are left behind so the row can be loaded contiguously
+            std::vector<float> gathered(mStride > 1 ? mWidth : 0);
+            for (uint32_t j = rows.begin(); j < rows.end(); ++j) {
+                size_t firstPixel = static_cast<size_t>(j) * mStride * mSourceWidth;
+                float const* rowDepth = depth + firstPixel;
+                if (mStride > 1) {
+                    for (uint32_t i = 0; i < mWidth; ++i) gathered[i] = rowDepth[static_cast<size_t>(i) * mStride];
+                    rowDepth = gathered.data();
+                }
+                RowContext row{rowDepth,
+                               mColumnX.data(), mColumnY.data(), mColumnZ.data(),
+                               mRowX[j], mRowY[j], mRowZ[j],
+                               nearBound, farBound,
+                               colors, firstPixel, mStride};
+                f(j, row);
+            }
+        });
+    }
+
+    bool DepthProjection::project(float const* depth, DepthColors const& colors, double near, double far, PointXYZRGB* points) const {
+        std::atomic<bool> isDense{true};
+        forEachRow(depth, colors, near, far, [&](uint32_t j, RowContext const& row) {
+            bool isRowDense = true;
+            projectRow(row, points + static_cast<size_t>(j) * mWidth, mWidth, isRowDense);
+            if (!isRowDense) isDense.store(false, std::memory_order_relaxed);
+        });
+        return isDense.load(std::memory_order_relaxed);
+    }
+
+    size_t DepthProjection::projectValid(float const* depth, DepthColors const& colors, double near, double far, PointXYZRGB* points) const {
+        // Shifted by one so the prefix sum turns each count into where the next row starts
+        std::vector<size_t> rowStarts(static_cast<size_t>(mHeight) + 1);
+        forEachRow(depth, colors, near, far, [&](uint32_t j, RowContext const& row) {
+            rowStarts[j + 1] = countInRange(row, mWidth);
+        });
+        std::partial_sum(rowStarts.begin(), rowStarts.end(), rowStarts.begin());
+        forEachRow(depth, colors, near, far, [&](uint32_t j, RowContext const& row) {
+            size_t inRange = rowStarts[j + 1] - rowStarts[j];
+            // Rows of sky and rows of ground are common, neither needs to be compacted
+            if (inRange == 0) return;
+
+            if (inRange == mWidth) {
+                bool isRowDense = true;
+                projectRow(row, points + rowStarts[j], mWidth, isRowDense);
+            } else {
+                projectRowInRange(row, points + rowStarts[j], mWidth);
+            }
+        });
+        return rowStarts.back();
+    }
+
+} // namespace mrover
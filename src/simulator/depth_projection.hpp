@@ -0,0 +1,93 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include <Eigen/Core>
+
+#include "../perception/point.hpp"
+
+namespace mrover {
+
+    /**
+     * @brief Colors of the image taken together with a depth frame, one per pixel.
+     */
+    struct DepthColors {
+        enum class Format {
+            None,
+            Rgb,
+            Mono,
+        };
+
+        Format format = Format::None;
+        uint8_t const* data = nullptr;
+    };
+
+    /**
+     * @brief Turns depth images from a pinhole camera into points.
+     *
+     * A pixel's ray at unit depth is the sum of a part that only depends on its column and one that only depends on its row.
+     * Both are kept in tables, rebuilt only when the resolution or field of view changes, with the rotation into the output frame folded in.
+     * Filling a cloud is then a multiply and add per coordinate.
+     *
+     * With a stride above one only every stride-th column of every stride-th row is projected, the tables only hold those.
+     */
+    class DepthProjection {
+        uint32_t mSourceWidth = 0, mSourceHeight = 0, mStride = 1;
+        // Size of the output grid
+        uint32_t mWidth = 0, mHeight = 0;
+        double mHorizontalFov = 0;
+        Eigen::Matrix3d mRotation = Eigen::Matrix3d::Zero();
+
+        // Split into x, y and z so consecutive columns load together
+        std::vector<float> mColumnX, mColumnY, mColumnZ;
+        std::vector<float> mRowX, mRowY, mRowZ;
+
+        /**
+         * @brief Calls @p f with the index and context of every output row, rows are split across threads.
+         */
+        template<typename F>
+        void forEachRow(float const* depth, DepthColors const& colors, double near, double far, F&& f) const;
+
+    public:
+        /**
+         * @param width         Of the depth images
+         * @param height        Of the depth images
+         * @param horizontalFov Radians
+         * @param rotation      From the optical frame, z forward and y down, into the frame of the points
+         * @param stride        Distance in pixels between projected pixels, along both axes
+         * @return              Whether the tables were rebuilt
+         */
+        bool configure(uint32_t width, uint32_t height, double horizontalFov, Eigen::Matrix3d const& rotation, uint32_t stride = 1);
+
+        /**
+         * @brief Columns of the output grid, the image width divided by the stride and rounded up.
+         */
+        [[nodiscard]] uint32_t width() const { return mWidth; }
+
+        [[nodiscard]] uint32_t height() const { return mHeight; }
+
+        /**
+         * @brief Fills an organized cloud, rows are filled in parallel.
+         *
+         * @param depth     Row major depths in meters, one per pixel of the image
+         * @param near      Depths at or below this are out of range
+         * @param far       Depths at or above this are out of range
+         * @param points    One per cell of the output grid, out of range depths become NaN positions but keep their color
+         * @return          Whether every depth was in range, in which case the cloud is dense
+         */
+        bool project(float const* depth, DepthColors const& colors, double near, double far, PointXYZRGB* points) const;
+
+        /**
+         * @brief Fills an unorganized cloud with only the points whose depth is in range, in row major order.
+         *
+         * Rows count their points in parallel, a prefix sum over the counts gives each row where its points start,
+         * then rows are filled in parallel again.
+         *
+         * @param points    Room for one point per cell of the output grid
+         * @return          How many points were written
+         */
+        size_t projectValid(float const* depth, DepthColors const& colors, double near, double far, PointXYZRGB* points) const;
+    };
+
+} // namespace mrover
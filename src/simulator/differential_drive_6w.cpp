@@ -34,6 +34,10 @@
 #include "differential_drive_6w.hpp"
 
 #include <algorithm>
+#include <functional>
+#include <utility>
+
+#include <boost/make_shared.hpp>
 
 #include <gazebo/common/Events.hh>
 #include <gazebo/physics/physics.hh>
@@ -45,6 +49,7 @@
 #include <tf/transform_listener.h>
 
 #include <mrover/MotorsStatus.h>
+#include <ros/callback_queue_interface.h>
 
 namespace gazebo {
 
@@ -52,6 +57,43 @@ namespace gazebo {
 
     const int MAX_LOOPS_NO_UPDATE = 100;
 
+    /**
+     * @brief Runs a function on the thread spinning the queue it was added to.
+     */
+    class FunctionCallback : public ros::CallbackInterface {
+        std::function<void()> mFunction;
+
+    public:
+        explicit FunctionCallback(std::function<void()> function) : mFunction{std::move(function)} {}
+
+        CallResult call() override {
+            mFunction();
+            return Success;
+        }
+    };
+
+    /**
+     * @brief Hands @p message over to be published from @p queue, the caller does not wait on serialization.
+     *
+     * Only the newest message is published if the queue falls behind.
+     * The buffer has a single consumer, so the queue has to be spun by one thread.
+     */
+    template<typename MessageT>
+    void publishFromQueue(ros::CallbackQueue& queue, ros::Publisher& publisher, TripleBuffer<MessageT>& buffer, MessageT const& message) {
+        // Assigning over the old message reuses its memory
+        buffer.back() = message;
+        // A replaced message means its publish is still queued, it will take this one instead
+        if (buffer.publish()) return;
+
+        queue.addCallback(boost::make_shared<FunctionCallback>([&publisher, &buffer] {
+            if (buffer.consume()) publisher.publish(buffer.front());
+        }));
+    }
+
+    common::Time periodOf(double rate) {
+        return rate > 0 ? common::Time{1.0 / rate} : common::Time{};
+    }
+
     enum {
         FRONT_LEFT,
         FRONT_RIGHT,
@@ -133,6 +175,30 @@ namespace gazebo {
         if (mSdf->HasElement("torque"))
             mSdf->GetElement("torque")->GetValue()->Get(mTorque);
 
+        // Rates are in Hz of sim time, zero publishes on every physics update
+        double updateRate = 50;
+        if (mSdf->HasElement("updateRate"))
+            mSdf->GetElement("updateRate")->GetValue()->Get(updateRate);
+        double odometryRate = updateRate, jointStateRate = updateRate;
+        if (mSdf->HasElement("odometryRate"))
+            mSdf->GetElement("odometryRate")->GetValue()->Get(odometryRate);
+        if (mSdf->HasElement("jointStateRate"))
+            mSdf->GetElement("jointStateRate")->GetValue()->Get(jointStateRate);
+        mOdometryPublishPeriod = periodOf(odometryRate);
+        mJointStatePublishPeriod = periodOf(jointStateRate);
+
+        int pathCapacity = 4096;
+        double pathMinDistance = 0.1, pathMinAngle = 0.1;
+        if (mSdf->HasElement("pathCapacity"))
+            mSdf->GetElement("pathCapacity")->GetValue()->Get(pathCapacity);
+        if (mSdf->HasElement("pathMinDistance"))
+            mSdf->GetElement("pathMinDistance")->GetValue()->Get(pathMinDistance);
+        if (mSdf->HasElement("pathMinAngle"))
+            mSdf->GetElement("pathMinAngle")->GetValue()->Get(pathMinAngle);
+        if (mSdf->HasElement("pathIncremental"))
+            mSdf->GetElement("pathIncremental")->GetValue()->Get(mIsPathIncremental);
+        mPathHistory.emplace(static_cast<size_t>(std::max(pathCapacity, 1)), pathMinDistance, pathMinAngle);
+
         // Make sure the ROS node for Gazebo has already been initialized
         if (!ros::isInitialized()) {
             ROS_FATAL("A ROS node for Gazebo has not been initialized, unable to load plugin. "
@@ -149,6 +215,7 @@ namespace gazebo {
             ROS_WARN("No world frame provided, defaulting to \"map\"");
             mWorldFrameName = "map";
         }
+        mResolvedWorldFrameName = tf::resolve(mTfPrefix, mWorldFrameName);
         if (!mNode->getParam("rover_frame", mRoverFrameName)) {
             ROS_WARN("No rover frame provided, defaulting to \"base_link\"");
             mRoverFrameName = "base_link";
@@ -161,7 +228,9 @@ namespace gazebo {
                 ros::VoidPtr(), &mVelocityCommandQueue);
         mSubscriber = mNode->subscribe(so);
         mOdomPublisher = mNode->advertise<nav_msgs::Odometry>("ground_truth", 1);
-        mPathPublisher = mNode->advertise<nav_msgs::Path>("ground_truth_path", 1);
+        // The whole path is latched since it is only published when it changes.
+        // A latched segment would only give late subscribers a fragment, so incremental subscribers have to connect before the rover moves
+        mPathPublisher = mNode->advertise<nav_msgs::Path>("ground_truth_path", 1, !mIsPathIncremental);
 
         // update path at 4 Hz
         mPathUpdatePeriod = common::Time(0, static_cast<int32_t>(common::Time::SecToNano(0.25)));
@@ -171,6 +240,10 @@ namespace gazebo {
         mMotorStatus.joint_states.velocity.resize(mJoints.size());
         mMotorStatus.joint_states.effort.resize(mJoints.size());
         mMotorStatus.joint_states.name = {"j0", "j1", "j2", "j3", "j4", "j5"};
+        mMotorStatus.joint_states.header.frame_id = mResolvedWorldFrameName;
+
+        mOdometry.header.frame_id = mResolvedWorldFrameName;
+        mOdometry.child_frame_id = mRoverFrameName;
 
         //set up joint state publisher to publish on /joint_states topic
         mJointStatePublisher = mNode->advertise<mrover::MotorsStatus>("drive_status", 1);
@@ -197,6 +270,9 @@ namespace gazebo {
 
         mPreviousUpdateTime = mWorld->SimTime();
         mPreviousPathUpdateTime = mPreviousUpdateTime;
+        // Publish on the first update
+        mPreviousOdometryPublishTime = mPreviousUpdateTime - mOdometryPublishPeriod;
+        mPreviousJointStatePublishTime = mPreviousUpdateTime - mJointStatePublishPeriod;
 
         mForwardVelocity = 0;
         mPitch = 0;
@@ -261,11 +337,25 @@ namespace gazebo {
             mJoints[REAR_RIGHT]->SetEffortLimit(0, mTorque);
         }
 
-        publishOdometry();
-        publishJointData();
+        common::Time currentTime = mWorld->SimTime();
+        bool isOdometryDue = currentTime - mPreviousOdometryPublishTime >= mOdometryPublishPeriod;
+        bool isPathDue = currentTime - mPreviousPathUpdateTime >= mPathUpdatePeriod;
+
+        // The path is built from the odometry message, so it has to be current for either
+        if (isOdometryDue || isPathDue) fillOdometry(currentTime);
+
+        if (isOdometryDue) {
+            mPreviousOdometryPublishTime = currentTime;
+            publishOdometry();
+        }
+
+        if (currentTime - mPreviousJointStatePublishTime >= mJointStatePublishPeriod) {
+            mPreviousJointStatePublishTime = currentTime;
+            publishJointData(currentTime);
+        }
 
-        if (mWorld->SimTime() - mPreviousPathUpdateTime >= mPathUpdatePeriod) {
-            mPreviousPathUpdateTime = mWorld->SimTime();
+        if (isPathDue) {
+            mPreviousPathUpdateTime = currentTime;
             publishPath();
         }
     }
@@ -292,11 +382,7 @@ namespace gazebo {
         mPitch = twistCommand->angular.z;
     }
 
-    // NEW: Update this to publish odometry topic
-    void DiffDrivePlugin6W::publishOdometry() {
-        // get current time
-        ros::Time currentTime((mWorld->SimTime()).sec, (mWorld->SimTime()).nsec);
-
+    void DiffDrivePlugin6W::fillOdometry(common::Time const& currentTime) {
         // getting data for base_footprint to odom transform
         ignition::math::Pose3d pose = mBodyLink->WorldPose();
         ignition::math::Vector3d velocity = mBodyLink->WorldLinearVel();
@@ -324,14 +410,14 @@ namespace gazebo {
         mOdometry.twist.twist.linear.y = velocity.Y();
         mOdometry.twist.twist.angular.z = angularVelocity.Z();
 
-        mOdometry.header.frame_id = tf::resolve(mTfPrefix, mWorldFrameName);
-        mOdometry.child_frame_id = mRoverFrameName;
-        mOdometry.header.stamp = currentTime;
+        mOdometry.header.stamp = ros::Time(currentTime.sec, currentTime.nsec);
+    }
 
-        mOdomPublisher.publish(mOdometry);
+    void DiffDrivePlugin6W::publishOdometry() {
+        publishFromQueue(mVelocityCommandQueue, mOdomPublisher, mOdometryBuffer, mOdometry);
     }
 
-    void DiffDrivePlugin6W::publishJointData() {
+    void DiffDrivePlugin6W::publishJointData(common::Time const& currentTime) {
         //fill JointState message representing joint positions and velocities and efforts
         for (unsigned int i = 0; i < mJoints.size(); i++) {
             mMotorStatus.joint_states.position[i] = mJoints[i]->Position(0);
@@ -340,19 +426,23 @@ namespace gazebo {
             //this is probably due to the way the joints are modeled in gazebo
             mMotorStatus.joint_states.effort[i] = mJoints[i]->GetVelocity(0) / 5.0;
         }
-        //publish joint state message
-        mMotorStatus.joint_states.header.stamp = ros::Time::now();
-        mMotorStatus.joint_states.header.frame_id = tf::resolve(mTfPrefix, mWorldFrameName);
-        mJointStatePublisher.publish(mMotorStatus);
+        //publish joint state message, stamped with when the joints were read
+        mMotorStatus.joint_states.header.stamp = ros::Time(currentTime.sec, currentTime.nsec);
+        publishFromQueue(mVelocityCommandQueue, mJointStatePublisher, mMotorStatusBuffer, mMotorStatus);
     }
 
-    // Add current odom reading to path and then publish path
+    // Add current odom reading to path and then publish path if it was kept
     void DiffDrivePlugin6W::publishPath() {
         geometry_msgs::PoseStamped pose_msg;
         pose_msg.header = mOdometry.header;
         pose_msg.pose = mOdometry.pose.pose;
-        mPath.poses.push_back(pose_msg);
+        if (!mPathHistory->add(pose_msg)) return;
+
         mPath.header = mOdometry.header;
+        // A segment starts at the last pose already published so consecutive segments join up
+        uint64_t begin = mIsPathIncremental && mPathPublishedEnd > 0 ? mPathPublishedEnd - 1 : 0;
+        mPathHistory->fill(mPath, begin);
+        mPathPublishedEnd = mPathHistory->end();
 
         mPathPublisher.publish(mPath);
     }
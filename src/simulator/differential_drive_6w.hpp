@@ -57,6 +57,10 @@
 #include <mrover/MotorsStatus.h>
 #include <sensor_msgs/JointState.h>
 
+#include <triple_buffer.hpp>
+
+#include "path_history.hpp"
+
 namespace gazebo {
 
     class DiffDrivePlugin6W : public ModelPlugin {
@@ -74,8 +78,9 @@ namespace gazebo {
         virtual void update(common::UpdateInfo const& updateInfo);
 
     private:
+        void fillOdometry(common::Time const& currentTime);
         void publishOdometry();
-        void publishJointData();
+        void publishJointData(common::Time const& currentTime);
         void publishPath();
 
         void getPositionCommand();
@@ -101,6 +106,21 @@ namespace gazebo {
         // Sim time between path updates
         common::Time mPathUpdatePeriod;
 
+        // Sim time between odometry and joint state publishes, zero publishes every update
+        common::Time mOdometryPublishPeriod, mJointStatePublishPeriod;
+        common::Time mPreviousOdometryPublishTime, mPreviousJointStatePublishTime;
+
+        // Filled on the physics thread and published by the spinner, so serializing never holds up a physics step
+        TripleBuffer<nav_msgs::Odometry> mOdometryBuffer;
+        TripleBuffer<mrover::MotorsStatus> mMotorStatusBuffer;
+
+        // Poses of the path that are still published, only ones far enough apart are kept
+        std::optional<mrover::PathHistory> mPathHistory;
+        // Publish only the poses added since the last publish instead of the whole path, not latched
+        bool mIsPathIncremental{};
+        // Number of the next pose that was not published yet
+        uint64_t mPathPublishedEnd{};
+
         bool mEnableMotors{};
         std::array<double, 3> mOdomPose{};
         std::array<double, 3> mOdomVelocity{};
@@ -114,6 +134,8 @@ namespace gazebo {
         nav_msgs::Odometry mOdometry;
         nav_msgs::Path mPath;
         std::string mTfPrefix;
+        // World frame with the tf prefix, resolved once
+        std::string mResolvedWorldFrameName;
 
         std::mutex mLock;
 
@@ -123,7 +145,7 @@ namespace gazebo {
         std::string mRoverFrameName;
         std::string mBodyLinkName;
 
-        // Custom Callback Queue
+        // Custom Callback Queue, also where messages filled on the physics thread are published from
         ros::CallbackQueue mVelocityCommandQueue;
         std::optional<ros::AsyncSpinner> mSpinner;
 
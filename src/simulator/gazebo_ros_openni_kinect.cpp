@@ -25,7 +25,7 @@
 #include <algorithm>
 #include <boost/bind.hpp>
 
-#include <gazebo_plugins/gazebo_ros_openni_kinect.h>
+#include "gazebo_ros_openni_kinect.hpp"
 
 #include <gazebo/sensors/Sensor.hh>
 #include <gazebo/sensors/SensorTypes.hh>
@@ -35,11 +35,24 @@
 #include <ignition/common/Profiler.hh>
 #endif
 
-#include <sensor_msgs/point_cloud2_iterator.h>
-
 #include <tf/tf.h>
 
+#include "../perception/point.hpp"
+
 namespace gazebo {
+    // Layout of the published point cloud, same as the ZED so the perception stack sees the simulated camera the same way
+    using KinectPoint = mrover::PointXYZRGB;
+
+    // The *_optical_frame has the rotation rpy(-M_PI/2, 0, -M_PI/2) built into the urdf relative to the physical camera *_frame,
+    // points are rotated back so they come out in the physical frame
+    Eigen::Matrix3d const OPTICAL_TO_CAMERA = (Eigen::AngleAxisd{-M_PI_2, Eigen::Vector3d::UnitZ()} *
+                                               Eigen::AngleAxisd{-M_PI_2, Eigen::Vector3d::UnitX()} *
+                                               Eigen::AngleAxisd{0.0, Eigen::Vector3d::UnitY()})
+                                                      .toRotationMatrix();
+
+    // How often the worker reports frames it had to skip
+    ros::WallDuration const DROP_REPORT_PERIOD{10.0};
+
     // Register this plugin with the simulator
     GZ_REGISTER_SENSOR_PLUGIN(GazeboRosOpenniKinect)
 
@@ -55,6 +68,13 @@ namespace gazebo {
     ////////////////////////////////////////////////////////////////////////////////
     // Destructor
     GazeboRosOpenniKinect::~GazeboRosOpenniKinect() {
+        {
+            std::lock_guard<std::mutex> guard{this->worker_mutex_};
+            this->is_worker_stopping_ = true;
+        }
+        this->worker_condition_.notify_one();
+        if (this->worker_.joinable())
+            this->worker_.join();
     }
 
     ////////////////////////////////////////////////////////////////////////////////
@@ -102,6 +122,12 @@ namespace gazebo {
         else
             this->point_cloud_cutoff_max_ = _sdf->GetElement("pointCloudCutoffMax")->Get<double>();
 
+        // publish only the points in range as an unorganized cloud instead of keeping NaN points in their pixels
+        if (!_sdf->HasElement("pointCloudUnorganized"))
+            this->point_cloud_unorganized_ = false;
+        else
+            this->point_cloud_unorganized_ = _sdf->GetElement("pointCloudUnorganized")->Get<bool>();
+
         // allow optional publication of depth images in 16UC1 instead of 32FC1
         if (!_sdf->HasElement("useDepth16UC1Format"))
             this->use_depth_image_16UC1_format_ = false;
@@ -110,6 +136,15 @@ namespace gazebo {
 
         load_connection_ = GazeboRosCameraUtils::OnLoad(boost::bind(&GazeboRosOpenniKinect::Advertise, this));
         GazeboRosCameraUtils::Load(_parent, _sdf);
+
+        // pixels skipped between the ones put in the point cloud, along both axes
+        if (!_sdf->HasElement("pointCloudSkip"))
+            this->skip_ = 0;
+        else
+            this->skip_ = std::max(_sdf->GetElement("pointCloudSkip")->Get<int>(), 0);
+
+        this->last_drop_report_time_ = ros::WallTime::now();
+        this->worker_ = std::thread{&GazeboRosOpenniKinect::ConvertFrames, this};
     }
 
     void GazeboRosOpenniKinect::Advertise() {
@@ -197,11 +232,10 @@ namespace gazebo {
                 (*this->image_connect_count_) <= 0) {
                 this->parentSensor->SetActive(false);
             } else {
-                if (this->point_cloud_connect_count_ > 0)
-                    this->FillPointdCloud(_image);
-
-                if (this->depth_image_connect_count_ > 0)
-                    this->FillDepthImage(_image);
+                bool fill_point_cloud = this->point_cloud_connect_count_ > 0;
+                bool fill_depth_image = this->depth_image_connect_count_ > 0;
+                if (fill_point_cloud || fill_depth_image)
+                    this->StageDepthFrame(_image, fill_point_cloud, fill_depth_image);
             }
         } else {
             if (this->point_cloud_connect_count_ > 0 ||
@@ -247,159 +281,148 @@ namespace gazebo {
     }
 
     ////////////////////////////////////////////////////////////////////////////////
-    // Put point cloud data to the interface
-    void GazeboRosOpenniKinect::FillPointdCloud(const float* _src) {
-        this->lock_.lock();
+    // Copy the frame for the worker, the sensor thread should not wait on the conversion
+    void GazeboRosOpenniKinect::StageDepthFrame(const float* _src, bool fill_point_cloud, bool fill_depth_image) {
+        DepthFrame& frame = this->frames_.back();
+        frame.width = this->width;
+        frame.height = this->height;
+        frame.horizontal_fov = this->parentSensor->DepthCamera()->HFOV().Radian();
+        frame.stamp = this->depth_sensor_update_time_;
+        frame.fill_point_cloud = fill_point_cloud;
+        frame.fill_depth_image = fill_depth_image;
+        // Buffers are reused, after the first few frames these copies do not allocate
+        frame.depth.assign(_src, _src + static_cast<size_t>(frame.width) * frame.height);
+        if (fill_point_cloud) {
+            boost::mutex::scoped_lock image_lock{this->lock_};
+            frame.image = this->image_msg_.data;
+        }
+
+        bool is_dropped = this->frames_.publish();
+        this->staged_frame_count_.fetch_add(1, std::memory_order_relaxed);
+        if (is_dropped)
+            this->dropped_frame_count_.fetch_add(1, std::memory_order_relaxed);
+
+        // Taking the lock orders the publish before the worker checks for a frame, so the notification is not lost
+        { std::lock_guard<std::mutex> guard{this->worker_mutex_}; }
+        this->worker_condition_.notify_one();
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////
+    // Convert and publish the newest staged frame until the plugin is destroyed
+    void GazeboRosOpenniKinect::ConvertFrames() {
+        while (true) {
+            {
+                std::unique_lock<std::mutex> lock{this->worker_mutex_};
+                this->worker_condition_.wait(lock, [this] { return this->is_worker_stopping_ || this->frames_.consume(); });
+                if (this->is_worker_stopping_)
+                    return;
+            }
+
+            DepthFrame const& frame = this->frames_.front();
+            if (frame.fill_point_cloud)
+                this->FillPointdCloud(frame);
+            if (frame.fill_depth_image)
+                this->FillDepthImage(frame);
+
+            this->ReportDroppedFrames();
+        }
+    }
+
+    ////////////////////////////////////////////////////////////////////////////////
+    // Warn when the worker could not keep up with the sensor
+    void GazeboRosOpenniKinect::ReportDroppedFrames() {
+        ros::WallTime now = ros::WallTime::now();
+        if (now - this->last_drop_report_time_ < DROP_REPORT_PERIOD)
+            return;
+
+        uint64_t staged = this->staged_frame_count_.load(std::memory_order_relaxed);
+        uint64_t dropped = this->dropped_frame_count_.load(std::memory_order_relaxed);
+        if (dropped > this->reported_dropped_count_) {
+            ROS_WARN_NAMED("openni_kinect", "Point cloud conversion fell behind, dropped %lu of %lu depth frames in the last %.0f s",
+                           static_cast<unsigned long>(dropped - this->reported_dropped_count_),
+                           static_cast<unsigned long>(staged - this->reported_staged_count_),
+                           (now - this->last_drop_report_time_).toSec());
+        }
+        this->reported_staged_count_ = staged;
+        this->reported_dropped_count_ = dropped;
+        this->last_drop_report_time_ = now;
+    }
 
+    ////////////////////////////////////////////////////////////////////////////////
+    // Put point cloud data to the interface
+    void GazeboRosOpenniKinect::FillPointdCloud(DepthFrame const& frame) {
         this->point_cloud_msg_.header.frame_id = this->frame_name_;
-        this->point_cloud_msg_.header.stamp.sec = this->depth_sensor_update_time_.sec;
-        this->point_cloud_msg_.header.stamp.nsec = this->depth_sensor_update_time_.nsec;
-        this->point_cloud_msg_.width = this->width;
-        this->point_cloud_msg_.height = this->height;
-        this->point_cloud_msg_.row_step = this->point_cloud_msg_.point_step * this->width;
+        this->point_cloud_msg_.header.stamp.sec = frame.stamp.sec;
+        this->point_cloud_msg_.header.stamp.nsec = frame.stamp.nsec;
 
         ///copy from depth to point cloud message
-        FillPointCloudHelper(this->point_cloud_msg_,
-                             this->height,
-                             this->width,
-                             this->skip_,
-                             (void*) _src);
+        FillPointCloudHelper(this->point_cloud_msg_, frame);
 
         this->point_cloud_pub_.publish(this->point_cloud_msg_);
-
-        this->lock_.unlock();
     }
 
     ////////////////////////////////////////////////////////////////////////////////
     // Put depth image data to the interface
-    void GazeboRosOpenniKinect::FillDepthImage(const float* _src) {
-        this->lock_.lock();
+    void GazeboRosOpenniKinect::FillDepthImage(DepthFrame const& frame) {
         // copy data into image
         this->depth_image_msg_.header.frame_id = this->frame_name_;
-        this->depth_image_msg_.header.stamp.sec = this->depth_sensor_update_time_.sec;
-        this->depth_image_msg_.header.stamp.nsec = this->depth_sensor_update_time_.nsec;
+        this->depth_image_msg_.header.stamp.sec = frame.stamp.sec;
+        this->depth_image_msg_.header.stamp.nsec = frame.stamp.nsec;
 
         ///copy from depth to depth image message
-        FillDepthImageHelper(this->depth_image_msg_,
-                             this->height,
-                             this->width,
-                             this->skip_,
-                             (void*) _src);
+        FillDepthImageHelper(this->depth_image_msg_, frame);
 
         this->depth_image_pub_.publish(this->depth_image_msg_);
-
-        this->lock_.unlock();
     }
 
-
     // Fill depth information
     bool GazeboRosOpenniKinect::FillPointCloudHelper(
             sensor_msgs::PointCloud2& point_cloud_msg,
-            uint32_t rows_arg, uint32_t cols_arg,
-            uint32_t step_arg, void* data_arg) {
-        sensor_msgs::PointCloud2Modifier pcd_modifier(point_cloud_msg);
-        pcd_modifier.setPointCloud2Fields(8,
-                                          "x", 1, sensor_msgs::PointField::FLOAT32,
-                                          "y", 1, sensor_msgs::PointField::FLOAT32,
-                                          "z", 1, sensor_msgs::PointField::FLOAT32,
-                                          "rgb", 1, sensor_msgs::PointField::FLOAT32,
-                                          "normal_x", 1, sensor_msgs::PointField::FLOAT32,
-                                          "normal_y", 1, sensor_msgs::PointField::FLOAT32,
-                                          "normal_z", 1, sensor_msgs::PointField::FLOAT32,
-                                          "curvature", 1, sensor_msgs::PointField::FLOAT32);
-        // convert to flat array shape, we need to reconvert later
-        pcd_modifier.resize(rows_arg * cols_arg);
-        point_cloud_msg.is_dense = true;
-
-        sensor_msgs::PointCloud2Iterator<float> iter_x(point_cloud_msg_, "x");
-        sensor_msgs::PointCloud2Iterator<float> iter_y(point_cloud_msg_, "y");
-        sensor_msgs::PointCloud2Iterator<float> iter_z(point_cloud_msg_, "z");
-        sensor_msgs::PointCloud2Iterator<uint8_t> iter_rgb(point_cloud_msg_, "rgb");
-
-        float* toCopyFrom = (float*) data_arg;
-        int index = 0;
-
-        double hfov = this->parentSensor->DepthCamera()->HFOV().Radian();
-        double fl = ((double) this->width) / (2.0 * tan(hfov / 2.0));
-
-        // Define rotation matrix to align gazebo axes
-        Eigen::AngleAxisd rollAngle(-M_PI_2, Eigen::Vector3d::UnitX());
-        Eigen::AngleAxisd pitchAngle(0.0, Eigen::Vector3d::UnitY());
-        Eigen::AngleAxisd yawAngle(-M_PI_2, Eigen::Vector3d::UnitZ());
-
-        Eigen::Quaternion<double> rot = yawAngle * rollAngle * pitchAngle;
-        Eigen::Matrix3d rotMatrix = rot.matrix();
-
-        // convert depth to point cloud
-        for (uint32_t j = 0; j < rows_arg; j++) {
-            double pAngle;
-            if (rows_arg > 1) pAngle = atan2((double) j - 0.5 * (double) (rows_arg - 1), fl);
-            else
-                pAngle = 0.0;
-
-            for (uint32_t i = 0; i < cols_arg; i++, ++iter_x, ++iter_y, ++iter_z, ++iter_rgb) {
-                double yAngle;
-                if (cols_arg > 1) yAngle = atan2((double) i - 0.5 * (double) (cols_arg - 1), fl);
-                else
-                    yAngle = 0.0;
-
-                double depth = toCopyFrom[index++]; // + 0.0*this->myParent->GetNearClip();
-
-                if (depth > this->point_cloud_cutoff_ &&
-                    depth < this->point_cloud_cutoff_max_) {
-                    // in optical frame
-                    // hardcoded rotation rpy(-M_PI/2, 0, -M_PI/2) is built-in
-                    // to urdf, where the *_optical_frame should have above relative
-                    // rotation from the physical camera *_frame
-
-                    // Rectifies the hardcoded rotation discussed above
-                    Eigen::Vector3d originVec(depth * tan(yAngle), depth * tan(pAngle), depth);
-                    Eigen::Vector3d rotated = rotMatrix * originVec;
-
-                    *iter_x = rotated(0);
-                    *iter_y = rotated(1);
-                    *iter_z = rotated(2);
-
-                } else //point in the unseeable range
-                {
-                    *iter_x = *iter_y = *iter_z = std::numeric_limits<float>::quiet_NaN();
-                    point_cloud_msg.is_dense = false;
-                }
-
-                // put image color data for each point
-                uint8_t* image_src = (uint8_t*) (&(this->image_msg_.data[0]));
-                if (this->image_msg_.data.size() == rows_arg * cols_arg * 3) {
-                    // color
-                    iter_rgb[0] = image_src[i * 3 + j * cols_arg * 3 + 2];
-                    iter_rgb[1] = image_src[i * 3 + j * cols_arg * 3 + 1];
-                    iter_rgb[2] = image_src[i * 3 + j * cols_arg * 3 + 0];
-                } else if (this->image_msg_.data.size() == rows_arg * cols_arg) {
-                    // mono (or bayer?  @todo; fix for bayer)
-                    iter_rgb[0] = image_src[i + j * cols_arg];
-                    iter_rgb[1] = image_src[i + j * cols_arg];
-                    iter_rgb[2] = image_src[i + j * cols_arg];
-                } else {
-                    // no image
-                    iter_rgb[0] = 0;
-                    iter_rgb[1] = 0;
-                    iter_rgb[2] = 0;
-                }
-            }
+            DepthFrame const& frame) {
+        uint32_t rows_arg = frame.height;
+        uint32_t cols_arg = frame.width;
+        uint32_t stride = static_cast<uint32_t>(this->skip_) + 1;
+        this->projection_.configure(cols_arg, rows_arg, frame.horizontal_fov, OPTICAL_TO_CAMERA, stride);
+
+        // The color image was copied with the depth frame, use it when it matches
+        mrover::DepthColors colors;
+        size_t pixels = static_cast<size_t>(rows_arg) * cols_arg;
+        if (frame.image.size() == pixels * 3) {
+            colors = {mrover::DepthColors::Format::Rgb, frame.image.data()};
+        } else if (frame.image.size() == pixels) {
+            // mono (or bayer?  @todo; fix for bayer)
+            colors = {mrover::DepthColors::Format::Mono, frame.image.data()};
         }
 
-        // reconvert to original height and width after the flat reshape
-        point_cloud_msg.height = rows_arg;
-        point_cloud_msg.width = cols_arg;
-        point_cloud_msg.row_step = point_cloud_msg.point_step * point_cloud_msg.width;
-
+        if (this->point_cloud_unorganized_) {
+            // sized for every point to be in range, then shrunk to the ones that were
+            point_cloud_msg.height = 1;
+            point_cloud_msg.width = this->projection_.width() * this->projection_.height();
+            mrover::fillPointCloudMessageHeader<KinectPoint>(point_cloud_msg);
+            mrover::PointCloudView<KinectPoint> points{point_cloud_msg};
+            size_t count = this->projection_.projectValid(frame.depth.data(), colors,
+                                                          this->point_cloud_cutoff_, this->point_cloud_cutoff_max_, points.data());
+            point_cloud_msg.width = static_cast<uint32_t>(count);
+            point_cloud_msg.row_step = point_cloud_msg.point_step * point_cloud_msg.width;
+            point_cloud_msg.data.resize(point_cloud_msg.row_step);
+            point_cloud_msg.is_dense = true;
+        } else {
+            point_cloud_msg.height = this->projection_.height();
+            point_cloud_msg.width = this->projection_.width();
+            mrover::fillPointCloudMessageHeader<KinectPoint>(point_cloud_msg);
+            mrover::PointCloudView<KinectPoint> points{point_cloud_msg};
+            point_cloud_msg.is_dense = this->projection_.project(frame.depth.data(), colors,
+                                                                 this->point_cloud_cutoff_, this->point_cloud_cutoff_max_, points.data());
+        }
         return true;
     }
 
     // Fill depth information
     bool GazeboRosOpenniKinect::FillDepthImageHelper(
             sensor_msgs::Image& image_msg,
-            uint32_t rows_arg, uint32_t cols_arg,
-            uint32_t step_arg, void* data_arg) {
+            DepthFrame const& frame) {
+        uint32_t rows_arg = frame.height;
+        uint32_t cols_arg = frame.width;
         image_msg.height = rows_arg;
         image_msg.width = cols_arg;
         image_msg.is_bigendian = 0;
@@ -422,7 +445,7 @@ namespace gazebo {
             dest.dest_uint16 = (uint16_t*) (&(image_msg.data[0]));
         }
 
-        float* toCopyFrom = (float*) data_arg;
+        const float* toCopyFrom = frame.depth.data();
         int index = 0;
 
         // convert depth to point cloud
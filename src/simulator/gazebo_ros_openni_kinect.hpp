@@ -0,0 +1,167 @@
+/*
+ * Copyright 2013 Open Source Robotics Foundation
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+*/
+
+/*
+   Desc: GazeboRosOpenniKinect plugin for simulating cameras in Gazebo
+   Author: John Hsu
+   Date: 24 Sept 2008
+
+   Local copy of the header from gazebo_plugins, so the plugin can keep state of its own.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// ros stuff
+#include <ros/advertise_options.h>
+#include <ros/callback_queue.h>
+#include <ros/ros.h>
+
+// ros messages stuff
+#include <sensor_msgs/CameraInfo.h>
+#include <sensor_msgs/Image.h>
+#include <sensor_msgs/PointCloud2.h>
+#include <sensor_msgs/fill_image.h>
+#include <sensor_msgs/image_encodings.h>
+
+// gazebo stuff
+#include <gazebo/common/Time.hh>
+#include <gazebo/physics/physics.hh>
+#include <gazebo/plugins/DepthCameraPlugin.hh>
+#include <gazebo/sensors/SensorTypes.hh>
+#include <sdf/Param.hh>
+
+// camera stuff
+#include <gazebo_plugins/gazebo_ros_camera_utils.h>
+
+#include <triple_buffer.hpp>
+
+#include "depth_projection.hpp"
+
+namespace gazebo {
+
+    class GazeboRosOpenniKinect : public DepthCameraPlugin, GazeboRosCameraUtils {
+    public:
+        GazeboRosOpenniKinect();
+
+        ~GazeboRosOpenniKinect() override;
+
+        void Load(sensors::SensorPtr _parent, sdf::ElementPtr _sdf) override;
+
+        virtual void Advertise();
+
+    protected:
+        void OnNewDepthFrame(const float* _image,
+                             unsigned int _width, unsigned int _height,
+                             unsigned int _depth, const std::string& _format) override;
+
+        void OnNewImageFrame(const unsigned char* _image,
+                             unsigned int _width, unsigned int _height,
+                             unsigned int _depth, const std::string& _format) override;
+
+        using GazeboRosCameraUtils::PublishCameraInfo;
+
+        virtual void PublishCameraInfo();
+
+        ros::Publisher depth_image_camera_info_pub_;
+
+    private:
+        /**
+         * @brief Everything needed to convert one depth frame, copied so the sensor thread can move on.
+         */
+        struct DepthFrame {
+            std::vector<float> depth;
+            // Color image from the same sensor, only copied when a point cloud is wanted
+            std::vector<uint8_t> image;
+            uint32_t width = 0, height = 0;
+            double horizontal_fov = 0;
+            common::Time stamp;
+            bool fill_point_cloud = false, fill_depth_image = false;
+        };
+
+        void StageDepthFrame(const float* _src, bool fill_point_cloud, bool fill_depth_image);
+
+        void ConvertFrames();
+
+        void ReportDroppedFrames();
+
+        void FillPointdCloud(DepthFrame const& frame);
+
+        void FillDepthImage(DepthFrame const& frame);
+
+        bool FillPointCloudHelper(sensor_msgs::PointCloud2& point_cloud_msg, DepthFrame const& frame);
+
+        bool FillDepthImageHelper(sensor_msgs::Image& image_msg, DepthFrame const& frame);
+
+        int point_cloud_connect_count_;
+        void PointCloudConnect();
+        void PointCloudDisconnect();
+
+        int depth_image_connect_count_;
+        void DepthImageConnect();
+        void DepthImageDisconnect();
+
+        int depth_info_connect_count_;
+        void DepthInfoConnect();
+        void DepthInfoDisconnect();
+
+        common::Time last_depth_image_camera_info_update_time_;
+        common::Time depth_sensor_update_time_;
+
+        ros::Publisher point_cloud_pub_;
+        ros::Publisher depth_image_pub_;
+
+        sensor_msgs::PointCloud2 point_cloud_msg_;
+        sensor_msgs::Image depth_image_msg_;
+
+        double point_cloud_cutoff_;
+        double point_cloud_cutoff_max_;
+
+        std::string point_cloud_topic_name_;
+        std::string depth_image_topic_name_;
+        std::string depth_image_camera_info_topic_name_;
+
+        bool use_depth_image_16UC1_format_;
+
+        // Only the points in range, in one row, instead of one point per pixel
+        bool point_cloud_unorganized_;
+
+        // Rays through every pixel, rebuilt when the resolution or field of view changes
+        mrover::DepthProjection projection_;
+
+        event::ConnectionPtr load_connection_;
+
+        // Frames go from the sensor thread to the worker, which only ever converts the newest one
+        TripleBuffer<DepthFrame> frames_;
+        std::thread worker_;
+        std::mutex worker_mutex_;
+        std::condition_variable worker_condition_;
+        bool is_worker_stopping_ = false;
+
+        std::atomic<uint64_t> staged_frame_count_{0}, dropped_frame_count_{0};
+        // Only touched by the worker
+        uint64_t reported_staged_count_ = 0, reported_dropped_count_ = 0;
+        ros::WallTime last_drop_report_time_;
+    };
+
+} // namespace gazebo
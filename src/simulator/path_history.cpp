@@ -0,0 +1,62 @@
+#include "path_history.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+namespace mrover {
+
+    namespace {
+
+        double distanceBetween(geometry_msgs::Point const& a, geometry_msgs::Point const& b) {
+            return std::hypot(a.x - b.x, a.y - b.y, a.z - b.z);
+        }
+
+        /**
+         * @brief Angle of the rotation from one orientation to the other, both have to be normalized.
+         */
+        double angleBetween(geometry_msgs::Quaternion const& a, geometry_msgs::Quaternion const& b) {
+            // q and -q are the same orientation
+            double dot = std::abs(a.x * b.x + a.y * b.y + a.z * b.z + a.w * b.w);
+            return 2 * std::acos(std::min(dot, 1.0));
+        }
+
+    } // namespace
+
+    PathHistory::PathHistory(size_t capacity, double minDistance, double minAngle)
+        : mPoses(std::max<size_t>(capacity, 1)), mMinDistance{minDistance}, mMinAngle{minAngle} {}
+
+    bool PathHistory::add(geometry_msgs::PoseStamped const& pose) {
+        if (mSize > 0) {
+            geometry_msgs::Pose const& last = mPoses[(mOldest + mSize - 1) % mPoses.size()].pose;
+            if (distanceBetween(pose.pose.position, last.position) < mMinDistance &&
+                angleBetween(pose.pose.orientation, last.orientation) < mMinAngle) return false;
+        }
+
+        // Assigning over a forgotten pose reuses the memory of its frame id
+        if (mSize < mPoses.size()) {
+            mPoses[(mOldest + mSize) % mPoses.size()] = pose;
+            ++mSize;
+        } else {
+            mPoses[mOldest] = pose;
+            mOldest = (mOldest + 1) % mPoses.size();
+        }
+        ++mEnd;
+        return true;
+    }
+
+    void PathHistory::clear() {
+        mOldest = 0;
+        mSize = 0;
+    }
+
+    void PathHistory::fill(nav_msgs::Path& path, uint64_t begin) const {
+        uint64_t first = std::max(begin, mEnd - mSize);
+        size_t count = first < mEnd ? static_cast<size_t>(mEnd - first) : 0;
+        size_t skipped = mSize - count;
+        path.poses.resize(count);
+        for (size_t i = 0; i < count; ++i) {
+            path.poses[i] = mPoses[(mOldest + skipped + i) % mPoses.size()];
+        }
+    }
+
+} // namespace mrover
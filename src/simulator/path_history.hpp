@@ -0,0 +1,59 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include <geometry_msgs/PoseStamped.h>
+#include <nav_msgs/Path.h>
+
+namespace mrover {
+
+    /**
+     * @brief Most recent poses of a path, only kept when the pose moved or turned enough since the last one kept.
+     *
+     * Poses live in a ring buffer with a fixed capacity, once it is full the oldest pose makes room for the newest.
+     * Memory and the cost of filling a path message are bounded by the capacity no matter how long the path has been recorded.
+     *
+     * Kept poses are numbered from zero in the order they were kept, so a publisher can send only the ones it has not sent yet.
+     */
+    class PathHistory {
+        std::vector<geometry_msgs::PoseStamped> mPoses;
+        size_t mOldest = 0, mSize = 0;
+        // Number the next kept pose gets
+        uint64_t mEnd = 0;
+        double mMinDistance, mMinAngle;
+
+    public:
+        /**
+         * @param capacity      Most poses held, at least one
+         * @param minDistance   Meters the position has to move from the last kept pose for a pose to be kept
+         * @param minAngle      Radians the orientation has to turn from the last kept pose for a pose to be kept
+         */
+        PathHistory(size_t capacity, double minDistance, double minAngle);
+
+        /**
+         * @return Whether the pose was kept, the first pose always is
+         */
+        bool add(geometry_msgs::PoseStamped const& pose);
+
+        void clear();
+
+        [[nodiscard]] size_t size() const { return mSize; }
+
+        [[nodiscard]] size_t capacity() const { return mPoses.size(); }
+
+        /**
+         * @brief Number the next kept pose will get, also how many poses were ever kept.
+         */
+        [[nodiscard]] uint64_t end() const { return mEnd; }
+
+        /**
+         * @brief Replaces the poses of @p path with the held poses numbered @p begin and later, oldest first. The header is left alone.
+         *
+         * Poses that were already forgotten are skipped, zero gives every pose held.
+         */
+        void fill(nav_msgs::Path& path, uint64_t begin = 0) const;
+    };
+
+} // namespace mrover
@@ -2,13 +2,19 @@
 
 #include <algorithm>
 #include <array>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
 #include <numeric>
+#include <type_traits>
 #include <vector>
 
 /***
  * A filter that combines multiple readings into one.
  * A user defined proportion acts as a median filter that gets rids of outliers,
  * which are then piped into a mean filter that averages out the values.
+ * Each push moves only the sorted values between the one it drops and the one it adds, nothing is re-sorted.
  *
  * @tparam T Reading type
  */
@@ -16,6 +22,7 @@ template<typename T>
 class MeanMedianFilter {
 private:
     std::vector<T> mValues;
+    // The same values as mValues, kept sorted as each push replaces one.
     std::vector<T> mSortedValues;
     // After sorting, what proportion in the middle values should we use.
     double mProportion;
@@ -25,18 +32,84 @@ private:
     // Index to the current head.
     // Note this is a circular buffer, so this will wrap around when we reach the end of the internal vector.
     size_t mHead = 0;
+    // Sum of the middle sorted values, only kept for integers.
+    // Floating point sums depend on the order of the additions, so they are added up smallest first when read, like a fresh sort would.
+    T mTrimmedSum{};
+
+    static constexpr bool KEEPS_SUM = std::is_integral_v<T>;
+
+    /**
+     * @return How many sorted values are cut from each end before averaging
+     */
+    [[nodiscard]] size_t trimCount() const {
+        return static_cast<size_t>(mProportion * static_cast<double>(size()) / 4);
+    }
+
+    /**
+     * @return Sum of the sorted values in [@p begin, @p end) that are also in the middle range
+     */
+    [[nodiscard]] T trimmedSumOf(size_t begin, size_t end) const {
+        size_t trim = trimCount();
+        begin = std::max(begin, trim);
+        end = std::min(end, size() - std::min(trim, size()));
+        if (begin >= end) return T{};
+        return std::accumulate(mSortedValues.begin() + static_cast<std::ptrdiff_t>(begin), mSortedValues.begin() + static_cast<std::ptrdiff_t>(end), T{});
+    }
+
+    void resort() {
+        mSortedValues.assign(mValues.begin(), mValues.end());
+        std::sort(mSortedValues.begin(), mSortedValues.end());
+        if constexpr (KEEPS_SUM) mTrimmedSum = trimmedSumOf(0, size());
+    }
+
+    /**
+     * @brief Swaps one occurrence of @p removed in the sorted values for @p added, moving only the values between the two.
+     */
+    void replaceSorted(T removed, T added) {
+        auto removedIt = std::lower_bound(mSortedValues.begin(), mSortedValues.end(), removed);
+        auto addedIt = std::lower_bound(mSortedValues.begin(), mSortedValues.end(), added);
+        auto removedIndex = static_cast<size_t>(removedIt - mSortedValues.begin());
+        auto addedIndex = static_cast<size_t>(addedIt - mSortedValues.begin());
+
+        // Only values between the two positions move, so only those can enter or leave the middle range
+        size_t changedBegin = std::min(removedIndex, addedIndex), changedEnd = std::max(removedIndex + 1, addedIndex);
+        if constexpr (KEEPS_SUM) mTrimmedSum -= trimmedSumOf(changedBegin, changedEnd);
+        if (addedIt > removedIt) {
+            // Values in between are smaller than the added one, they move down into the gap
+            *std::move(removedIt + 1, addedIt, removedIt) = added;
+        } else {
+            std::move_backward(addedIt, removedIt, removedIt + 1);
+            *addedIt = added;
+        }
+        if constexpr (KEEPS_SUM) mTrimmedSum += trimmedSumOf(changedBegin, changedEnd);
+    }
 
 public:
-    MeanMedianFilter() : mValues(1), mProportion(0.0) {}
+    MeanMedianFilter() : mValues(1), mSortedValues(1), mProportion(0.0) {}
 
     MeanMedianFilter(size_t size, double centerProportion) : mValues(size), mSortedValues(size), mProportion(centerProportion) {}
 
+    /**
+     * @brief Changes the number of readings combined, keeping the newest ones.
+     */
     void setFilterCount(size_t filterCount) {
-        mValues.resize(filterCount);
+        assert(filterCount > 0);
+
+        // Laid out oldest to newest, so the head is on the newest and the next push goes after it
+        size_t kept = std::min(filterCount, size());
+        std::vector<T> values(filterCount);
+        for (size_t age = 0; age < kept; ++age) {
+            values[kept - 1 - age] = mValues[(mHead + size() - age) % size()];
+        }
+        mValues = std::move(values);
+        mHead = kept - 1;
+        mFilterCount = std::min(mFilterCount, filterCount);
+        resort();
     }
 
     void setProportion(float proportion) {
         mProportion = proportion;
+        if constexpr (KEEPS_SUM) mTrimmedSum = trimmedSumOf(0, size());
     }
 
     /**
@@ -44,10 +117,9 @@ public:
      */
     void push(T value) {
         mHead = (mHead + 1) % size();
+        replaceSorted(mValues[mHead], value);
         mValues[mHead] = value;
         mFilterCount = std::min(mFilterCount + 1, size());
-        mSortedValues.assign(mValues.begin(), mValues.end());
-        std::sort(mSortedValues.begin(), mSortedValues.end());
     }
 
     void reset() {
@@ -84,8 +156,168 @@ public:
         if (!full()) {
             return mValues[mHead];
         }
-        auto begin = mSortedValues.begin() + (mProportion * size() / 4);
-        auto end = mSortedValues.end() - (mProportion * size() / 4);
-        return std::accumulate(begin, end, T{}) / (end - begin);
+        auto trim = static_cast<std::ptrdiff_t>(trimCount());
+        auto count = static_cast<std::ptrdiff_t>(size()) - 2 * trim;
+        if constexpr (KEEPS_SUM) {
+            return mTrimmedSum / count;
+        } else {
+            return std::accumulate(mSortedValues.begin() + trim, mSortedValues.end() - trim, T{}) / count;
+        }
+    }
+};
+
+/***
+ * Many mean median filters over readings that arrive together, like the axes of an IMU or the speed of each wheel.
+ * Gives the same values as a MeanMedianFilter per channel.
+ * Values are stored rank by rank with the channels side by side, so every step of a push or a get is the same operation on each channel.
+ * Those steps are branch free loops over a fixed number of channels, which the compiler vectorizes.
+ *
+ * @tparam T        Reading type
+ * @tparam Channels Number of filtered signals
+ */
+template<typename T, size_t Channels>
+class MultiChannelMeanMedianFilter {
+public:
+    using Reading = std::array<T, Channels>;
+
+private:
+    // Circular buffer of readings, the same as in MeanMedianFilter.
+    std::vector<Reading> mValues;
+    // Row i holds the i-th smallest value of each channel.
+    std::vector<Reading> mSortedValues;
+    double mProportion;
+    size_t mFilterCount = 0;
+    size_t mHead = 0;
+
+    // Below and above every value, so the first and last ranks need no special case
+    static constexpr T LOWEST = std::numeric_limits<T>::has_infinity ? -std::numeric_limits<T>::infinity() : std::numeric_limits<T>::lowest();
+    static constexpr T HIGHEST = std::numeric_limits<T>::has_infinity ? std::numeric_limits<T>::infinity() : std::numeric_limits<T>::max();
+
+    [[nodiscard]] size_t trimCount() const {
+        return static_cast<size_t>(mProportion * static_cast<double>(size()) / 4);
+    }
+
+    /**
+     * @brief Moves one rank of every channel to where it is once the removed value is swapped for the added one.
+     *
+     * @param previous  The rank below as it was before the swap, updated to this rank as it was
+     */
+    static void replaceRank(uint32_t rank, std::array<uint32_t, Channels> const& removedRank, Reading const& added,
+                            Reading& previous, Reading& row, Reading const& next) {
+        for (size_t channel = 0; channel < Channels; ++channel) {
+            T current = row[channel];
+            T below = std::max(previous[channel], std::min(added[channel], current));
+            T above = std::min(next[channel], std::max(added[channel], current));
+            T at = std::min(std::max(added[channel], previous[channel]), next[channel]);
+            previous[channel] = current;
+            row[channel] = rank < removedRank[channel] ? below : rank > removedRank[channel] ? above : at;
+        }
+    }
+
+    void resort() {
+        mSortedValues = mValues;
+        std::vector<T> column(size());
+        for (size_t channel = 0; channel < Channels; ++channel) {
+            for (size_t i = 0; i < size(); ++i) column[i] = mValues[i][channel];
+            std::sort(column.begin(), column.end());
+            for (size_t i = 0; i < size(); ++i) mSortedValues[i][channel] = column[i];
+        }
+    }
+
+public:
+    MultiChannelMeanMedianFilter() : mValues(1), mSortedValues(1), mProportion(0.0) {}
+
+    MultiChannelMeanMedianFilter(size_t size, double centerProportion) : mValues(size), mSortedValues(size), mProportion(centerProportion) {
+        assert(size > 0 && size < std::numeric_limits<uint32_t>::max());
+    }
+
+    /**
+     * @brief Changes the number of readings combined, keeping the newest ones.
+     */
+    void setFilterCount(size_t filterCount) {
+        assert(filterCount > 0 && filterCount < std::numeric_limits<uint32_t>::max());
+
+        size_t kept = std::min(filterCount, size());
+        std::vector<Reading> values(filterCount);
+        for (size_t age = 0; age < kept; ++age) {
+            values[kept - 1 - age] = mValues[(mHead + size() - age) % size()];
+        }
+        mValues = std::move(values);
+        mHead = kept - 1;
+        mFilterCount = std::min(mFilterCount, filterCount);
+        resort();
+    }
+
+    void setProportion(float proportion) {
+        mProportion = proportion;
+    }
+
+    /**
+     * @brief Add a reading of every channel, overwrites old readings if full.
+     */
+    void push(Reading const& reading) {
+        mHead = (mHead + 1) % size();
+        Reading removed = mValues[mHead];
+        mValues[mHead] = reading;
+        mFilterCount = std::min(mFilterCount + 1, size());
+
+        // The removed value is the first sorted one equal to it, its rank is how many are smaller
+        std::array<uint32_t, Channels> removedRank{};
+        for (Reading const& row: mSortedValues) {
+            for (size_t channel = 0; channel < Channels; ++channel) removedRank[channel] += row[channel] < removed[channel];
+        }
+
+        // Swap the removed value for the added one in one pass. Below the removed rank values move up to make room for the added one,
+        // above it they move down into the gap. Either way each rank becomes one of its neighbors or the added value.
+        Reading added = reading, previous, highest;
+        previous.fill(LOWEST);
+        highest.fill(HIGHEST);
+        for (size_t i = 0; i + 1 < size(); ++i) {
+            replaceRank(static_cast<uint32_t>(i), removedRank, added, previous, mSortedValues[i], mSortedValues[i + 1]);
+        }
+        replaceRank(static_cast<uint32_t>(size() - 1), removedRank, added, previous, mSortedValues.back(), highest);
+    }
+
+    void reset() {
+        mFilterCount = 0;
+    }
+
+    void decrementCount() {
+        mFilterCount = std::max(mFilterCount - 1, size_t{});
+    }
+
+    [[nodiscard]] size_t size() const {
+        return mValues.size();
+    }
+
+    [[nodiscard]] size_t filterCount() const {
+        return mFilterCount;
+    }
+
+    [[nodiscard]] bool ready() const {
+        return mFilterCount > 0;
+    }
+
+    [[nodiscard]] bool full() const {
+        return mFilterCount == size();
+    }
+
+    /***
+     * @return Filtered reading of every channel if full, or else the most recent reading if we don't have enough readings yet.
+     */
+    [[nodiscard]] Reading get() const {
+        if (!full()) {
+            return mValues[mHead];
+        }
+        size_t trim = trimCount();
+        // Each channel is added up smallest first, like MeanMedianFilter, so the sums round the same way
+        Reading sums{};
+        for (size_t i = trim; i < size() - trim; ++i) {
+            for (size_t channel = 0; channel < Channels; ++channel) sums[channel] += mSortedValues[i][channel];
+        }
+        auto count = static_cast<std::ptrdiff_t>(size() - 2 * trim);
+        Reading filtered;
+        for (size_t channel = 0; channel < Channels; ++channel) filtered[channel] = static_cast<T>(sums[channel] / count);
+        return filtered;
     }
 };
@@ -1,5 +1,167 @@
 #include "se3.hpp"
 
+#include <array>
+#include <cstring>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+#include <tbb/blocked_range.h>
+#include <tbb/parallel_for.h>
+
+namespace {
+
+    // Below this a cloud is transformed faster than tasks can be handed out
+    constexpr size_t PARALLEL_POINT_COUNT = 1 << 16;
+    constexpr size_t POINTS_PER_TASK = 1 << 14;
+
+    /**
+     * @brief Skew symmetric matrix, multiplying by it is the cross product with @p v.
+     */
+    Eigen::Matrix3d hat(R3 const& v) {
+        Eigen::Matrix3d matrix;
+        matrix << 0, -v.z(), v.y(),
+                v.z(), 0, -v.x(),
+                -v.y(), v.x(), 0;
+        return matrix;
+    }
+
+    /**
+     * @brief Single precision copy of a transform, columns of the rotation and the translation.
+     */
+    struct PointTransform {
+        std::array<std::array<float, 3>, 3> columns;
+        std::array<float, 3> translation;
+    };
+
+    void transformScalar(PointTransform const& transform, std::byte* at, bool isTranslated) {
+        std::array<float, 3> in, out;
+        std::memcpy(in.data(), at, sizeof(in));
+        for (size_t row = 0; row < 3; ++row) {
+            float value = transform.columns[0][row] * in[0] + transform.columns[1][row] * in[1] + transform.columns[2][row] * in[2];
+            out[row] = isTranslated ? value + transform.translation[row] : value;
+        }
+        std::memcpy(at, out.data(), sizeof(out));
+    }
+
+    /**
+     * @brief Transforms packed x, y, z floats four points at a time, returns how many were handled so the caller can finish the tail.
+     *
+     * Three loads hold four points, they are shuffled into planes of x, y and z and back, so no store overlaps the next load.
+     */
+    size_t transformPackedSimd([[maybe_unused]] PointTransform const& transform, [[maybe_unused]] float* xyz, [[maybe_unused]] size_t count) {
+        [[maybe_unused]] constexpr size_t LANES = 4;
+
+        size_t i = 0;
+#if defined(__SSE2__)
+        // Plain arrays, std::array drops the vector type's alignment attribute
+        __m128 columns[3][3], translation[3];
+        for (size_t row = 0; row < 3; ++row) {
+            for (size_t column = 0; column < 3; ++column) columns[column][row] = _mm_set1_ps(transform.columns[column][row]);
+            translation[row] = _mm_set1_ps(transform.translation[row]);
+        }
+        for (; i + LANES <= count; i += LANES) {
+            float* at = xyz + i * 3;
+            // a = x0 y0 z0 x1, b = y1 z1 x2 y2, c = z2 x3 y3 z3
+            __m128 a = _mm_loadu_ps(at), b = _mm_loadu_ps(at + 4), c = _mm_loadu_ps(at + 8);
+            __m128 ab = _mm_shuffle_ps(a, b, _MM_SHUFFLE(1, 0, 2, 1));
+            __m128 in[3]{
+                    _mm_shuffle_ps(a, _mm_shuffle_ps(b, c, _MM_SHUFFLE(1, 0, 3, 2)), _MM_SHUFFLE(3, 0, 3, 0)),
+                    _mm_shuffle_ps(ab, _mm_shuffle_ps(b, c, _MM_SHUFFLE(3, 2, 3, 2)), _MM_SHUFFLE(2, 1, 2, 0)),
+                    _mm_shuffle_ps(ab, c, _MM_SHUFFLE(3, 0, 3, 1)),
+            };
+            __m128 out[3];
+            for (size_t row = 0; row < 3; ++row) {
+                out[row] = _mm_add_ps(translation[row], _mm_mul_ps(columns[0][row], in[0]));
+                out[row] = _mm_add_ps(out[row], _mm_mul_ps(columns[1][row], in[1]));
+                out[row] = _mm_add_ps(out[row], _mm_mul_ps(columns[2][row], in[2]));
+            }
+            auto const& [x, y, z] = out;
+            auto interleave = [](__m128 first, __m128 second) { return _mm_shuffle_ps(first, second, _MM_SHUFFLE(2, 0, 2, 0)); };
+            _mm_storeu_ps(at, interleave(_mm_shuffle_ps(x, y, _MM_SHUFFLE(0, 0, 0, 0)), _mm_shuffle_ps(z, x, _MM_SHUFFLE(1, 1, 0, 0))));
+            _mm_storeu_ps(at + 4, interleave(_mm_shuffle_ps(y, z, _MM_SHUFFLE(1, 1, 1, 1)), _mm_shuffle_ps(x, y, _MM_SHUFFLE(2, 2, 2, 2))));
+            _mm_storeu_ps(at + 8, interleave(_mm_shuffle_ps(z, x, _MM_SHUFFLE(3, 3, 2, 2)), _mm_shuffle_ps(y, z, _MM_SHUFFLE(3, 3, 3, 3))));
+        }
+#elif defined(__ARM_NEON)
+        for (; i + LANES <= count; i += LANES) {
+            float* at = xyz + i * 3;
+            float32x4x3_t in = vld3q_f32(at), out;
+            for (size_t row = 0; row < 3; ++row) {
+                out.val[row] = vdupq_n_f32(transform.translation[row]);
+                for (size_t column = 0; column < 3; ++column) out.val[row] = vmlaq_n_f32(out.val[row], in.val[column], transform.columns[column][row]);
+            }
+            vst3q_f32(at, out);
+        }
+#endif
+        return i;
+    }
+
+    /**
+     * @brief Transforms point structs one at a time, returns how many were handled so the caller can finish the tail.
+     *
+     * The fourth float loaded with each position belongs to whatever follows it, so it is stored back untouched.
+     * That can be the next point, which is why the last point is always left to the caller.
+     */
+    size_t transformStridedSimd([[maybe_unused]] PointTransform const& transform, [[maybe_unused]] std::byte* points, [[maybe_unused]] size_t count,
+                                [[maybe_unused]] size_t stride, [[maybe_unused]] size_t normalOffset) {
+        size_t i = 0;
+#if defined(__SSE2__)
+        auto const& [c0, c1, c2] = transform.columns;
+        __m128 const column0 = _mm_setr_ps(c0[0], c0[1], c0[2], 0), column1 = _mm_setr_ps(c1[0], c1[1], c1[2], 0), column2 = _mm_setr_ps(c2[0], c2[1], c2[2], 0);
+        __m128 const translation = _mm_setr_ps(transform.translation[0], transform.translation[1], transform.translation[2], 0);
+        __m128 const keepMask = _mm_castsi128_ps(_mm_setr_epi32(0, 0, 0, -1));
+        auto transformAt = [&](std::byte* at, __m128 offset) {
+            auto* floats = reinterpret_cast<float*>(at);
+            __m128 in = _mm_loadu_ps(floats);
+            // Broadcasting keeps the fourth float out of the arithmetic, it may be color bytes that read as a denormal
+            __m128 out = _mm_add_ps(offset, _mm_mul_ps(column0, _mm_shuffle_ps(in, in, _MM_SHUFFLE(0, 0, 0, 0))));
+            out = _mm_add_ps(out, _mm_mul_ps(column1, _mm_shuffle_ps(in, in, _MM_SHUFFLE(1, 1, 1, 1))));
+            out = _mm_add_ps(out, _mm_mul_ps(column2, _mm_shuffle_ps(in, in, _MM_SHUFFLE(2, 2, 2, 2))));
+            _mm_storeu_ps(floats, _mm_or_ps(_mm_andnot_ps(keepMask, out), _mm_and_ps(keepMask, in)));
+        };
+        for (; i + 1 < count; ++i) {
+            std::byte* point = points + i * stride;
+            transformAt(point, translation);
+            if (normalOffset) transformAt(point + normalOffset, _mm_setzero_ps());
+        }
+#elif defined(__ARM_NEON)
+        auto const& [c0, c1, c2] = transform.columns;
+        float32x4_t const column0 = {c0[0], c0[1], c0[2], 0}, column1 = {c1[0], c1[1], c1[2], 0}, column2 = {c2[0], c2[1], c2[2], 0};
+        float32x4_t const translation = {transform.translation[0], transform.translation[1], transform.translation[2], 0};
+        uint32x4_t const keepMask = {0, 0, 0, 0xFFFFFFFF};
+        auto transformAt = [&](std::byte* at, float32x4_t offset) {
+            auto* floats = reinterpret_cast<float*>(at);
+            float32x4_t in = vld1q_f32(floats);
+            float32x4_t out = vmlaq_n_f32(offset, column0, vgetq_lane_f32(in, 0));
+            out = vmlaq_n_f32(out, column1, vgetq_lane_f32(in, 1));
+            out = vmlaq_n_f32(out, column2, vgetq_lane_f32(in, 2));
+            vst1q_f32(floats, vbslq_f32(keepMask, in, out));
+        };
+        for (; i + 1 < count; ++i) {
+            std::byte* point = points + i * stride;
+            transformAt(point, translation);
+            if (normalOffset) transformAt(point + normalOffset, vdupq_n_f32(0));
+        }
+#endif
+        return i;
+    }
+
+    void transformRange(PointTransform const& transform, std::byte* points, size_t count, size_t stride, size_t normalOffset) {
+        size_t i = stride == 3 * sizeof(float) && !normalOffset
+                           ? transformPackedSimd(transform, reinterpret_cast<float*>(points), count)
+                           : transformStridedSimd(transform, points, count, stride, normalOffset);
+        for (; i < count; ++i) {
+            std::byte* point = points + i * stride;
+            transformScalar(transform, point, true);
+            if (normalOffset) transformScalar(transform, point + normalOffset, false);
+        }
+    }
+
+} // namespace
+
 SE3 SE3::fromTfTree(tf2_ros::Buffer const& buffer, std::string const& fromFrameId, std::string const& toFrameId) {
     geometry_msgs::TransformStamped transform = buffer.lookupTransform(fromFrameId, toFrameId, ros::Time(0));
     return SE3::fromTf(transform.transform);
@@ -11,7 +173,7 @@ void SE3::pushToTfTree(tf2_ros::TransformBroadcaster& broadcaster, std::string c
 
 SE3::SE3(R3 const& position, SO3 const& rotation) {
     mTransform.translate(position);
-    mTransform.rotate(rotation.mAngleAxis);
+    mTransform.rotate(rotation.mQuaternion);
 }
 
 Eigen::Matrix4d SE3::matrix() const {
@@ -33,3 +195,56 @@ double SE3::distanceTo(SE3 const& other) const {
 SE3 SE3::operator*(SE3 const& other) const {
     return other.mTransform * mTransform;
 }
+
+SE3 SE3::exp(R6 const& tangent) {
+    R3 translation = tangent.head<3>(), rotation = tangent.tail<3>();
+    double angle = rotation.norm();
+    Eigen::Matrix3d w = hat(rotation), w2 = w * w;
+    // Left Jacobian of SO3, it carries the translation along the arc the rotation sweeps
+    Eigen::Matrix3d v = angle < 1e-5
+                                ? Eigen::Matrix3d{Eigen::Matrix3d::Identity() + w / 2 + w2 / 6}
+                                : Eigen::Matrix3d{Eigen::Matrix3d::Identity() + (1 - std::cos(angle)) / (angle * angle) * w + (angle - std::sin(angle)) / (angle * angle * angle) * w2};
+    return {v * translation, SO3::exp(rotation)};
+}
+
+R6 SE3::log() const {
+    R3 rotation = this->rotation().log();
+    double angle = rotation.norm();
+    Eigen::Matrix3d w = hat(rotation), w2 = w * w;
+    Eigen::Matrix3d vInverse = angle < 1e-5
+                                       ? Eigen::Matrix3d{Eigen::Matrix3d::Identity() - w / 2 + w2 / 12}
+                                       : Eigen::Matrix3d{Eigen::Matrix3d::Identity() - w / 2 + (1 - angle * std::sin(angle) / (2 * (1 - std::cos(angle)))) / (angle * angle) * w2};
+    R6 tangent;
+    tangent << vInverse * position(), rotation;
+    return tangent;
+}
+
+SE3 SE3::inverse() const {
+    return mTransform.inverse(Eigen::Isometry);
+}
+
+SE3 SE3::interpolate(SE3 const& other, double t) const {
+    return {position() + t * (other.position() - position()), rotation().interpolate(other.rotation(), t)};
+}
+
+R3 SE3::apply(R3 const& point) const {
+    return mTransform * point;
+}
+
+void SE3::applyStrided(std::byte* positions, size_t count, size_t stride, size_t normalOffset) const {
+    PointTransform transform;
+    Eigen::Matrix3f rotation = mTransform.rotation().cast<float>();
+    for (size_t column = 0; column < 3; ++column) {
+        for (size_t row = 0; row < 3; ++row) transform.columns[column][row] = rotation(static_cast<Eigen::Index>(row), static_cast<Eigen::Index>(column));
+        transform.translation[column] = static_cast<float>(mTransform.translation()[static_cast<Eigen::Index>(column)]);
+    }
+
+    if (count < PARALLEL_POINT_COUNT) {
+        transformRange(transform, positions, count, stride, normalOffset);
+        return;
+    }
+    // Ranges never share a point, each leaves its last point to the scalar path so the vector stores stay inside it
+    tbb::parallel_for(tbb::blocked_range<size_t>{0, count, POINTS_PER_TASK}, [&](tbb::blocked_range<size_t> const& range) {
+        transformRange(transform, positions + range.begin() * stride, range.size(), stride, normalOffset);
+    });
+}
@@ -2,6 +2,9 @@
 
 #include <boost_cpp23_workaround.hpp>
 
+#include <cstddef>
+#include <type_traits>
+
 #include <tf2_ros/buffer.h>
 #include <tf2_ros/transform_broadcaster.h>
 #include <tf2_ros/transform_listener.h>
@@ -13,24 +16,72 @@
 #include <Eigen/Geometry>
 
 using R3 = Eigen::Vector3d;
+using R6 = Eigen::Matrix<double, 6, 1>;
+
+namespace lie {
+
+    template<typename PointT, typename = void>
+    struct HasNormal : std::false_type {};
+
+    template<typename PointT>
+    struct HasNormal<PointT, std::void_t<decltype(PointT::normal_x)>> : std::true_type {};
+
+} // namespace lie
 
 /**
- * @brief A 3D rotation.
+ * @brief A 3D rotation, stored as a unit quaternion.
  */
 class SO3 {
 private:
     using AngleAxis = Eigen::AngleAxis<double>;
 
-    AngleAxis mAngleAxis = AngleAxis::Identity();
+    Eigen::Quaterniond mQuaternion = Eigen::Quaterniond::Identity();
+
+    template<typename... Args>
+    static Eigen::Quaterniond toQuaternion(Args&&... args) {
+        // Quaternions and rotation matrices are taken as is, anything else goes through an angle axis like before
+        if constexpr (sizeof...(Args) == 1 && std::is_constructible_v<Eigen::Quaterniond, Args...>) {
+            return Eigen::Quaterniond{std::forward<Args>(args)...}.normalized();
+        } else {
+            return Eigen::Quaterniond{AngleAxis{std::forward<Args>(args)...}};
+        }
+    }
 
 public:
     friend class SE3;
 
+    // An empty angle axis is left uninitialized, the identity has to come from the member initializer
+    SO3() = default;
+
     // enable_if_t ensures if we add other explicit constructors this one fails quickly
     template<typename... Args, typename = std::enable_if_t<std::is_constructible_v<AngleAxis, Args...>>>
-    SO3(Args&&... args) : mAngleAxis{std::forward<Args>(args)...} {
+    SO3(Args&&... args) : mQuaternion{toQuaternion(std::forward<Args>(args)...)} {
     }
 
+    /**
+     * @brief Rotation of @p tangent norm radians about its direction.
+     */
+    [[nodiscard]] static SO3 exp(R3 const& tangent);
+
+    /**
+     * @brief Inverse of #exp, the rotation as an axis scaled by an angle in [0, pi].
+     */
+    [[nodiscard]] R3 log() const;
+
+    [[nodiscard]] SO3 inverse() const;
+
+    /**
+     * @brief Spherical linear interpolation, along the shorter arc.
+     *
+     * @param t  Zero gives this rotation and one gives @p other
+     */
+    [[nodiscard]] SO3 interpolate(SO3 const& other, double t) const;
+
+    /**
+     * @brief Angle in radians of the rotation between the two, in [0, pi].
+     */
+    [[nodiscard]] double distanceTo(SO3 const& other) const;
+
     [[nodiscard]] SO3 operator*(SO3 const& other) const;
 
     [[nodiscard]] R3 operator*(R3 const& other) const;
@@ -55,27 +106,88 @@ private:
 
     Transform mTransform = Transform::Identity();
 
+    /**
+     * @param positions     First position, the rest are @p stride bytes apart
+     * @param normalOffset  Bytes from a position to its normal, zero when the points have none
+     */
+    void applyStrided(std::byte* positions, size_t count, size_t stride, size_t normalOffset) const;
+
     [[nodiscard]] geometry_msgs::Pose toPose() const;
 
     [[nodiscard]] geometry_msgs::Transform toTransform() const;
 
     [[nodiscard]] geometry_msgs::PoseStamped toPoseStamped(std::string const& frameId) const;
 
+public:
+    /**
+     * @brief Use this to batch several transforms into one broadcast, otherwise prefer pushToTfTree.
+     */
     [[nodiscard]] geometry_msgs::TransformStamped toTransformStamped(const std::string& parentFrameId, const std::string& childFrameId) const;
 
-public:
     [[nodiscard]] static SE3 fromTfTree(tf2_ros::Buffer const& buffer, std::string const& fromFrameId, std::string const& toFrameId);
 
     static void pushToTfTree(tf2_ros::TransformBroadcaster& broadcaster, std::string const& childFrameId, std::string const& parentFrameId, SE3 const& tf);
 
+    // An empty Eigen transform is left uninitialized, the identity has to come from the member initializer
+    SE3() = default;
+
     SE3(R3 const& position, SO3 const& rotation = {});
 
     template<typename... Args, typename = std::enable_if_t<std::is_constructible_v<Transform, Args...>>>
     SE3(Args&&... args) : mTransform{std::forward<Args>(args)...} {
     }
 
+    /**
+     * @brief Transform from a twist, translation in the first three coordinates and rotation in the last three.
+     */
+    [[nodiscard]] static SE3 exp(R6 const& tangent);
+
+    /**
+     * @brief Inverse of #exp.
+     */
+    [[nodiscard]] R6 log() const;
+
+    [[nodiscard]] SE3 inverse() const;
+
+    /**
+     * @brief Interpolates position linearly and rotation spherically, the same way tf2 does between two stamps.
+     *
+     * @param t  Zero gives this transform and one gives @p other
+     */
+    [[nodiscard]] SE3 interpolate(SE3 const& other, double t) const;
+
     [[nodiscard]] SE3 operator*(SE3 const& other) const;
 
+    [[nodiscard]] R3 apply(R3 const& point) const;
+
+    /**
+     * @brief Transforms @p count points in place, stored as packed x, y, z floats.
+     *
+     * Points are transformed in single precision with SIMD, large clouds are split across threads.
+     */
+    void apply(float* xyz, size_t count) const {
+        applyStrided(reinterpret_cast<std::byte*>(xyz), count, 3 * sizeof(float), 0);
+    }
+
+    /**
+     * @brief Transforms @p count point structs in place, such as mrover::Point.
+     *
+     * The struct needs x, y and z floats next to each other. Normals, when it has them, are rotated.
+     * Every other field is left as is bit for bit, including the colors.
+     */
+    template<typename PointT>
+    void apply(PointT* points, size_t count) const {
+        static_assert(std::is_same_v<decltype(PointT::x), float> && offsetof(PointT, y) == offsetof(PointT, x) + sizeof(float) && offsetof(PointT, z) == offsetof(PointT, y) + sizeof(float),
+                      "Positions have to be three packed floats");
+        size_t normalOffset = 0;
+        if constexpr (lie::HasNormal<PointT>::value) {
+            static_assert(std::is_same_v<decltype(PointT::normal_x), float> && offsetof(PointT, normal_y) == offsetof(PointT, normal_x) + sizeof(float) && offsetof(PointT, normal_z) == offsetof(PointT, normal_y) + sizeof(float),
+                          "Normals have to be three packed floats");
+            normalOffset = offsetof(PointT, normal_x) - offsetof(PointT, x);
+        }
+        applyStrided(reinterpret_cast<std::byte*>(points) + offsetof(PointT, x), count, sizeof(PointT), normalOffset);
+    }
+
     [[nodiscard]] Eigen::Matrix4d matrix() const;
 
     [[nodiscard]] R3 position() const;
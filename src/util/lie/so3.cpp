@@ -1,19 +1,44 @@
 #include "se3.hpp"
 
+SO3 SO3::exp(R3 const& tangent) {
+    double angle = tangent.norm();
+    // Near zero the axis is not defined, the first order expansion of the quaternion is exact enough
+    if (angle < 1e-10) return Eigen::Quaterniond{1, tangent.x() / 2, tangent.y() / 2, tangent.z() / 2};
+    return AngleAxis{angle, tangent / angle};
+}
+
+R3 SO3::log() const {
+    // Eigen picks the angle in [0, pi], flipping the axis when the quaternion is on the other half of the sphere
+    AngleAxis angleAxis{mQuaternion};
+    return angleAxis.angle() * angleAxis.axis();
+}
+
+SO3 SO3::inverse() const {
+    return mQuaternion.conjugate();
+}
+
+SO3 SO3::interpolate(SO3 const& other, double t) const {
+    return mQuaternion.slerp(t, other.mQuaternion);
+}
+
+double SO3::distanceTo(SO3 const& other) const {
+    return mQuaternion.angularDistance(other.mQuaternion);
+}
+
 Eigen::Quaterniond SO3::quaternion() const {
-    return Eigen::Quaterniond{mAngleAxis};
+    return mQuaternion;
 }
 
 Eigen::Matrix4d SO3::matrix() const {
     Eigen::Matrix4d matrix = Eigen::Matrix4d::Identity();
-    matrix.block<3, 3>(0, 0) = mAngleAxis.toRotationMatrix();
+    matrix.block<3, 3>(0, 0) = mQuaternion.toRotationMatrix();
     return matrix;
 }
 
 SO3 SO3::operator*(SO3 const& other) const {
-    return quaternion() * other.quaternion();
+    return mQuaternion * other.mQuaternion;
 }
 
 R3 SO3::operator*(R3 const& other) const {
-    return quaternion() * other;
+    return mQuaternion * other;
 }
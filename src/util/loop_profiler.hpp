@@ -1,73 +1,450 @@
 #pragma once
 
+// Be careful what you include in this file, it is compiled with nvcc (NVIDIA CUDA compiler) as C++17
+
+#include <algorithm>
+#include <array>
+#include <atomic>
 #include <chrono>
-#include <numeric>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <mutex>
 #include <optional>
-#include <thread>
-#include <unordered_map>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include <sys/syscall.h>
+#include <unistd.h>
 
 #include <ros/console.h>
 
+/**
+ * @brief Latency distribution of one profiled event over a report window, durations are in milliseconds.
+ */
+struct LoopProfilerEventStats {
+    std::string name;
+    uint64_t count{};
+    double meanMs{}, p50Ms{}, p95Ms{}, p99Ms{}, maxMs{};
+};
+
+/**
+ * @brief One traced event, times are nanoseconds on the steady clock, which is CLOCK_MONOTONIC and shared by every process.
+ */
+struct LoopProfilerSpan {
+    uint32_t event{};
+    int threadId{};
+    uint64_t sequence{};
+    int64_t beginNs{}, endNs{};
+};
+
 /**
  * @brief Profiles the execution time of a loop composed of multiple events.
+ *
+ * Cheap enough to leave on: measuring reads the clock and bumps a histogram bucket, without locking or allocating.
+ * Event names are interned to ids the first time they are seen, after which a string literal is recognized by its address.
+ * Each thread records into its own histograms, so a profiler can be shared by a pool of threads, like nodelet callbacks.
+ * Histograms are log scale with four buckets per power of two nanoseconds, percentiles are within about 12% of the real value.
+ * Any thread can collect them with #report, see LoopProfilerReporter for publishing them.
+ *
+ * With tracing on, every event is also kept as a span in a bounded ring per thread, see writeChromeTrace.
+ *
+ * Usage:
+ *     while (...) {
+ *         profiler.beginLoop();
+ *         waitForWork();
+ *         profiler.measureEvent("Wait"); // Time since the previous event, which was the wait
+ *         doWork();
+ *         profiler.measureEvent("Work");
+ *     }
  */
 class LoopProfiler {
+public:
+    using Clock = std::chrono::steady_clock;
+    using EventId = uint32_t;
+
+    static constexpr size_t MAX_EVENTS = 16; // Including the loop itself, later events are not recorded
+    static constexpr size_t MAX_THREADS = 8; // Threads measuring with one profiler, later threads are not recorded
+    static constexpr EventId LOOP_EVENT = 0; // Time between consecutive calls to beginLoop on a thread
+    static constexpr EventId NO_EVENT = MAX_EVENTS;
+    static constexpr uint64_t NO_SEQUENCE = std::numeric_limits<uint64_t>::max();
+    static constexpr size_t TRACE_CAPACITY = 1 << 14; // Span slots per thread, half a megabyte, the latest one less than this can be read
+
 private:
-    using Clock = std::chrono::high_resolution_clock;
-    using EventReadings = std::vector<Clock::duration>;
-    using DisplayUnits = std::chrono::milliseconds;
+    static constexpr uint32_t SUB_BUCKET_BITS = 2;
+    static constexpr uint32_t SUB_BUCKETS = 1 << SUB_BUCKET_BITS;
+    static constexpr uint32_t MAX_EXPONENT = 40; // 2^40 ns is about 18 minutes, longer durations land in the last bucket
+    static constexpr size_t BUCKET_COUNT = (MAX_EXPONENT - SUB_BUCKET_BITS + 2) * SUB_BUCKETS;
+
+    struct Histogram {
+        // Only the owning thread writes, so a relaxed load and store replace a locked read-modify-write
+        std::array<std::atomic<uint32_t>, BUCKET_COUNT> buckets{};
+        std::atomic<uint64_t> totalNs{};
+        std::atomic<uint64_t> maxNs{}; // Since the last report
+    };
+
+    struct TraceSpan {
+        // Atomic so a dump can read a span while it is being overwritten, the copy is then thrown away
+        std::atomic<int64_t> beginNs{}, endNs{};
+        std::atomic<uint64_t> sequence{};
+        std::atomic<EventId> event{};
+    };
+
+    struct TraceRing {
+        std::array<TraceSpan, TRACE_CAPACITY> spans{};
+        std::atomic<uint64_t> written{};
+    };
+
+    struct Shard {
+        uintptr_t owner{};
+        int threadId{};
+
+        // Only touched by the owning thread
+        std::optional<Clock::time_point> lastEvent, loopBegin;
+        uint64_t sequence = NO_SEQUENCE;
+        std::array<std::pair<char const*, EventId>, MAX_EVENTS * 2> literals{};
+        size_t literalCount{};
+
+        std::array<Histogram, MAX_EVENTS> histograms{};
+
+        // Only touched while reporting, what the histograms held at the last report
+        std::array<std::array<uint32_t, BUCKET_COUNT>, MAX_EVENTS> reportedBuckets{};
+        std::array<uint64_t, MAX_EVENTS> reportedTotalNs{};
+
+        // Allocated by the owning thread the first time it traces
+        std::atomic<TraceRing*> trace{};
+
+        ~Shard() {
+            delete trace.load();
+        }
+    };
 
     std::string mName;
-    size_t mPrintTick;
-    std::unordered_map<std::string, EventReadings> mEventReadings;
 
-    std::optional<Clock::time_point> mLastEpochTime;
-    size_t mTick = 0; // Loop iteration counter
+    std::mutex mMutex; // Interning and claiming shards, never taken once a thread has seen its events
+    std::array<std::string, MAX_EVENTS> mEventNames;
+    std::atomic<uint32_t> mEventCount{};
+    std::array<std::atomic<Shard*>, MAX_THREADS> mShards{};
+
+    std::mutex mReportMutex;
+
+    std::atomic<bool> mIsTracing{};
+
+    static std::mutex& instancesMutex() {
+        static std::mutex mutex;
+        return mutex;
+    }
+
+    static std::vector<LoopProfiler*>& instances() {
+        static std::vector<LoopProfiler*> profilers;
+        return profilers;
+    }
+
+    [[nodiscard]] static uintptr_t threadToken() {
+        // Unique to each running thread, cheaper to get than std::this_thread::get_id
+        static thread_local char token;
+        return reinterpret_cast<uintptr_t>(&token);
+    }
+
+    [[nodiscard]] static size_t bucketOf(uint64_t ns) {
+        if (ns < SUB_BUCKETS) return ns;
+
+        auto exponent = static_cast<uint32_t>(63 - __builtin_clzll(ns));
+        size_t bucket = (static_cast<size_t>(exponent - SUB_BUCKET_BITS + 1) << SUB_BUCKET_BITS) + ((ns >> (exponent - SUB_BUCKET_BITS)) & (SUB_BUCKETS - 1));
+        return std::min(bucket, BUCKET_COUNT - 1);
+    }
+
+    [[nodiscard]] static uint64_t bucketLowerNs(size_t bucket) {
+        if (bucket < SUB_BUCKETS) return bucket;
+
+        auto exponent = static_cast<uint32_t>((bucket >> SUB_BUCKET_BITS) + SUB_BUCKET_BITS - 1);
+        return (SUB_BUCKETS + (bucket & (SUB_BUCKETS - 1))) << (exponent - SUB_BUCKET_BITS);
+    }
+
+    [[nodiscard]] Shard* localShard() {
+        uintptr_t token = threadToken();
+        for (std::atomic<Shard*>& slot: mShards) {
+            Shard* shard = slot.load(std::memory_order_acquire);
+            if (!shard) return claimShard(token);
+            if (shard->owner == token) return shard;
+        }
+        return nullptr;
+    }
+
+    [[nodiscard]] Shard* claimShard(uintptr_t token) {
+        std::scoped_lock lock{mMutex};
+        for (std::atomic<Shard*>& slot: mShards) {
+            if (slot.load(std::memory_order_relaxed)) continue;
+
+            auto* shard = new Shard{};
+            shard->owner = token;
+            shard->threadId = static_cast<int>(::syscall(SYS_gettid));
+            slot.store(shard, std::memory_order_release);
+            return shard;
+        }
+        ROS_WARN_STREAM("[" << mName << "] More than " << MAX_THREADS << " threads, some are not profiled");
+        return nullptr;
+    }
+
+    [[nodiscard]] EventId literalId(Shard& shard, char const* name) {
+        for (size_t i = 0; i < shard.literalCount; ++i) {
+            if (shard.literals[i].first == name) return shard.literals[i].second;
+        }
+        EventId id = intern(name);
+        if (shard.literalCount < shard.literals.size()) shard.literals[shard.literalCount++] = {name, id};
+        return id;
+    }
+
+    static void record(Shard& shard, EventId id, Clock::duration duration) {
+        if (id >= MAX_EVENTS) return;
+
+        auto ns = static_cast<uint64_t>(std::max(std::chrono::duration_cast<std::chrono::nanoseconds>(duration).count(), int64_t{0}));
+        Histogram& histogram = shard.histograms[id];
+        std::atomic<uint32_t>& bucket = histogram.buckets[bucketOf(ns)];
+        bucket.store(bucket.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        histogram.totalNs.store(histogram.totalNs.load(std::memory_order_relaxed) + ns, std::memory_order_relaxed);
+        // Racing a report at worst counts this maximum toward the next window
+        if (ns > histogram.maxNs.load(std::memory_order_relaxed)) histogram.maxNs.store(ns, std::memory_order_relaxed);
+    }
+
+    void keepSpan(Shard& shard, EventId id, Clock::time_point begin, Clock::time_point end) {
+        if (!mIsTracing.load(std::memory_order_relaxed) || id >= MAX_EVENTS) return;
+
+        TraceRing* ring = shard.trace.load(std::memory_order_relaxed);
+        if (!ring) {
+            ring = new TraceRing{};
+            shard.trace.store(ring, std::memory_order_release);
+        }
+        uint64_t written = ring->written.load(std::memory_order_relaxed);
+        // A dump that reads any of the stores below is sure to see the count from before them, and drop the overwritten span
+        std::atomic_thread_fence(std::memory_order_release);
+        TraceSpan& span = ring->spans[written % TRACE_CAPACITY];
+        span.beginNs.store(std::chrono::duration_cast<std::chrono::nanoseconds>(begin.time_since_epoch()).count(), std::memory_order_relaxed);
+        span.endNs.store(std::chrono::duration_cast<std::chrono::nanoseconds>(end.time_since_epoch()).count(), std::memory_order_relaxed);
+        span.sequence.store(shard.sequence, std::memory_order_relaxed);
+        span.event.store(id, std::memory_order_relaxed);
+        ring->written.store(written + 1, std::memory_order_release);
+    }
+
+    void measure(Shard& shard, EventId id, Clock::time_point now) {
+        if (shard.lastEvent) {
+            record(shard, id, now - shard.lastEvent.value());
+            keepSpan(shard, id, shard.lastEvent.value(), now);
+        }
+        shard.lastEvent = now;
+    }
 
 public:
-    LoopProfiler(std::string_view name, size_t printTick = 120) : mName{name}, mPrintTick{printTick} {}
+    explicit LoopProfiler(std::string_view name) : mName{name} {
+        intern("Loop");
+        std::scoped_lock lock{instancesMutex()};
+        instances().push_back(this);
+    }
+
+    LoopProfiler(LoopProfiler const&) = delete;
+    LoopProfiler& operator=(LoopProfiler const&) = delete;
+
+    ~LoopProfiler() {
+        {
+            std::scoped_lock lock{instancesMutex()};
+            instances().erase(std::find(instances().begin(), instances().end(), this));
+        }
+        for (std::atomic<Shard*>& slot: mShards) delete slot.load();
+    }
+
+    [[nodiscard]] std::string const& name() const { return mName; }
+
+    /**
+     * @brief Starts or stops keeping spans. Costs a relaxed load per event while off.
+     */
+    void setTracing(bool isTracing) { mIsTracing.store(isTracing, std::memory_order_relaxed); }
+
+    [[nodiscard]] bool isTracing() const { return mIsTracing.load(std::memory_order_relaxed); }
+
+    /**
+     * @brief Calls @p function with every profiler alive in this process, none are destroyed until it returns.
+     *
+     * Nodelets in one manager are one process, so a trace of them all shows how their threads interleave.
+     */
+    template<typename F>
+    static void withInstances(F&& function) {
+        std::scoped_lock lock{instancesMutex()};
+        function(std::as_const(instances()));
+    }
+
+    /**
+     * @brief Gets the id of an event, adding it the first time. Takes a lock, get ids up front when names are not literals.
+     *
+     * @return Id of the event, or #NO_EVENT if there are already #MAX_EVENTS
+     */
+    EventId intern(std::string_view name) {
+        std::scoped_lock lock{mMutex};
+        uint32_t count = mEventCount.load(std::memory_order_relaxed);
+        for (EventId id = 0; id < count; ++id) {
+            if (mEventNames[id] == name) return id;
+        }
+        if (count == MAX_EVENTS) {
+            ROS_WARN_STREAM("[" << mName << "] More than " << MAX_EVENTS << " events, \"" << name << "\" is not profiled");
+            return NO_EVENT;
+        }
+        mEventNames[count] = name;
+        // Reporting reads the names below the count, this publishes the new one to it
+        mEventCount.store(count + 1, std::memory_order_release);
+        return count;
+    }
 
     /**
      * @brief Call this at the beginning of each loop iteration.
+     *
+     * Records how long the previous iteration on this thread took as the "Loop" event.
+     *
+     * @param sequence  Identifies what this iteration works on in a trace, like the sequence number of a message header
+     */
+    void beginLoop(uint64_t sequence = NO_SEQUENCE) {
+        Clock::time_point now = Clock::now();
+        Shard* shard = localShard();
+        if (!shard) return;
+
+        if (shard->loopBegin) {
+            record(*shard, LOOP_EVENT, now - shard->loopBegin.value());
+            keepSpan(*shard, LOOP_EVENT, shard->loopBegin.value(), now);
+        }
+        shard->loopBegin = now;
+        shard->sequence = sequence;
+    }
+
+    /**
+     * @brief Call this at the end of each event in the loop.
+     *
+     * Records the time since the previous event on this thread as @p name, and starts timing the next one.
+     *
+     * @param name  A string literal, or any string that outlives the profiler, it is looked up by its address
      */
-    void beginLoop() {
-        // if (mTick % mPrintTick == 0) {
-        //     Clock::duration averageLoopDuration{};
-        //     for (auto& [_, durations]: mEventReadings) {
-        //         averageLoopDuration += std::accumulate(durations.begin(), durations.end(), Clock::duration{}) / durations.size();
-        //     }
-        //     // Print update time for the entire loop
-        //     size_t threadId = std::hash<std::thread::id>{}(std::this_thread::get_id());
-        //     auto averageLoopMs = std::chrono::duration_cast<DisplayUnits>(averageLoopDuration);
-        //     int hz = averageLoopMs.count() ? DisplayUnits::period::den / averageLoopMs.count() : -1;
-        //     ROS_INFO_STREAM("[" << mName << "] [" << threadId << "] Total: "
-        //                         << averageLoopMs.count() << "ms"
-        //                         << " (" << hz << " Hz)");
-        //     // Print update times for each loop event
-        //     for (auto& [name, durations]: mEventReadings) {
-        //         Clock::duration averageEventDuration = std::accumulate(durations.begin(), durations.end(), Clock::duration{}) / durations.size();
-        //         auto averageEventMs = std::chrono::duration_cast<DisplayUnits>(averageEventDuration);
-        //         ROS_INFO_STREAM("\t" << name << ": " << averageEventMs.count() << "ms");
-        //         durations.clear();
-        //     }
-        // }
-
-        // mTick++;
+    void measureEvent(char const* name) {
+        Clock::time_point now = Clock::now();
+        Shard* shard = localShard();
+        if (!shard) return;
+
+        measure(*shard, literalId(*shard, name), now);
     }
 
     /**
-     * @brief Call this at the beginning of each event in the loop.
+     * @copydoc measureEvent(char const*)
+     */
+    void measureEvent(EventId id) {
+        Clock::time_point now = Clock::now();
+        Shard* shard = localShard();
+        if (!shard) return;
+
+        measure(*shard, id, now);
+    }
+
+    /**
+     * @brief Records a duration measured elsewhere, without affecting the timing of the loop events. It is not traced.
+     */
+    void recordEvent(EventId id, Clock::duration duration) {
+        if (Shard* shard = localShard()) record(*shard, id, duration);
+    }
+
+    /**
+     * @return Names of the events seen so far, indexed by id
+     */
+    [[nodiscard]] std::vector<std::string> eventNames() const {
+        // Names below the count never change
+        return {mEventNames.begin(), mEventNames.begin() + mEventCount.load(std::memory_order_acquire)};
+    }
+
+    /**
+     * @brief Copies the spans still in the trace rings of every thread. Safe to call from any thread, recording is never held up.
      *
-     * This signals the end of the previous event and starts a new one.
+     * @return Spans of each thread from oldest to newest, threads one after another
+     */
+    [[nodiscard]] std::vector<LoopProfilerSpan> traceSpans() const {
+        std::vector<LoopProfilerSpan> spans;
+        for (std::atomic<Shard*> const& slot: mShards) {
+            Shard* shard = slot.load(std::memory_order_acquire);
+            if (!shard) break;
+            TraceRing* ring = shard->trace.load(std::memory_order_acquire);
+            if (!ring) continue;
+
+            uint64_t written = ring->written.load(std::memory_order_acquire);
+            // The slot after the newest span may be getting written already
+            uint64_t first = written >= TRACE_CAPACITY ? written - TRACE_CAPACITY + 1 : 0;
+            size_t begin = spans.size();
+            for (uint64_t i = first; i < written; ++i) {
+                TraceSpan const& span = ring->spans[i % TRACE_CAPACITY];
+                spans.push_back({span.event.load(std::memory_order_relaxed), shard->threadId, span.sequence.load(std::memory_order_relaxed),
+                                 span.beginNs.load(std::memory_order_relaxed), span.endNs.load(std::memory_order_relaxed)});
+            }
+            // The owner kept recording while these were copied, drop the ones it may have overwritten
+            std::atomic_thread_fence(std::memory_order_acquire);
+            uint64_t overwritten = ring->written.load(std::memory_order_relaxed) + 1;
+            if (overwritten > first + TRACE_CAPACITY) {
+                auto torn = static_cast<size_t>(std::min(overwritten - TRACE_CAPACITY - first, written - first));
+                spans.erase(spans.begin() + static_cast<std::ptrdiff_t>(begin), spans.begin() + static_cast<std::ptrdiff_t>(begin + torn));
+            }
+        }
+        return spans;
+    }
+
+    /**
+     * @brief Collects the events recorded on every thread since the last report. Safe to call from any thread.
      *
-     * @param name
+     * @return Stats of every event seen so far, in the order they were first seen, the loop first
      */
-    void measureEvent(std::string const& name) {
-        // Clock::time_point now = Clock::now();
-        // if (mLastEpochTime) {
-        //     Clock::duration duration = now - mLastEpochTime.value();
-        //     mEventReadings[name].push_back(duration);
-        // }
-        // mLastEpochTime = now;
-    }
-};
\ No newline at end of file
+    [[nodiscard]] std::vector<LoopProfilerEventStats> report() {
+        std::scoped_lock lock{mReportMutex};
+        uint32_t eventCount = mEventCount.load(std::memory_order_acquire);
+        std::vector<LoopProfilerEventStats> stats(eventCount);
+        std::array<uint64_t, BUCKET_COUNT> window{};
+        for (EventId id = 0; id < eventCount; ++id) {
+            window.fill(0);
+            uint64_t count = 0, totalNs = 0, maxNs = 0;
+            for (std::atomic<Shard*>& slot: mShards) {
+                Shard* shard = slot.load(std::memory_order_acquire);
+                if (!shard) break;
+
+                Histogram& histogram = shard->histograms[id];
+                for (size_t bucket = 0; bucket < BUCKET_COUNT; ++bucket) {
+                    uint32_t current = histogram.buckets[bucket].load(std::memory_order_relaxed);
+                    // Unsigned subtraction is still right once a bucket wraps around
+                    uint32_t added = current - shard->reportedBuckets[id][bucket];
+                    shard->reportedBuckets[id][bucket] = current;
+                    window[bucket] += added;
+                    count += added;
+                }
+                uint64_t currentTotalNs = histogram.totalNs.load(std::memory_order_relaxed);
+                totalNs += currentTotalNs - shard->reportedTotalNs[id];
+                shard->reportedTotalNs[id] = currentTotalNs;
+                maxNs = std::max(maxNs, histogram.maxNs.exchange(0, std::memory_order_relaxed));
+            }
+
+            LoopProfilerEventStats& event = stats[id];
+            event.name = mEventNames[id];
+            event.count = count;
+            if (!count) continue;
+
+            auto toMs = [](double ns) { return ns / 1e6; };
+            auto percentile = [&](double p) {
+                auto rank = std::max(static_cast<uint64_t>(std::ceil(p * static_cast<double>(count))), uint64_t{1});
+                uint64_t seen = 0;
+                size_t bucket = 0;
+                for (; bucket < BUCKET_COUNT - 1; ++bucket) {
+                    seen += window[bucket];
+                    if (seen >= rank) break;
+                }
+                // Middle of the bucket, but never more than the largest sample
+                double middle = (static_cast<double>(bucketLowerNs(bucket)) + static_cast<double>(bucketLowerNs(bucket + 1))) / 2;
+                return toMs(maxNs ? std::min(middle, static_cast<double>(maxNs)) : middle);
+            };
+            event.meanMs = toMs(static_cast<double>(totalNs) / static_cast<double>(count));
+            event.p50Ms = percentile(0.50);
+            event.p95Ms = percentile(0.95);
+            event.p99Ms = percentile(0.99);
+            event.maxMs = toMs(static_cast<double>(maxNs));
+        }
+        return stats;
+    }
+};
@@ -0,0 +1,147 @@
+#pragma once
+
+// Be careful what you include in this file, it is compiled with nvcc (NVIDIA CUDA compiler) as C++17
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <fstream>
+#include <iomanip>
+#include <iterator>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include <ros/file_log.h>
+#include <ros/node_handle.h>
+
+#include <mrover/DumpLoopTrace.h>
+#include <mrover/LoopProfile.h>
+
+#include "loop_profiler.hpp"
+#include "loop_profiler_trace.hpp"
+
+/**
+ * @brief Periodically publishes the stats of a set of profilers to "loop_profiles" and optionally logs them.
+ *
+ * Runs on its own thread so the profiled loops never wait on it. Each report covers the time since the previous one.
+ * With tracing on, the "dump_loop_trace" service in the private namespace writes a Chrome trace of every traced profiler in the process.
+ * Has to be destroyed before the profilers it reports on, declare it after them.
+ */
+class LoopProfilerReporter {
+private:
+    std::vector<LoopProfiler*> mProfilers;
+    ros::Publisher mPublisher;
+    ros::ServiceServer mDumpTraceService;
+    std::chrono::duration<double> mPeriod;
+    bool mLog;
+
+    std::mutex mMutex;
+    std::condition_variable mStopCondition;
+    bool mStop = false;
+    std::thread mThread;
+
+    static void logReport(LoopProfiler const& profiler, std::vector<LoopProfilerEventStats> const& events) {
+        std::ostringstream stream;
+        stream << std::fixed << std::setprecision(2) << "[" << profiler.name() << "]";
+        for (LoopProfilerEventStats const& event: events) {
+            if (!event.count) continue;
+
+            stream << "\n\t" << event.name << ": p50 " << event.p50Ms << " p95 " << event.p95Ms << " p99 " << event.p99Ms
+                   << " max " << event.maxMs << " ms (" << event.count << ")";
+        }
+        ROS_INFO_STREAM(stream.str());
+    }
+
+    void report() {
+        bool hasSubscribers = mPublisher.getNumSubscribers() > 0;
+        ros::Time now = ros::Time::now();
+        for (LoopProfiler* profiler: mProfilers) {
+            // Always collected so every report only covers its own period
+            std::vector<LoopProfilerEventStats> events = profiler->report();
+            if (mLog) logReport(*profiler, events);
+            if (!hasSubscribers) continue;
+
+            mrover::LoopProfile msg;
+            msg.header.stamp = now;
+            msg.name = profiler->name();
+            msg.events.reserve(events.size());
+            for (LoopProfilerEventStats const& event: events) {
+                mrover::LoopProfileEvent& eventMsg = msg.events.emplace_back();
+                eventMsg.name = event.name;
+                eventMsg.count = event.count;
+                eventMsg.mean_ms = event.meanMs;
+                eventMsg.p50_ms = event.p50Ms;
+                eventMsg.p95_ms = event.p95Ms;
+                eventMsg.p99_ms = event.p99Ms;
+                eventMsg.max_ms = event.maxMs;
+            }
+            mPublisher.publish(msg);
+        }
+    }
+
+    bool dumpTrace(mrover::DumpLoopTrace::Request& request, mrover::DumpLoopTrace::Response& response) {
+        response.path = request.path;
+        if (response.path.empty()) {
+            response.path = ros::file_log::getLogDirectory() + "/loop_trace_" + std::to_string(ros::WallTime::now().toNSec()) + ".json";
+        }
+        std::ofstream file{response.path};
+        if (!file) {
+            response.message = "Could not open " + response.path;
+            return true;
+        }
+
+        size_t traced = 0;
+        LoopProfiler::withInstances([&](std::vector<LoopProfiler*> const& instances) {
+            std::vector<LoopProfiler const*> profilers;
+            std::copy_if(instances.begin(), instances.end(), std::back_inserter(profilers), [](LoopProfiler const* profiler) { return profiler->isTracing(); });
+            traced = profilers.size();
+            writeChromeTrace(file, profilers);
+        });
+        file.close();
+        response.success = static_cast<bool>(file);
+        response.message = response.success ? "Wrote " + std::to_string(traced) + " traced profilers" : "Could not write " + response.path;
+        ROS_INFO_STREAM(response.message << " to " << response.path);
+        return true;
+    }
+
+public:
+    /**
+     * @param nh        Where the stats are published
+     * @param pnh       Private namespace of the node, where the trace service is advertised
+     * @param profilers Profilers to report on, they have to outlive the reporter
+     * @param period    Seconds between reports
+     * @param log       Also log each report
+     * @param trace     Keep spans of the profiled events for the trace service
+     */
+    LoopProfilerReporter(ros::NodeHandle& nh, ros::NodeHandle& pnh, std::vector<LoopProfiler*> profilers, double period = 1.0, bool log = false, bool trace = false)
+        : mProfilers{std::move(profilers)}, mPublisher{nh.advertise<mrover::LoopProfile>("loop_profiles", 10)}, mPeriod{period}, mLog{log} {
+        if (trace) {
+            for (LoopProfiler* profiler: mProfilers) profiler->setTracing(true);
+            mDumpTraceService = pnh.advertiseService("dump_loop_trace", &LoopProfilerReporter::dumpTrace, this);
+        }
+        mThread = std::thread{[this] {
+            std::unique_lock lock{mMutex};
+            while (!mStopCondition.wait_for(lock, mPeriod, [this] { return mStop; })) {
+                lock.unlock();
+                report();
+                lock.lock();
+            }
+        }};
+    }
+
+    LoopProfilerReporter(LoopProfilerReporter const&) = delete;
+    LoopProfilerReporter& operator=(LoopProfilerReporter const&) = delete;
+
+    ~LoopProfilerReporter() {
+        {
+            std::scoped_lock lock{mMutex};
+            mStop = true;
+        }
+        mStopCondition.notify_all();
+        mThread.join();
+    }
+};
@@ -0,0 +1,115 @@
+#pragma once
+
+// Be careful what you include in this file, it is compiled with nvcc (NVIDIA CUDA compiler) as C++17
+
+#include <algorithm>
+#include <cstdio>
+#include <map>
+#include <ostream>
+#include <set>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <unistd.h>
+
+#include "loop_profiler.hpp"
+
+namespace loop_profiler_trace {
+
+    inline void writeJsonString(std::ostream& out, std::string_view string) {
+        out << '"';
+        for (char c: string) {
+            if (c == '"' || c == '\\') {
+                out << '\\' << c;
+            } else if (static_cast<unsigned char>(c) < 0x20) {
+                char escaped[7];
+                std::snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+                out << escaped;
+            } else {
+                out << c;
+            }
+        }
+        out << '"';
+    }
+
+    inline void writeMicroseconds(std::ostream& out, int64_t ns) {
+        // Fixed point, a double would round away the nanoseconds of a monotonic time that is days long
+        char buffer[32];
+        std::snprintf(buffer, sizeof(buffer), "%lld.%03lld", static_cast<long long>(ns / 1000), static_cast<long long>(ns % 1000));
+        out << buffer;
+    }
+
+} // namespace loop_profiler_trace
+
+/**
+ * @brief Writes the spans the profilers are keeping as a Chrome trace, which chrome://tracing and ui.perfetto.dev open.
+ *
+ * Events are slices on the thread that recorded them, named after the event and with the profiler as their category.
+ * Loop iterations overlap the events around them, so each thread gets them as async slices on a track of their own.
+ * Times are on the monotonic clock, traces written by other processes on the same machine line up with this one.
+ */
+inline void writeChromeTrace(std::ostream& out, std::vector<LoopProfiler const*> const& profilers) {
+    using namespace loop_profiler_trace;
+
+    int pid = ::getpid();
+    bool isFirst = true;
+    auto beginEvent = [&] {
+        out << (isFirst ? "\n" : ",\n");
+        isFirst = false;
+    };
+
+    out << R"({"displayTimeUnit":"ms","traceEvents":[)";
+    std::map<int, std::set<std::string>> threadProfilers;
+    for (LoopProfiler const* profiler: profilers) {
+        // Events are named before any span refers to them, so names copied after the spans cover every span
+        std::vector<LoopProfilerSpan> spans = profiler->traceSpans();
+        std::vector<std::string> names = profiler->eventNames();
+        std::sort(spans.begin(), spans.end(), [](LoopProfilerSpan const& a, LoopProfilerSpan const& b) { return a.beginNs < b.beginNs; });
+        for (LoopProfilerSpan const& span: spans) {
+            threadProfilers[span.threadId].insert(profiler->name());
+
+            auto writeCommon = [&](char const* phase) {
+                beginEvent();
+                out << R"({"name":)";
+                writeJsonString(out, names[span.event]);
+                out << R"(,"cat":)";
+                writeJsonString(out, profiler->name());
+                out << R"(,"ph":")" << phase << R"(","pid":)" << pid << R"(,"tid":)" << span.threadId;
+            };
+            auto writeArgs = [&] {
+                if (span.sequence != LoopProfiler::NO_SEQUENCE) out << R"(,"args":{"sequence":)" << span.sequence << '}';
+            };
+
+            if (span.event == LoopProfiler::LOOP_EVENT) {
+                // Async slices with the same category, name and id are drawn on one track
+                for (auto [phase, ns]: {std::pair{"b", span.beginNs}, std::pair{"e", span.endNs}}) {
+                    writeCommon(phase);
+                    out << R"(,"id":)" << span.threadId << R"(,"ts":)";
+                    writeMicroseconds(out, ns);
+                    writeArgs();
+                    out << '}';
+                }
+            } else {
+                writeCommon("X");
+                out << R"(,"ts":)";
+                writeMicroseconds(out, span.beginNs);
+                out << R"(,"dur":)";
+                writeMicroseconds(out, std::max(span.endNs - span.beginNs, int64_t{0}));
+                writeArgs();
+                out << '}';
+            }
+        }
+    }
+
+    // Threads are named after the profilers that recorded on them, a pool thread can run several
+    for (auto const& [threadId, names]: threadProfilers) {
+        std::string threadName;
+        for (std::string const& name: names) threadName += (threadName.empty() ? "" : ", ") + name;
+        beginEvent();
+        out << R"({"name":"thread_name","ph":"M","pid":)" << pid << R"(,"tid":)" << threadId << R"(,"args":{"name":)";
+        writeJsonString(out, threadName);
+        out << "}}";
+    }
+    out << "\n]}\n";
+}
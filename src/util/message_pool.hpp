@@ -0,0 +1,97 @@
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include <boost/shared_ptr.hpp>
+
+struct MessagePoolStats {
+    size_t hits = 0;        // Acquires that reused a returned message
+    size_t misses = 0;      // Acquires that had to allocate a new message
+    size_t outstanding = 0; // Messages handed out that someone still holds
+    size_t idle = 0;        // Messages returned and waiting to be reused
+};
+
+/**
+ * @brief Recycles large messages (point clouds, images) instead of allocating new ones every frame.
+ *
+ * Messages are handed out as boost::shared_ptr, which is what publishing to subscribers in the same process shares.
+ * Once the last holder drops its pointer, be it us or a subscriber, the message goes back to the pool.
+ * A reused message keeps whatever it held before, including the capacity of its vectors,
+ * so filling it again with the same size of data does not allocate. Callers must set every field they publish.
+ *
+ * Thread safe, messages can be acquired and released from any thread. Released messages outliving the pool are simply freed.
+ *
+ * @tparam MessageT ROS message type
+ */
+template<typename MessageT>
+class MessagePool {
+private:
+    struct State {
+        std::mutex mutex;
+        std::vector<std::unique_ptr<MessageT>> idle;
+        size_t maxIdle;
+        MessagePoolStats stats;
+    };
+
+    // Every handed out message holds on to this, so releasing after the pool is destroyed is safe
+    std::shared_ptr<State> mState;
+
+    struct Recycler {
+        std::shared_ptr<State> state;
+
+        void operator()(MessageT* message) const {
+            // Declared before the lock so a message that does not fit is freed after unlocking
+            std::unique_ptr<MessageT> owned{message};
+            std::scoped_lock lock{state->mutex};
+            --state->stats.outstanding;
+            if (state->idle.size() < state->maxIdle) state->idle.push_back(std::move(owned));
+        }
+    };
+
+public:
+    /**
+     * @param maxIdle   Most returned messages kept around, more than this are freed.
+     *                  Should cover how many a publisher has in flight at once, usually a couple.
+     */
+    explicit MessagePool(size_t maxIdle = 4) : mState{std::make_shared<State>()} {
+        mState->maxIdle = maxIdle;
+        mState->idle.reserve(maxIdle);
+    }
+
+    MessagePool(MessagePool const&) = delete;
+    MessagePool& operator=(MessagePool const&) = delete;
+
+    /**
+     * @return A message no one else holds, either recycled or newly allocated
+     */
+    [[nodiscard]] boost::shared_ptr<MessageT> acquire() {
+        std::unique_ptr<MessageT> message;
+        {
+            std::scoped_lock lock{mState->mutex};
+            if (!mState->idle.empty()) {
+                message = std::move(mState->idle.back());
+                mState->idle.pop_back();
+                ++mState->stats.hits;
+                ++mState->stats.outstanding;
+            }
+        }
+        if (!message) {
+            // Only counted once allocated, a throwing allocation leaves the stats alone
+            message = std::make_unique<MessageT>();
+            std::scoped_lock lock{mState->mutex};
+            ++mState->stats.misses;
+            ++mState->stats.outstanding;
+        }
+        return boost::shared_ptr<MessageT>{message.release(), Recycler{mState}};
+    }
+
+    [[nodiscard]] MessagePoolStats stats() const {
+        std::scoped_lock lock{mState->mutex};
+        MessagePoolStats stats = mState->stats;
+        stats.idle = mState->idle.size();
+        return stats;
+    }
+};
@@ -0,0 +1,123 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * @brief Lock-free handoff of the latest value from one producer thread to one consumer thread.
+ *
+ * There are three buffers: the producer writes into the back one, the consumer reads the front one,
+ * and the middle one holds the newest complete value. Publishing and consuming swap a buffer with the middle one,
+ * so neither side ever waits on the other and the consumer always gets the newest value published.
+ * Values the consumer did not get to in time are overwritten, as if it had dropped them.
+ *
+ * Buffers are reused rather than reconstructed, so a value holding memory (e.g. a GPU matrix) only allocates once per buffer.
+ *
+ * @tparam T Value type, default constructed three times up front
+ */
+template<typename T>
+class TripleBuffer {
+private:
+    static constexpr uint8_t INDEX_MASK = 0b0011;
+    static constexpr uint8_t FRESH_BIT = 0b0100;  // Middle buffer was published and not yet consumed
+    static constexpr uint8_t CLOSED_BIT = 0b1000; // Producer will not publish anymore
+    // Keep the indices each side owns on separate cache lines from the shared state
+    static constexpr size_t CACHE_LINE_SIZE = 64;
+
+    std::array<T, 3> mBuffers{};
+    alignas(CACHE_LINE_SIZE) std::atomic<uint8_t> mMiddle{1};
+    alignas(CACHE_LINE_SIZE) uint8_t mBack = 0;  // Only touched by the producer
+    alignas(CACHE_LINE_SIZE) uint8_t mFront = 2; // Only touched by the consumer
+
+public:
+    /**
+     * @brief Buffer the producer fills before calling #publish. It may hold an old value.
+     */
+    [[nodiscard]] T& back() { return mBuffers[mBack]; }
+
+    /**
+     * @brief Makes the back buffer the newest value, replacing one the consumer has not taken yet. Never waits.
+     *
+     * @return Whether a value the consumer never took was replaced, i.e. dropped
+     */
+    bool publish() {
+        uint8_t previous = mMiddle.exchange(mBack | FRESH_BIT, std::memory_order_acq_rel);
+        mBack = previous & INDEX_MASK;
+#ifdef __cpp_lib_atomic_wait
+        mMiddle.notify_one();
+#endif
+        return previous & FRESH_BIT;
+    }
+
+    /**
+     * @brief Tells the consumer no more values are coming, wakes it if it is waiting. Only the producer may call this, after its last #publish.
+     */
+    void close() {
+        mMiddle.fetch_or(CLOSED_BIT, std::memory_order_acq_rel);
+#ifdef __cpp_lib_atomic_wait
+        mMiddle.notify_one();
+#endif
+    }
+
+    /**
+     * @brief Moves the newest value into the front buffer if there is one the consumer has not seen. Never waits.
+     *
+     * @return Whether the front buffer changed
+     */
+    bool consume() {
+        uint8_t middle = mMiddle.load(std::memory_order_relaxed);
+        do {
+            if (!(middle & FRESH_BIT)) return false;
+            // The closed bit has to survive the swap, it could have been set since the load
+        } while (!mMiddle.compare_exchange_weak(middle, mFront | (middle & CLOSED_BIT), std::memory_order_acq_rel, std::memory_order_relaxed));
+        mFront = middle & INDEX_MASK;
+#ifdef __cpp_lib_atomic_wait
+        // Only a producer in #waitUntilConsumed can be waiting here, the consumer is the one calling
+        mMiddle.notify_one();
+#endif
+        return true;
+    }
+
+#ifdef __cpp_lib_atomic_wait
+    /**
+     * @brief Blocks until there is a value the consumer has not seen and moves it into the front buffer.
+     *
+     * @return False once the producer closed and every value was consumed
+     */
+    bool waitAndConsume() {
+        uint8_t middle = mMiddle.load(std::memory_order_acquire);
+        while (!(middle & FRESH_BIT)) {
+            if (middle & CLOSED_BIT) return false;
+
+            mMiddle.wait(middle, std::memory_order_acquire);
+            middle = mMiddle.load(std::memory_order_acquire);
+        }
+        return consume();
+    }
+#endif
+
+#ifdef __cpp_lib_atomic_wait
+    /**
+     * @brief Blocks the producer until the consumer took the last published value.
+     *
+     * For producers that can make values on demand, so they do not make ones the consumer would never see.
+     * Only the producer may call this.
+     */
+    void waitUntilConsumed() {
+        uint8_t middle = mMiddle.load(std::memory_order_acquire);
+        while (middle & FRESH_BIT) {
+            mMiddle.wait(middle, std::memory_order_acquire);
+            middle = mMiddle.load(std::memory_order_acquire);
+        }
+    }
+#endif
+
+    /**
+     * @brief Buffer holding the value the consumer last took, stable until the next #consume.
+     */
+    [[nodiscard]] T& front() { return mBuffers[mFront]; }
+
+    [[nodiscard]] bool isClosed() const { return mMiddle.load(std::memory_order_acquire) & CLOSED_BIT; }
+};
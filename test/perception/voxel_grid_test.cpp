@@ -0,0 +1,208 @@
+#include <gtest/gtest.h>
+
+#include <map>
+#include <random>
+#include <tuple>
+
+#include "voxel_grid.hpp"
+
+using namespace mrover;
+
+namespace {
+
+    struct Centroid {
+        double x{}, y{}, z{};
+        uint32_t b{}, g{}, r{}, a{}, count{};
+    };
+
+    /**
+     * @brief Groups points into voxels with a map, the obvious way.
+     */
+    template<typename PointT>
+    std::map<std::tuple<int64_t, int64_t, int64_t>, Centroid> referenceVoxels(PointCloudView<PointT const> const& view, VoxelGridParameters const& parameters) {
+        std::map<std::tuple<int64_t, int64_t, int64_t>, Centroid> voxels;
+        for (PointT const& point: view) {
+            auto [x, y, z] = getPosition(point);
+            float range = std::sqrt(x * x + y * y + z * z);
+            if (!(range >= parameters.minRange && range <= parameters.maxRange && z >= parameters.minHeight && z <= parameters.maxHeight)) continue;
+
+            auto index = [&](float value) { return static_cast<int64_t>(std::floor(value * (1.0 / parameters.leafSize))); };
+            Centroid& voxel = voxels[{index(x), index(y), index(z)}];
+            voxel.x += x;
+            voxel.y += y;
+            voxel.z += z;
+            voxel.b += point.b;
+            voxel.g += point.g;
+            voxel.r += point.r;
+            voxel.a += point.a;
+            ++voxel.count;
+        }
+        return voxels;
+    }
+
+    template<typename PointT>
+    sensor_msgs::PointCloud2 makeCloud(uint32_t width, uint32_t height, std::mt19937& generator) {
+        sensor_msgs::PointCloud2 msg;
+        msg.header.frame_id = "zed2i_left_camera_frame";
+        msg.width = width;
+        msg.height = height;
+        fillPointCloudMessageHeader<PointT>(msg);
+        std::uniform_real_distribution<float> position{-3, 3};
+        std::uniform_int_distribution<int> channel{0, 255};
+        size_t i = 0;
+        for (PointT& point: PointCloudView<PointT>{msg}) {
+            // Missing depth is NaN, every so often a point is missing
+            float x = i++ % 11 == 5 ? std::numeric_limits<float>::quiet_NaN() : position(generator);
+            setPosition(point, x, position(generator), position(generator));
+            point.b = static_cast<uint8_t>(channel(generator));
+            point.g = static_cast<uint8_t>(channel(generator));
+            point.r = static_cast<uint8_t>(channel(generator));
+            point.a = 255;
+        }
+        return msg;
+    }
+
+    template<typename PointT>
+    void expectMatchesReference(sensor_msgs::PointCloud2 const& input, VoxelGridParameters const& parameters) {
+        VoxelGrid voxelGrid{parameters};
+        sensor_msgs::PointCloud2 output;
+        size_t count = voxelGrid.filter(input, output);
+
+        auto reference = referenceVoxels(PointCloudView<PointT const>{input}, parameters);
+        std::vector<Centroid> expected;
+        for (auto const& [_, voxel]: reference) {
+            if (voxel.count >= parameters.minPointsPerVoxel) expected.push_back(voxel);
+        }
+
+        ASSERT_EQ(count, expected.size());
+        ASSERT_EQ(output.height, 1u);
+        ASSERT_EQ(output.width, count);
+        ASSERT_EQ(output.header.frame_id, input.header.frame_id);
+        ASSERT_TRUE(PointCloudView<Point const>::isCompatible(output));
+
+        // The reference orders voxels differently than the packed keys do, so compare them sorted by position
+        PointCloudView<Point const> points{output};
+        std::vector<Point> actual{points.begin(), points.end()};
+        auto byPosition = [](Point const& a, Point const& b) { return std::make_tuple(a.x, a.y, a.z) < std::make_tuple(b.x, b.y, b.z); };
+        std::vector<Point> expectedPoints;
+        for (Centroid const& voxel: expected) {
+            Point point{};
+            point.x = static_cast<float>(voxel.x / voxel.count);
+            point.y = static_cast<float>(voxel.y / voxel.count);
+            point.z = static_cast<float>(voxel.z / voxel.count);
+            point.b = static_cast<uint8_t>((voxel.b + voxel.count / 2) / voxel.count);
+            point.g = static_cast<uint8_t>((voxel.g + voxel.count / 2) / voxel.count);
+            point.r = static_cast<uint8_t>((voxel.r + voxel.count / 2) / voxel.count);
+            point.a = static_cast<uint8_t>((voxel.a + voxel.count / 2) / voxel.count);
+            expectedPoints.push_back(point);
+        }
+        std::sort(actual.begin(), actual.end(), byPosition);
+        std::sort(expectedPoints.begin(), expectedPoints.end(), byPosition);
+        for (size_t i = 0; i < expectedPoints.size(); ++i) {
+            // Sums are added up in a different order across threads
+            ASSERT_NEAR(actual[i].x, expectedPoints[i].x, 1e-5) << "point " << i;
+            ASSERT_NEAR(actual[i].y, expectedPoints[i].y, 1e-5) << "point " << i;
+            ASSERT_NEAR(actual[i].z, expectedPoints[i].z, 1e-5) << "point " << i;
+            ASSERT_EQ(actual[i].b, expectedPoints[i].b) << "point " << i;
+            ASSERT_EQ(actual[i].g, expectedPoints[i].g) << "point " << i;
+            ASSERT_EQ(actual[i].r, expectedPoints[i].r) << "point " << i;
+            ASSERT_EQ(actual[i].a, expectedPoints[i].a) << "point " << i;
+            ASSERT_EQ(actual[i].curvature, 0.0f);
+        }
+    }
+
+} // namespace
+
+TEST(VoxelGridTest, MatchesReferenceForEachLayout) {
+    std::mt19937 generator{42};
+    VoxelGridParameters parameters;
+    parameters.leafSize = 0.5f;
+    parameters.minRange = 0.5f;
+    parameters.maxRange = 4.0f;
+    parameters.minHeight = -2.0f;
+    parameters.maxHeight = 1.5f;
+    expectMatchesReference<Point>(makeCloud<Point>(320, 180, generator), parameters);
+    expectMatchesReference<PointXYZRGB>(makeCloud<PointXYZRGB>(320, 180, generator), parameters);
+    expectMatchesReference<PointXYZHalfRGB>(makeCloud<PointXYZHalfRGB>(320, 180, generator), parameters);
+}
+
+TEST(VoxelGridTest, ManyVoxelsGrowTheGrids) {
+    std::mt19937 generator{7};
+    VoxelGridParameters parameters;
+    // Tens of thousands of occupied voxels, far more than a grid starts with
+    parameters.leafSize = 0.05f;
+    expectMatchesReference<PointXYZRGB>(makeCloud<PointXYZRGB>(640, 360, generator), parameters);
+}
+
+TEST(VoxelGridTest, SparseVoxelsAreDropped) {
+    std::mt19937 generator{3};
+    VoxelGridParameters parameters;
+    parameters.leafSize = 0.2f;
+    parameters.minPointsPerVoxel = 4;
+    expectMatchesReference<PointXYZRGB>(makeCloud<PointXYZRGB>(200, 100, generator), parameters);
+}
+
+TEST(VoxelGridTest, PointsInOneVoxelAverage) {
+    sensor_msgs::PointCloud2 input;
+    input.width = 2;
+    input.height = 2;
+    fillPointCloudMessageHeader<PointXYZRGB>(input);
+    PointCloudView<PointXYZRGB> points{input};
+    setPosition(points[0], 1.01f, -0.09f, 0.01f);
+    setPosition(points[1], 1.03f, -0.01f, 0.09f);
+    setPosition(points[2], 1.05f, -0.05f, 0.05f);
+    // Straddles the boundary, negative coordinates have to round down
+    setPosition(points[3], 1.05f, 0.05f, 0.05f);
+    for (PointXYZRGB& point: points) point = {point.x, point.y, point.z, 10, 20, 30, 255};
+    points[1].b = 13;
+
+    VoxelGridParameters parameters;
+    VoxelGrid voxelGrid{parameters};
+    sensor_msgs::PointCloud2 output;
+    ASSERT_EQ(voxelGrid.filter(input, output), 2u);
+
+    PointCloudView<Point const> centroids{output};
+    Point const& negative = centroids[0].y < 0 ? centroids[0] : centroids[1];
+    EXPECT_NEAR(negative.x, 1.03f, 1e-6);
+    EXPECT_NEAR(negative.y, -0.05f, 1e-6);
+    EXPECT_NEAR(negative.z, 0.05f, 1e-6);
+    EXPECT_EQ(negative.b, 11);
+    EXPECT_EQ(negative.g, 20);
+    EXPECT_EQ(negative.r, 30);
+}
+
+TEST(VoxelGridTest, ReusedOutputIsOverwritten) {
+    std::mt19937 generator{11};
+    VoxelGridParameters parameters;
+    VoxelGrid voxelGrid{parameters};
+    sensor_msgs::PointCloud2 large = makeCloud<PointXYZRGB>(256, 256, generator), small = makeCloud<PointXYZRGB>(4, 4, generator);
+    sensor_msgs::PointCloud2 output, fresh;
+    voxelGrid.filter(large, output);
+    size_t count = voxelGrid.filter(small, output);
+    ASSERT_EQ(VoxelGrid{parameters}.filter(small, fresh), count);
+    ASSERT_EQ(output.data, fresh.data);
+}
+
+TEST(VoxelGridTest, RejectsBadInput) {
+    VoxelGridParameters parameters;
+    parameters.leafSize = 0;
+    EXPECT_THROW(VoxelGrid{parameters}, std::invalid_argument);
+    parameters = {};
+    parameters.minRange = parameters.maxRange;
+    EXPECT_THROW(VoxelGrid{parameters}, std::invalid_argument);
+    parameters = {};
+    parameters.leafSize = 1e-6f;
+    EXPECT_THROW(VoxelGrid{parameters}, std::invalid_argument);
+
+    sensor_msgs::PointCloud2 unknown, output;
+    unknown.width = unknown.height = 1;
+    unknown.point_step = 7;
+    unknown.row_step = 7;
+    unknown.data.resize(7);
+    EXPECT_THROW(VoxelGrid{VoxelGridParameters{}}.filter(unknown, output), std::invalid_argument);
+}
+
+int main(int argc, char** argv) {
+    testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
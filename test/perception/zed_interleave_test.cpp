@@ -0,0 +1,138 @@
+#include <gtest/gtest.h>
+
+#include <limits>
+#include <random>
+
+#include "zed_wrapper.hpp"
+
+using namespace mrover;
+
+namespace {
+
+    // Same layout and member names as sl::uchar4 and sl::float4
+    struct Uchar4 {
+        uint8_t r, g, b, a;
+    };
+    struct Float4 {
+        float x, y, z, w;
+    };
+
+    /**
+     * @brief Body of fillPointCloudMessageKernel in zed_wrapper.bridge.cu, run on the CPU. Keep the two in sync.
+     */
+    void referenceKernel(Float4 const* xyzGpuPtr, Uchar4 const* bgraGpuPtr, ZedPoint* pcGpuPtr, size_t size) {
+        for (size_t i = 0; i < size; ++i) {
+            setPosition(pcGpuPtr[i], xyzGpuPtr[i].x, xyzGpuPtr[i].y, xyzGpuPtr[i].z);
+            pcGpuPtr[i].b = bgraGpuPtr[i].r;
+            pcGpuPtr[i].g = bgraGpuPtr[i].g;
+            pcGpuPtr[i].r = bgraGpuPtr[i].b;
+            pcGpuPtr[i].a = bgraGpuPtr[i].a;
+        }
+    }
+
+    struct HostPlanes {
+        std::vector<uint8_t> xyz, bgra;
+        StereoFrame frame;
+    };
+
+    /**
+     * @brief Random planes, rows padded by @p padding bytes like a pitched allocation would be.
+     */
+    HostPlanes makePlanes(uint32_t width, uint32_t height, size_t padding, std::mt19937& generator) {
+        HostPlanes planes;
+        size_t xyzStep = width * sizeof(Float4) + padding, bgraStep = width * sizeof(Uchar4) + padding;
+        planes.xyz.resize(xyzStep * height);
+        planes.bgra.resize(bgraStep * height);
+        std::uniform_real_distribution<float> position{-20, 20};
+        std::uniform_int_distribution<int> byte{0, 255};
+        for (uint32_t v = 0; v < height; ++v) {
+            for (uint32_t u = 0; u < width; ++u) {
+                // Missing depth is NaN, it has to come through as is
+                float x = u % 7 == 3 ? std::numeric_limits<float>::quiet_NaN() : position(generator);
+                Float4 xyzw{x, position(generator), position(generator), position(generator)};
+                std::memcpy(planes.xyz.data() + v * xyzStep + u * sizeof(Float4), &xyzw, sizeof(xyzw));
+                for (size_t c = 0; c < sizeof(Uchar4); ++c) planes.bgra[v * bgraStep + u * sizeof(Uchar4) + c] = static_cast<uint8_t>(byte(generator));
+            }
+        }
+        planes.frame.memory = FrameMemory::Host;
+        planes.frame.width = width;
+        planes.frame.height = height;
+        planes.frame.leftXyz = {planes.xyz.data(), xyzStep};
+        planes.frame.leftBgra = {planes.bgra.data(), bgraStep};
+        return planes;
+    }
+
+    std::vector<uint8_t> runReference(HostPlanes const& planes) {
+        StereoFrame const& frame = planes.frame;
+        std::vector<ZedPoint> points(static_cast<size_t>(frame.width) * frame.height);
+        // The kernel sees dense planes, pack the rows first
+        for (uint32_t v = 0; v < frame.height; ++v) {
+            std::vector<Float4> xyz(frame.width);
+            std::vector<Uchar4> bgra(frame.width);
+            std::memcpy(xyz.data(), frame.leftXyz.data + v * frame.leftXyz.step, frame.width * sizeof(Float4));
+            std::memcpy(bgra.data(), frame.leftBgra.data + v * frame.leftBgra.step, frame.width * sizeof(Uchar4));
+            referenceKernel(xyz.data(), bgra.data(), points.data() + static_cast<size_t>(v) * frame.width, frame.width);
+        }
+        std::vector<uint8_t> bytes(points.size() * sizeof(ZedPoint));
+        std::memcpy(bytes.data(), points.data(), bytes.size());
+        return bytes;
+    }
+
+} // namespace
+
+TEST(ZedInterleaveTest, GoldenPointBytes) {
+    Float4 xyzw{1.0f, -2.0f, 0.5f, 123.0f};
+    std::array<uint8_t, 4> bgra{0x10, 0x20, 0x30, 0x40};
+    StereoFrame frame;
+    frame.width = frame.height = 1;
+    frame.leftXyz = {reinterpret_cast<uint8_t const*>(&xyzw), sizeof(xyzw)};
+    frame.leftBgra = {bgra.data(), bgra.size()};
+
+    auto msg = boost::make_shared<sensor_msgs::PointCloud2>();
+    fillPointCloudMessageFromHost(frame, msg);
+
+    // Little endian x, y, z floats, then the image bytes in image order, W is dropped
+    std::vector<uint8_t> expected{
+            0x00, 0x00, 0x80, 0x3F,
+            0x00, 0x00, 0x00, 0xC0,
+            0x00, 0x00, 0x00, 0x3F,
+            0x10, 0x20, 0x30, 0x40};
+    ASSERT_EQ(msg->point_step, 16u);
+    ASSERT_EQ(msg->data, expected);
+    ASSERT_TRUE(PointCloudView<ZedPoint const>::isCompatible(*msg));
+}
+
+TEST(ZedInterleaveTest, MatchesKernelForEveryTailLength) {
+    std::mt19937 generator{42};
+    // Widths around the vector width exercise the scalar tail
+    for (uint32_t width = 1; width <= 19; ++width) {
+        HostPlanes planes = makePlanes(width, 3, 0, generator);
+        auto msg = boost::make_shared<sensor_msgs::PointCloud2>();
+        fillPointCloudMessageFromHost(planes.frame, msg);
+        ASSERT_EQ(msg->data, runReference(planes)) << "width " << width;
+    }
+}
+
+TEST(ZedInterleaveTest, MatchesKernelWithPaddedRows) {
+    std::mt19937 generator{7};
+    HostPlanes planes = makePlanes(1283, 37, 20, generator);
+    auto msg = boost::make_shared<sensor_msgs::PointCloud2>();
+    fillPointCloudMessageFromHost(planes.frame, msg);
+    ASSERT_EQ(msg->width, 1283u);
+    ASSERT_EQ(msg->height, 37u);
+    ASSERT_EQ(msg->data, runReference(planes));
+}
+
+TEST(ZedInterleaveTest, ReusedMessageIsOverwritten) {
+    std::mt19937 generator{3};
+    HostPlanes large = makePlanes(64, 64, 0, generator), small = makePlanes(16, 8, 4, generator);
+    auto msg = boost::make_shared<sensor_msgs::PointCloud2>();
+    fillPointCloudMessageFromHost(large.frame, msg);
+    fillPointCloudMessageFromHost(small.frame, msg);
+    ASSERT_EQ(msg->data, runReference(small));
+}
+
+int main(int argc, char** argv) {
+    testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
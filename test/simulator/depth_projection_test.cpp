@@ -0,0 +1,206 @@
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <iterator>
+#include <random>
+
+#include <Eigen/Geometry>
+
+#include <depth_projection.hpp>
+
+using namespace mrover;
+
+namespace {
+
+    Eigen::Matrix3d const OPTICAL_TO_CAMERA = (Eigen::AngleAxisd{-M_PI_2, Eigen::Vector3d::UnitZ()} * Eigen::AngleAxisd{-M_PI_2, Eigen::Vector3d::UnitX()}).toRotationMatrix();
+
+    /**
+     * @brief The point the Kinect plugin computed per pixel before the ray tables, NaN when out of range.
+     */
+    Eigen::Vector3d projectPixel(uint32_t i, uint32_t j, uint32_t cols, uint32_t rows, double hfov, double depth, double near, double far) {
+        if (!(depth > near && depth < far)) return Eigen::Vector3d::Constant(std::numeric_limits<double>::quiet_NaN());
+
+        double fl = static_cast<double>(cols) / (2.0 * tan(hfov / 2.0));
+        double pAngle = rows > 1 ? atan2(static_cast<double>(j) - 0.5 * static_cast<double>(rows - 1), fl) : 0.0;
+        double yAngle = cols > 1 ? atan2(static_cast<double>(i) - 0.5 * static_cast<double>(cols - 1), fl) : 0.0;
+        return OPTICAL_TO_CAMERA * Eigen::Vector3d{depth * tan(yAngle), depth * tan(pAngle), depth};
+    }
+
+    uint32_t colorOf(PointXYZRGB const& point) {
+        uint32_t color;
+        std::memcpy(&color, &point.b, sizeof(color));
+        return color;
+    }
+
+} // namespace
+
+TEST(DepthProjectionTest, MatchesPerPixelProjection) {
+    constexpr double NEAR = 0.4, FAR = 5.0, HFOV = 1.047;
+    std::mt19937 generator{1};
+    std::uniform_real_distribution<float> depthDistribution{0, 6};
+    // Widths that are not a multiple of the vector width take the scalar tail
+    for (auto [cols, rows]: {std::pair{640u, 480u}, std::pair{37u, 5u}, std::pair{1u, 1u}, std::pair{3u, 1u}}) {
+        DepthProjection projection;
+        ASSERT_TRUE(projection.configure(cols, rows, HFOV, OPTICAL_TO_CAMERA));
+
+        size_t pixels = static_cast<size_t>(cols) * rows;
+        std::vector<float> depth(pixels);
+        for (float& value: depth) value = depthDistribution(generator);
+        depth[0] = std::numeric_limits<float>::quiet_NaN();
+        if (pixels > 1) depth[1] = std::numeric_limits<float>::infinity();
+        std::vector<uint8_t> rgb(pixels * 3);
+        for (size_t p = 0; p < rgb.size(); ++p) rgb[p] = static_cast<uint8_t>(p * 7);
+
+        std::vector<PointXYZRGB> points(pixels);
+        ASSERT_FALSE(projection.project(depth.data(), {DepthColors::Format::Rgb, rgb.data()}, NEAR, FAR, points.data()));
+        for (uint32_t j = 0; j < rows; ++j) {
+            for (uint32_t i = 0; i < cols; ++i) {
+                size_t p = static_cast<size_t>(j) * cols + i;
+                Eigen::Vector3d expected = projectPixel(i, j, cols, rows, HFOV, depth[p], NEAR, FAR);
+                PointXYZRGB const& point = points[p];
+                if (std::isnan(expected.x())) {
+                    ASSERT_TRUE(std::isnan(point.x) && std::isnan(point.y) && std::isnan(point.z)) << i << ", " << j;
+                } else {
+                    ASSERT_NEAR(point.x, expected.x(), 1e-5) << i << ", " << j;
+                    ASSERT_NEAR(point.y, expected.y(), 1e-5) << i << ", " << j;
+                    ASSERT_NEAR(point.z, expected.z(), 1e-5) << i << ", " << j;
+                }
+                ASSERT_EQ(point.r, rgb[p * 3 + 0]);
+                ASSERT_EQ(point.g, rgb[p * 3 + 1]);
+                ASSERT_EQ(point.b, rgb[p * 3 + 2]);
+                ASSERT_EQ(point.a, 255);
+            }
+        }
+    }
+}
+
+TEST(DepthProjectionTest, DenseOnlyWhenEveryDepthIsInRange) {
+    DepthProjection projection;
+    projection.configure(9, 2, 1.0, OPTICAL_TO_CAMERA);
+    std::vector<float> depth(18, 1.0f);
+    std::vector<PointXYZRGB> points(18);
+    ASSERT_TRUE(projection.project(depth.data(), {}, 0.4, 5.0, points.data()));
+    for (PointXYZRGB const& point: points) ASSERT_EQ(colorOf(point), 0xFF000000u);
+
+    // In the scalar tail
+    depth[17] = 5.0f;
+    ASSERT_FALSE(projection.project(depth.data(), {}, 0.4, 5.0, points.data()));
+    ASSERT_TRUE(std::isnan(points[17].x));
+}
+
+TEST(DepthProjectionTest, CutoffsCompareLikeDoubles) {
+    DepthProjection projection;
+    projection.configure(4, 1, 1.0, OPTICAL_TO_CAMERA);
+    // 0.4 and 5.1 are not floats, the nearest floats are just above 0.4 and just below 5.1
+    std::vector<float> depth{0.4f, 5.1f, std::nextafter(0.4f, 0.0f), std::nextafter(5.1f, 6.0f)};
+    ASSERT_GT(static_cast<double>(depth[0]), 0.4);
+    ASSERT_LT(static_cast<double>(depth[1]), 5.1);
+    std::vector<PointXYZRGB> points(4);
+    projection.project(depth.data(), {}, 0.4, 5.1, points.data());
+    ASSERT_FALSE(std::isnan(points[0].z));
+    ASSERT_FALSE(std::isnan(points[1].z));
+    ASSERT_TRUE(std::isnan(points[2].z));
+    ASSERT_TRUE(std::isnan(points[3].z));
+}
+
+TEST(DepthProjectionTest, MonoColors) {
+    DepthProjection projection;
+    projection.configure(5, 1, 1.0, OPTICAL_TO_CAMERA);
+    std::vector<float> depth(5, 1.0f);
+    std::vector<uint8_t> gray{0, 10, 20, 30, 40};
+    std::vector<PointXYZRGB> points(5);
+    projection.project(depth.data(), {DepthColors::Format::Mono, gray.data()}, 0.4, 5.0, points.data());
+    for (size_t i = 0; i < 5; ++i) {
+        ASSERT_EQ(points[i].r, gray[i]);
+        ASSERT_EQ(points[i].g, gray[i]);
+        ASSERT_EQ(points[i].b, gray[i]);
+    }
+}
+
+TEST(DepthProjectionTest, TablesAreOnlyRebuiltOnChange) {
+    DepthProjection projection;
+    ASSERT_TRUE(projection.configure(640, 480, 1.0, OPTICAL_TO_CAMERA));
+    ASSERT_FALSE(projection.configure(640, 480, 1.0, OPTICAL_TO_CAMERA));
+    ASSERT_TRUE(projection.configure(640, 480, 1.2, OPTICAL_TO_CAMERA));
+    ASSERT_TRUE(projection.configure(320, 240, 1.2, OPTICAL_TO_CAMERA));
+    ASSERT_EQ(projection.width(), 320u);
+    ASSERT_EQ(projection.height(), 240u);
+}
+
+TEST(DepthProjectionTest, StrideKeepsEveryNthPixel) {
+    constexpr double NEAR = 0.4, FAR = 5.0, HFOV = 1.047;
+    constexpr uint32_t COLS = 37, ROWS = 11, STRIDE = 3;
+    DepthProjection projection;
+    ASSERT_TRUE(projection.configure(COLS, ROWS, HFOV, OPTICAL_TO_CAMERA, STRIDE));
+    ASSERT_EQ(projection.width(), 13u);
+    ASSERT_EQ(projection.height(), 4u);
+    ASSERT_FALSE(projection.configure(COLS, ROWS, HFOV, OPTICAL_TO_CAMERA, STRIDE));
+    ASSERT_TRUE(projection.configure(COLS, ROWS, HFOV, OPTICAL_TO_CAMERA, 1));
+    ASSERT_TRUE(projection.configure(COLS, ROWS, HFOV, OPTICAL_TO_CAMERA, STRIDE));
+
+    std::mt19937 generator{2};
+    std::uniform_real_distribution<float> depthDistribution{0, 6};
+    std::vector<float> depth(COLS * ROWS);
+    for (float& value: depth) value = depthDistribution(generator);
+    std::vector<uint8_t> gray(COLS * ROWS);
+    for (size_t p = 0; p < gray.size(); ++p) gray[p] = static_cast<uint8_t>(p);
+
+    std::vector<PointXYZRGB> points(projection.width() * projection.height());
+    projection.project(depth.data(), {DepthColors::Format::Mono, gray.data()}, NEAR, FAR, points.data());
+    for (uint32_t j = 0; j < projection.height(); ++j) {
+        for (uint32_t i = 0; i < projection.width(); ++i) {
+            size_t p = static_cast<size_t>(j) * STRIDE * COLS + i * STRIDE;
+            Eigen::Vector3d expected = projectPixel(i * STRIDE, j * STRIDE, COLS, ROWS, HFOV, depth[p], NEAR, FAR);
+            PointXYZRGB const& point = points[j * projection.width() + i];
+            if (std::isnan(expected.x())) {
+                ASSERT_TRUE(std::isnan(point.x)) << i << ", " << j;
+            } else {
+                ASSERT_NEAR(point.x, expected.x(), 1e-5) << i << ", " << j;
+                ASSERT_NEAR(point.y, expected.y(), 1e-5) << i << ", " << j;
+                ASSERT_NEAR(point.z, expected.z(), 1e-5) << i << ", " << j;
+            }
+            ASSERT_EQ(point.r, gray[p]);
+        }
+    }
+}
+
+TEST(DepthProjectionTest, ValidPointsAreCompactedInOrder) {
+    constexpr double NEAR = 0.4, FAR = 5.0, HFOV = 1.047;
+    std::mt19937 generator{3};
+    std::uniform_real_distribution<float> depthDistribution{0, 10};
+    for (uint32_t stride: {1u, 2u}) {
+        DepthProjection projection;
+        projection.configure(640, 480, HFOV, OPTICAL_TO_CAMERA, stride);
+        std::vector<float> depth(640 * 480);
+        for (float& value: depth) value = depthDistribution(generator);
+        // A row with nothing in range, like the sky
+        std::fill(depth.begin(), depth.begin() + 640 * 4, std::numeric_limits<float>::infinity());
+        std::vector<uint8_t> rgb(depth.size() * 3);
+        for (size_t p = 0; p < rgb.size(); ++p) rgb[p] = static_cast<uint8_t>(p * 13);
+        DepthColors colors{DepthColors::Format::Rgb, rgb.data()};
+
+        size_t cells = static_cast<size_t>(projection.width()) * projection.height();
+        std::vector<PointXYZRGB> organized(cells), compacted(cells);
+        projection.project(depth.data(), colors, NEAR, FAR, organized.data());
+        size_t count = projection.projectValid(depth.data(), colors, NEAR, FAR, compacted.data());
+
+        std::vector<PointXYZRGB> expected;
+        std::copy_if(organized.begin(), organized.end(), std::back_inserter(expected), [](PointXYZRGB const& point) { return !std::isnan(point.x); });
+        ASSERT_EQ(count, expected.size());
+        ASSERT_GT(count, 0u);
+        ASSERT_LT(count, cells);
+        for (size_t p = 0; p < count; ++p) {
+            ASSERT_FLOAT_EQ(compacted[p].x, expected[p].x) << p;
+            ASSERT_FLOAT_EQ(compacted[p].y, expected[p].y) << p;
+            ASSERT_FLOAT_EQ(compacted[p].z, expected[p].z) << p;
+            ASSERT_EQ(colorOf(compacted[p]), colorOf(expected[p])) << p;
+        }
+    }
+}
+
+int main(int argc, char** argv) {
+    testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
@@ -0,0 +1,95 @@
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <cmath>
+
+#include <path_history.hpp>
+
+using namespace mrover;
+
+namespace {
+
+    geometry_msgs::PoseStamped poseAt(double x, double y, double yaw = 0) {
+        geometry_msgs::PoseStamped pose;
+        pose.header.frame_id = "map";
+        pose.pose.position.x = x;
+        pose.pose.position.y = y;
+        pose.pose.orientation.z = std::sin(yaw / 2);
+        pose.pose.orientation.w = std::cos(yaw / 2);
+        return pose;
+    }
+
+} // namespace
+
+TEST(PathHistoryTest, OnlyKeepsPosesThatMovedOrTurned) {
+    PathHistory history{16, 0.5, 0.2};
+    ASSERT_TRUE(history.add(poseAt(0, 0)));
+    // Standing still
+    ASSERT_FALSE(history.add(poseAt(0, 0)));
+    ASSERT_FALSE(history.add(poseAt(0.3, 0.3)));
+    ASSERT_TRUE(history.add(poseAt(0.4, 0.4)));
+    // Turning in place
+    ASSERT_FALSE(history.add(poseAt(0.4, 0.4, 0.1)));
+    ASSERT_TRUE(history.add(poseAt(0.4, 0.4, 0.25)));
+    // Distance is measured from the last kept pose, not the last added one
+    ASSERT_FALSE(history.add(poseAt(0.6, 0.4, 0.25)));
+    ASSERT_FALSE(history.add(poseAt(0.8, 0.4, 0.25)));
+    ASSERT_TRUE(history.add(poseAt(0.9, 0.4, 0.25)));
+    ASSERT_EQ(history.size(), 4u);
+    ASSERT_EQ(history.end(), 4u);
+}
+
+TEST(PathHistoryTest, ForgetsOldestPosesPastCapacity) {
+    PathHistory history{3, 0, 0};
+    nav_msgs::Path path;
+    for (int i = 0; i < 10; ++i) {
+        ASSERT_TRUE(history.add(poseAt(i, 0)));
+        ASSERT_EQ(history.size(), std::min(i + 1, 3));
+        history.fill(path);
+        ASSERT_EQ(path.poses.size(), history.size());
+        for (size_t p = 0; p < path.poses.size(); ++p) {
+            ASSERT_EQ(path.poses[p].pose.position.x, i + 1 - static_cast<double>(path.poses.size()) + static_cast<double>(p));
+        }
+    }
+    ASSERT_EQ(history.capacity(), 3u);
+    ASSERT_EQ(history.end(), 10u);
+}
+
+TEST(PathHistoryTest, FillsOnlyNewPoses) {
+    PathHistory history{4, 0, 0};
+    nav_msgs::Path path;
+    for (int i = 0; i < 3; ++i) history.add(poseAt(i, 0));
+    history.fill(path, 1);
+    ASSERT_EQ(path.poses.size(), 2u);
+    ASSERT_EQ(path.poses.front().pose.position.x, 1);
+
+    // Nothing new
+    history.fill(path, history.end());
+    ASSERT_TRUE(path.poses.empty());
+
+    // More were added than fit, only the ones still held come back
+    for (int i = 3; i < 9; ++i) history.add(poseAt(i, 0));
+    history.fill(path, 2);
+    ASSERT_EQ(path.poses.size(), 4u);
+    ASSERT_EQ(path.poses.front().pose.position.x, 5);
+    ASSERT_EQ(path.poses.back().pose.position.x, 8);
+}
+
+TEST(PathHistoryTest, ClearKeepsNumbering) {
+    PathHistory history{4, 1, 1};
+    history.add(poseAt(0, 0));
+    history.add(poseAt(2, 0));
+    history.clear();
+    ASSERT_EQ(history.size(), 0u);
+    // The first pose after clearing is always kept
+    ASSERT_TRUE(history.add(poseAt(2, 0)));
+    ASSERT_EQ(history.end(), 3u);
+    nav_msgs::Path path;
+    history.fill(path);
+    ASSERT_EQ(path.poses.size(), 1u);
+}
+
+int main(int argc, char** argv) {
+    testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
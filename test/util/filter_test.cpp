@@ -0,0 +1,182 @@
+#include <gtest/gtest.h>
+
+#include <cstring>
+#include <random>
+
+#include <filter.hpp>
+
+namespace {
+
+    /**
+     * @brief The filter as it was before it kept its values sorted, copying and sorting them on every push.
+     */
+    template<typename T>
+    class ResortingMeanMedianFilter {
+        std::vector<T> mValues, mSortedValues;
+        double mProportion;
+        size_t mFilterCount = 0, mHead = 0;
+
+    public:
+        ResortingMeanMedianFilter(size_t size, double centerProportion) : mValues(size), mSortedValues(size), mProportion(centerProportion) {}
+
+        void push(T value) {
+            mHead = (mHead + 1) % mValues.size();
+            mValues[mHead] = value;
+            mFilterCount = std::min(mFilterCount + 1, mValues.size());
+            mSortedValues.assign(mValues.begin(), mValues.end());
+            std::sort(mSortedValues.begin(), mSortedValues.end());
+        }
+
+        void reset() { mFilterCount = 0; }
+
+        void decrementCount() { mFilterCount = std::max(mFilterCount - 1, size_t{}); }
+
+        [[nodiscard]] T get() const {
+            if (mFilterCount != mValues.size()) return mValues[mHead];
+
+            auto begin = mSortedValues.begin() + static_cast<std::ptrdiff_t>(mProportion * static_cast<double>(mValues.size()) / 4);
+            auto end = mSortedValues.end() - static_cast<std::ptrdiff_t>(mProportion * static_cast<double>(mValues.size()) / 4);
+            return std::accumulate(begin, end, T{}) / (end - begin);
+        }
+    };
+
+    template<typename T>
+    bool isSameBits(T a, T b) {
+        return std::memcmp(&a, &b, sizeof(T)) == 0;
+    }
+
+    template<typename T, typename Distribution>
+    void expectMatchesResorting(size_t size, double proportion, Distribution distribution) {
+        std::mt19937 generator{static_cast<uint32_t>(size)};
+        MeanMedianFilter<T> filter{size, proportion};
+        ResortingMeanMedianFilter<T> reference{size, proportion};
+        for (size_t i = 0; i < size * 20; ++i) {
+            T value = static_cast<T>(distribution(generator));
+            filter.push(value);
+            reference.push(value);
+            // Not full again until a full window is pushed, but old values stay in the window
+            if (i % 97 == 0) {
+                filter.reset();
+                reference.reset();
+            } else if (i % 31 == 0) {
+                filter.decrementCount();
+                reference.decrementCount();
+            }
+            ASSERT_TRUE(isSameBits(filter.get(), reference.get())) << "size " << size << " push " << i << ": " << filter.get() << " != " << reference.get();
+        }
+    }
+
+} // namespace
+
+TEST(MeanMedianFilterTest, MatchesResortingBitForBit) {
+    for (size_t size: {1, 2, 3, 10, 33, 100}) {
+        for (double proportion: {0.0, 0.5, 1.0, 1.5}) {
+            expectMatchesResorting<float>(size, proportion, std::normal_distribution<float>{5, 100});
+            expectMatchesResorting<double>(size, proportion, std::normal_distribution<double>{-3, 1e6});
+            expectMatchesResorting<int>(size, proportion, std::uniform_int_distribution<int>{-1000, 1000});
+            // Few distinct values, so most pushes replace a value with an equal one
+            expectMatchesResorting<double>(size, proportion, std::uniform_int_distribution<int>{0, 3});
+        }
+    }
+}
+
+TEST(MeanMedianFilterTest, OutliersAreTrimmed) {
+    MeanMedianFilter<double> filter{8, 1.0};
+    for (double value: {1.0, 2.0, 3.0, 4.0, 5.0, 6.0, 1000.0}) filter.push(value);
+    ASSERT_FALSE(filter.full());
+    ASSERT_EQ(filter.get(), 1000.0);
+
+    filter.push(-1000.0);
+    ASSERT_TRUE(filter.full());
+    // The two smallest and two largest are dropped
+    ASSERT_DOUBLE_EQ(filter.get(), 3.5);
+}
+
+TEST(MeanMedianFilterTest, ResizingKeepsTheNewestValues) {
+    MeanMedianFilter<int> filter{4, 0.0};
+    for (int value: {1, 2, 3, 4, 5, 6}) filter.push(value);
+    ASSERT_EQ(filter.get(), (3 + 4 + 5 + 6) / 4);
+
+    filter.setFilterCount(2);
+    ASSERT_EQ(filter.size(), 2u);
+    ASSERT_TRUE(filter.full());
+    ASSERT_EQ(filter.get(), (5 + 6) / 2);
+    filter.push(7);
+    ASSERT_EQ(filter.get(), (6 + 7) / 2);
+
+    filter.setFilterCount(4);
+    ASSERT_FALSE(filter.full());
+    ASSERT_EQ(filter.get(), 7);
+    filter.push(8);
+    filter.push(9);
+    ASSERT_TRUE(filter.full());
+    ASSERT_EQ(filter.get(), (6 + 7 + 8 + 9) / 4);
+    filter.push(10);
+    ASSERT_EQ(filter.get(), (7 + 8 + 9 + 10) / 4);
+}
+
+TEST(MeanMedianFilterTest, ChangingProportionRetrims) {
+    MeanMedianFilter<int> filter{8, 0.0};
+    for (int value: {-100, 1, 2, 3, 4, 5, 6, 100}) filter.push(value);
+    ASSERT_EQ(filter.get(), 21 / 8);
+    filter.setProportion(0.5f);
+    ASSERT_EQ(filter.get(), 21 / 6);
+}
+
+TEST(MultiChannelMeanMedianFilterTest, MatchesAFilterPerChannel) {
+    constexpr size_t CHANNELS = 7;
+    std::mt19937 generator{1};
+    std::normal_distribution<float> noise{0, 10};
+    std::uniform_int_distribution<int> few{0, 3};
+    for (size_t size: {1, 2, 5, 16, 50}) {
+        for (double proportion: {0.0, 1.0, 1.5}) {
+            MultiChannelMeanMedianFilter<float, CHANNELS> filter{size, proportion};
+            std::vector<MeanMedianFilter<float>> references(CHANNELS, MeanMedianFilter<float>{size, proportion});
+            for (size_t i = 0; i < size * 20; ++i) {
+                std::array<float, CHANNELS> reading;
+                for (size_t channel = 0; channel < CHANNELS; ++channel) {
+                    // Some channels repeat values, some have outliers
+                    reading[channel] = channel % 3 == 0 ? static_cast<float>(few(generator)) : noise(generator) * (i % 13 == 0 ? 100.0f : 1.0f);
+                    references[channel].push(reading[channel]);
+                }
+                filter.push(reading);
+                if (i % 97 == 0) {
+                    filter.reset();
+                    for (MeanMedianFilter<float>& reference: references) reference.reset();
+                }
+                if (i == size * 10) {
+                    filter.setFilterCount(size + 3);
+                    for (MeanMedianFilter<float>& reference: references) reference.setFilterCount(size + 3);
+                }
+
+                std::array<float, CHANNELS> filtered = filter.get();
+                for (size_t channel = 0; channel < CHANNELS; ++channel) {
+                    ASSERT_TRUE(isSameBits(filtered[channel], references[channel].get())) << "size " << size << " push " << i << " channel " << channel;
+                }
+            }
+        }
+    }
+}
+
+TEST(MultiChannelMeanMedianFilterTest, IntegersMatchAFilterPerChannel) {
+    constexpr size_t CHANNELS = 4;
+    std::mt19937 generator{2};
+    std::uniform_int_distribution<int> distribution{std::numeric_limits<int>::min() / 64, std::numeric_limits<int>::max() / 64};
+    MultiChannelMeanMedianFilter<int, CHANNELS> filter{20, 1.0};
+    std::vector<MeanMedianFilter<int>> references(CHANNELS, MeanMedianFilter<int>{20, 1.0});
+    for (size_t i = 0; i < 1000; ++i) {
+        std::array<int, CHANNELS> reading;
+        for (size_t channel = 0; channel < CHANNELS; ++channel) {
+            reading[channel] = distribution(generator);
+            references[channel].push(reading[channel]);
+        }
+        filter.push(reading);
+        std::array<int, CHANNELS> filtered = filter.get();
+        for (size_t channel = 0; channel < CHANNELS; ++channel) ASSERT_EQ(filtered[channel], references[channel].get());
+    }
+}
+
+int main(int argc, char** argv) {
+    testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
@@ -0,0 +1,222 @@
+#include <gtest/gtest.h>
+
+#include <sstream>
+#include <thread>
+
+#include <loop_profiler.hpp>
+#include <loop_profiler_trace.hpp>
+
+using namespace std::chrono_literals;
+
+namespace {
+
+    LoopProfilerEventStats findEvent(std::vector<LoopProfilerEventStats> const& events, std::string_view name) {
+        auto it = std::find_if(events.begin(), events.end(), [&](LoopProfilerEventStats const& event) { return event.name == name; });
+        if (it == events.end()) throw std::runtime_error{"No event named " + std::string{name}};
+        return *it;
+    }
+
+    size_t countOf(std::string const& string, std::string const& substring) {
+        size_t count = 0;
+        for (size_t i = string.find(substring); i != std::string::npos; i = string.find(substring, i + 1)) ++count;
+        return count;
+    }
+
+} // namespace
+
+TEST(LoopProfilerTest, NamesAreInternedOnce) {
+    LoopProfiler profiler{"Test"};
+    ASSERT_EQ(profiler.intern("Loop"), LoopProfiler::LOOP_EVENT);
+    LoopProfiler::EventId id = profiler.intern("Work");
+    ASSERT_EQ(profiler.intern("Work"), id);
+
+    // Same name at two addresses, both land in the same event
+    std::string first{"Wait"}, second{"Wait"};
+    profiler.measureEvent(first.c_str());
+    profiler.measureEvent(first.c_str());
+    profiler.measureEvent(second.c_str());
+    std::vector<LoopProfilerEventStats> events = profiler.report();
+    ASSERT_EQ(events.size(), 3u);
+    ASSERT_EQ(findEvent(events, "Wait").count, 2u);
+}
+
+TEST(LoopProfilerTest, PercentilesAreWithinBucketError) {
+    LoopProfiler profiler{"Test"};
+    LoopProfiler::EventId id = profiler.intern("Work");
+    for (int i = 1; i <= 1000; ++i) profiler.recordEvent(id, std::chrono::microseconds{i});
+
+    LoopProfilerEventStats work = findEvent(profiler.report(), "Work");
+    ASSERT_EQ(work.count, 1000u);
+    EXPECT_DOUBLE_EQ(work.meanMs, 0.5005);
+    EXPECT_DOUBLE_EQ(work.maxMs, 1.0);
+    EXPECT_NEAR(work.p50Ms, 0.5, 0.5 * 0.13);
+    EXPECT_NEAR(work.p95Ms, 0.95, 0.95 * 0.13);
+    EXPECT_NEAR(work.p99Ms, 0.99, 0.99 * 0.13);
+    EXPECT_LE(work.p99Ms, work.maxMs);
+}
+
+TEST(LoopProfilerTest, ReportsOnlyCoverTheirWindow) {
+    LoopProfiler profiler{"Test"};
+    LoopProfiler::EventId id = profiler.intern("Work");
+    for (int i = 0; i < 10; ++i) profiler.recordEvent(id, 1ms);
+    ASSERT_EQ(findEvent(profiler.report(), "Work").count, 10u);
+
+    LoopProfilerEventStats empty = findEvent(profiler.report(), "Work");
+    ASSERT_EQ(empty.count, 0u);
+    ASSERT_EQ(empty.maxMs, 0.0);
+
+    for (int i = 0; i < 5; ++i) profiler.recordEvent(id, 2ms);
+    LoopProfilerEventStats work = findEvent(profiler.report(), "Work");
+    ASSERT_EQ(work.count, 5u);
+    ASSERT_DOUBLE_EQ(work.maxMs, 2.0);
+}
+
+TEST(LoopProfilerTest, EventsTimeSinceThePreviousOne) {
+    LoopProfiler profiler{"Test"};
+    for (int i = 0; i < 3; ++i) {
+        profiler.beginLoop();
+        std::this_thread::sleep_for(2ms);
+        profiler.measureEvent("Sleep");
+        profiler.measureEvent("Nothing");
+    }
+
+    std::vector<LoopProfilerEventStats> events = profiler.report();
+    LoopProfilerEventStats loop = findEvent(events, "Loop"), sleep = findEvent(events, "Sleep"), nothing = findEvent(events, "Nothing");
+    // The first event only starts the clock, the first loop has no end yet
+    ASSERT_EQ(loop.count, 2u);
+    ASSERT_EQ(sleep.count, 2u);
+    ASSERT_EQ(nothing.count, 3u);
+    EXPECT_GE(loop.maxMs, 2.0);
+    EXPECT_GE(sleep.maxMs, 2.0);
+    EXPECT_LT(nothing.maxMs, 2.0);
+}
+
+TEST(LoopProfilerTest, ThreadsRecordWhileReporting) {
+    constexpr int THREADS = 4, SAMPLES = 20000;
+    LoopProfiler profiler{"Test"};
+    std::atomic<bool> done{false};
+    uint64_t reported = 0;
+    std::thread reporter{[&] {
+        while (!done) {
+            for (LoopProfilerEventStats const& event: profiler.report()) reported += event.count;
+        }
+    }};
+    std::vector<std::thread> threads;
+    for (int t = 0; t < THREADS; ++t) {
+        threads.emplace_back([&] {
+            for (int i = 0; i < SAMPLES; ++i) profiler.measureEvent("Work");
+        });
+    }
+    for (std::thread& thread: threads) thread.join();
+    done = true;
+    reporter.join();
+    for (LoopProfilerEventStats const& event: profiler.report()) reported += event.count;
+
+    // Each thread starts its own clock on its first event
+    ASSERT_EQ(reported, static_cast<uint64_t>(THREADS) * (SAMPLES - 1));
+}
+
+TEST(LoopProfilerTest, EventsPastTheLimitAreDropped) {
+    LoopProfiler profiler{"Test"};
+    for (size_t i = 1; i < LoopProfiler::MAX_EVENTS; ++i) {
+        ASSERT_NE(profiler.intern("Event " + std::to_string(i)), LoopProfiler::NO_EVENT);
+    }
+    ASSERT_EQ(profiler.intern("One too many"), LoopProfiler::NO_EVENT);
+    profiler.recordEvent(LoopProfiler::NO_EVENT, 1ms);
+    ASSERT_EQ(profiler.report().size(), LoopProfiler::MAX_EVENTS);
+}
+
+TEST(LoopProfilerTest, NothingIsTracedUnlessAskedTo) {
+    LoopProfiler profiler{"Test"};
+    for (int i = 0; i < 10; ++i) profiler.measureEvent("Work");
+    ASSERT_TRUE(profiler.traceSpans().empty());
+
+    profiler.setTracing(true);
+    profiler.measureEvent("Work");
+    ASSERT_EQ(profiler.traceSpans().size(), 1u);
+}
+
+TEST(LoopProfilerTest, TraceKeepsTheLatestSpans) {
+    constexpr uint64_t LOOPS = LoopProfiler::TRACE_CAPACITY;
+    LoopProfiler profiler{"Test"};
+    profiler.setTracing(true);
+    for (uint64_t i = 0; i < LOOPS; ++i) {
+        profiler.beginLoop(i);
+        profiler.measureEvent("Work");
+    }
+
+    // Two spans per loop, so only the second half of the loops are left
+    std::vector<LoopProfilerSpan> spans = profiler.traceSpans();
+    ASSERT_EQ(spans.size(), LoopProfiler::TRACE_CAPACITY - 1);
+    ASSERT_EQ(spans.front().sequence, LOOPS / 2);
+    ASSERT_EQ(spans.back().sequence, LOOPS - 1);
+    ASSERT_EQ(profiler.eventNames()[spans.back().event], "Work");
+    for (size_t i = 1; i < spans.size(); ++i) {
+        ASSERT_LE(spans[i].beginNs, spans[i].endNs);
+        ASSERT_LE(spans[i - 1].endNs, spans[i].endNs);
+    }
+}
+
+TEST(LoopProfilerTest, TraceWhileRecording) {
+    constexpr int THREADS = 2, LOOPS = 100000;
+    LoopProfiler profiler{"Test"};
+    profiler.setTracing(true);
+    std::atomic<bool> done{false};
+    size_t dumps = 0;
+    std::thread dumper{[&] {
+        while (!done) {
+            std::vector<LoopProfilerSpan> spans = profiler.traceSpans();
+            // Spans of a thread come in the order they were recorded, a torn one would break it
+            for (size_t i = 1; i < spans.size(); ++i) {
+                ASSERT_LE(spans[i].beginNs, spans[i].endNs);
+                if (spans[i].threadId != spans[i - 1].threadId) continue;
+                ASSERT_LE(spans[i - 1].sequence, spans[i].sequence);
+                ASSERT_LE(spans[i - 1].endNs, spans[i].endNs);
+            }
+            ++dumps;
+        }
+    }};
+    std::vector<std::thread> threads;
+    for (int t = 0; t < THREADS; ++t) {
+        threads.emplace_back([&] {
+            for (uint64_t i = 0; i < LOOPS; ++i) {
+                profiler.beginLoop(i);
+                profiler.measureEvent("Work");
+            }
+        });
+    }
+    for (std::thread& thread: threads) thread.join();
+    done = true;
+    dumper.join();
+
+    ASSERT_GT(dumps, 0u);
+    ASSERT_EQ(profiler.traceSpans().size(), THREADS * (LoopProfiler::TRACE_CAPACITY - 1));
+}
+
+TEST(LoopProfilerTest, ChromeTraceHasEverySpan) {
+    LoopProfiler profiler{"Test \"quoted\""};
+    profiler.setTracing(true);
+    for (uint64_t i = 0; i < 3; ++i) {
+        profiler.beginLoop(i);
+        profiler.measureEvent("Work");
+    }
+    std::ostringstream stream;
+    writeChromeTrace(stream, {&profiler});
+    std::string trace = stream.str();
+
+    ASSERT_EQ(trace.rfind(R"({"displayTimeUnit":"ms","traceEvents":[)", 0), 0u);
+    ASSERT_EQ(trace.substr(trace.size() - 4), "\n]}\n");
+    // The first event only starts the clock
+    ASSERT_EQ(countOf(trace, R"("ph":"X")"), 2u);
+    // Each of the two complete loops begins and ends
+    ASSERT_EQ(countOf(trace, R"("ph":"b")"), 2u);
+    ASSERT_EQ(countOf(trace, R"("ph":"e")"), 2u);
+    ASSERT_EQ(countOf(trace, R"("sequence":2)"), 1u);
+    ASSERT_EQ(countOf(trace, R"("name":"thread_name")"), 1u);
+    ASSERT_EQ(countOf(trace, R"("cat":"Test \"quoted\"")"), 6u);
+}
+
+int main(int argc, char** argv) {
+    testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
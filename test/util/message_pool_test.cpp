@@ -0,0 +1,91 @@
+#include <gtest/gtest.h>
+
+#include <vector>
+
+#include <message_pool.hpp>
+
+namespace {
+
+    struct Message {
+        // Counts live messages, so a test can see which ones were freed
+        static inline int alive = 0;
+
+        std::vector<int> data;
+
+        Message() { ++alive; }
+
+        Message(Message const&) = delete;
+        Message& operator=(Message const&) = delete;
+
+        ~Message() { --alive; }
+    };
+
+} // namespace
+
+TEST(MessagePoolTest, CountsHitsMissesAndOutstanding) {
+    MessagePool<Message> pool{2};
+    boost::shared_ptr<Message> first = pool.acquire();
+    boost::shared_ptr<Message> second = pool.acquire();
+    MessagePoolStats stats = pool.stats();
+    ASSERT_EQ(stats.misses, 2u);
+    ASSERT_EQ(stats.hits, 0u);
+    ASSERT_EQ(stats.outstanding, 2u);
+    ASSERT_EQ(stats.idle, 0u);
+
+    // A copy of the pointer, like a subscriber holding on to a published message, keeps it out of the pool
+    boost::shared_ptr<Message> subscriber = first;
+    first.reset();
+    ASSERT_EQ(pool.stats().outstanding, 2u);
+    subscriber.reset();
+    stats = pool.stats();
+    ASSERT_EQ(stats.outstanding, 1u);
+    ASSERT_EQ(stats.idle, 1u);
+
+    // The returned message is handed out again with what it held
+    second->data.assign(100, 1);
+    Message* reused = second.get();
+    second.reset();
+    boost::shared_ptr<Message> third = pool.acquire();
+    ASSERT_EQ(third.get(), reused);
+    ASSERT_EQ(third->data.size(), 100u);
+    stats = pool.stats();
+    ASSERT_EQ(stats.misses, 2u);
+    ASSERT_EQ(stats.hits, 1u);
+    ASSERT_EQ(stats.outstanding, 1u);
+    ASSERT_EQ(stats.idle, 1u);
+}
+
+TEST(MessagePoolTest, FreesMessagesPastMaxIdle) {
+    int aliveBefore = Message::alive;
+    {
+        MessagePool<Message> pool{2};
+        std::vector<boost::shared_ptr<Message>> messages;
+        for (int i = 0; i < 5; ++i) messages.push_back(pool.acquire());
+        ASSERT_EQ(Message::alive, aliveBefore + 5);
+
+        messages.clear();
+        // Only two fit in the pool, the other three are freed on release
+        ASSERT_EQ(Message::alive, aliveBefore + 2);
+        MessagePoolStats stats = pool.stats();
+        ASSERT_EQ(stats.outstanding, 0u);
+        ASSERT_EQ(stats.idle, 2u);
+    }
+    ASSERT_EQ(Message::alive, aliveBefore);
+}
+
+TEST(MessagePoolTest, ReleaseAfterPoolIsDestroyed) {
+    int aliveBefore = Message::alive;
+    boost::shared_ptr<Message> message;
+    {
+        MessagePool<Message> pool;
+        message = pool.acquire();
+    }
+    ASSERT_EQ(Message::alive, aliveBefore + 1);
+    message.reset();
+    ASSERT_EQ(Message::alive, aliveBefore);
+}
+
+int main(int argc, char** argv) {
+    testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
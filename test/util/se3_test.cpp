@@ -0,0 +1,239 @@
+#include <gtest/gtest.h>
+
+#include <cstring>
+#include <random>
+#include <vector>
+
+#include <se3.hpp>
+
+namespace {
+
+    // Same layout as mrover::Point, the library does not depend on perception
+    struct Point {
+        float x, y, z;
+        uint8_t b, g, r, a;
+        float normal_x, normal_y, normal_z;
+        float curvature;
+    } __attribute__((packed));
+
+    struct PointXYZRGB {
+        float x, y, z;
+        uint8_t b, g, r, a;
+    } __attribute__((packed));
+
+    // The unit vector expressions convert to rotations too, so give them a concrete type
+    R3 const X = R3::UnitX();
+
+    Eigen::Quaterniond fromXyzw(double x, double y, double z, double w) {
+        return Eigen::Quaterniond{w, x, y, z}.normalized();
+    }
+
+    // A quaternion and its negation are the same rotation
+    void expectSameRotation(SO3 const& a, SO3 const& b, double tolerance = 1e-9) {
+        EXPECT_LT(a.distanceTo(b), tolerance);
+    }
+
+    SE3 someTransform() {
+        return {R3{1.5, -2, 0.25}, fromXyzw(0.2705981, 0.6532815, 0.2705981, 0.6532815)};
+    }
+
+} // namespace
+
+TEST(SO3Test, Init) {
+    SO3 identity;
+    ASSERT_TRUE(identity.quaternion().coeffs().isApprox(Eigen::Vector4d{0, 0, 0, 1}));
+
+    SO3 rotation{fromXyzw(0, 1, 0, 0)};
+    ASSERT_TRUE(rotation.quaternion().coeffs().isApprox(Eigen::Vector4d{0, 1, 0, 0}));
+
+    // Angle and axis like the angle axis it used to store
+    SO3 quarterTurn{M_PI / 2, R3::UnitZ()};
+    ASSERT_TRUE((quarterTurn * X).isApprox(R3::UnitY()));
+}
+
+TEST(SO3Test, FromMatrix) {
+    SO3 identity{Eigen::Matrix3d::Identity()};
+    ASSERT_TRUE(identity.quaternion().coeffs().isApprox(Eigen::Vector4d{0, 0, 0, 1}));
+
+    Eigen::Matrix3d matrix;
+    matrix << -1, 0, 0, 0, 1, 0, 0, 0, -1;
+    expectSameRotation(SO3{matrix}, fromXyzw(0, 1, 0, 0));
+}
+
+TEST(SO3Test, RotationMatrix) {
+    ASSERT_TRUE(SO3{}.matrix().isApprox(Eigen::Matrix4d::Identity()));
+
+    Eigen::Matrix3d expected;
+    expected << 0, 0, 1, 1, 0, 0, 0, 1, 0;
+    Eigen::Matrix3d rotation = SO3{fromXyzw(0.5, 0.5, 0.5, 0.5)}.matrix().block<3, 3>(0, 0);
+    ASSERT_TRUE(rotation.isApprox(expected));
+}
+
+TEST(SO3Test, DirectionVector) {
+    ASSERT_TRUE((SO3{} * X).isApprox(X));
+    ASSERT_TRUE((SO3{fromXyzw(0, 0, 0.3826834, 0.9238795)} * X).isApprox(R3{M_SQRT1_2, M_SQRT1_2, 0}, 1e-6));
+    ASSERT_TRUE((SO3{fromXyzw(0.5, -0.5, 0.5, 0.5)} * X).isApprox(R3::UnitZ()));
+}
+
+TEST(SO3Test, DistanceTo) {
+    SO3 identity;
+    ASSERT_NEAR(identity.distanceTo(identity), 0, 1e-12);
+
+    SO3 r3{fromXyzw(0, 0, M_SQRT1_2, M_SQRT1_2)}, r4{fromXyzw(0, 0, -M_SQRT1_2, M_SQRT1_2)}, r5{fromXyzw(0, 0, M_SQRT1_2, -M_SQRT1_2)};
+    ASSERT_NEAR(r3.distanceTo(r3), 0, 1e-7);
+    ASSERT_NEAR(identity.distanceTo(r3), M_PI / 2, 1e-9);
+    ASSERT_NEAR(r3.distanceTo(identity), M_PI / 2, 1e-9);
+    ASSERT_NEAR(identity.distanceTo(r4), M_PI / 2, 1e-9);
+    ASSERT_NEAR(r3.distanceTo(r4), M_PI, 1e-9);
+    ASSERT_NEAR(r4.distanceTo(r3), M_PI, 1e-9);
+    // 270 degrees one way is 90 the other
+    ASSERT_NEAR(identity.distanceTo(r5), M_PI / 2, 1e-9);
+
+    // 45 degrees around the x axis, then 90 degrees around the y axis
+    SO3 r6{fromXyzw(0.2705981, 0.6532815, 0.2705981, 0.6532815)};
+    ASSERT_NEAR(r6.distanceTo(r4), 2.5935642935144156, 1e-6);
+    ASSERT_NEAR(r4.distanceTo(r6), 2.5935642935144156, 1e-6);
+}
+
+TEST(SO3Test, ExpIsTheInverseOfLog) {
+    ASSERT_TRUE(SO3::exp(R3::Zero()).quaternion().coeffs().isApprox(Eigen::Vector4d{0, 0, 0, 1}));
+    ASSERT_TRUE(SO3{}.log().isZero());
+    expectSameRotation(SO3::exp(R3{0, 0, M_PI / 2}), fromXyzw(0, 0, M_SQRT1_2, M_SQRT1_2));
+
+    std::mt19937 generator{3};
+    std::uniform_real_distribution<double> coordinate{-1, 1};
+    for (int i = 0; i < 100; ++i) {
+        R3 tangent = R3{coordinate(generator), coordinate(generator), coordinate(generator)}.normalized() * (M_PI * (i + 0.5) / 101);
+        ASSERT_TRUE(SO3::exp(tangent).log().isApprox(tangent, 1e-9)) << tangent.transpose();
+    }
+    // Tiny angles take the expansion
+    ASSERT_TRUE(SO3::exp(R3{1e-12, -2e-12, 0}).log().isApprox(R3{1e-12, -2e-12, 0}, 1e-6));
+}
+
+TEST(SO3Test, InverseAndInterpolation) {
+    SO3 rotation{fromXyzw(0.2705981, 0.6532815, 0.2705981, 0.6532815)};
+    expectSameRotation(rotation * rotation.inverse(), SO3{});
+
+    SO3 quarterTurn = SO3::exp(R3{0, 0, M_PI / 2});
+    expectSameRotation(SO3{}.interpolate(quarterTurn, 0), SO3{});
+    expectSameRotation(SO3{}.interpolate(quarterTurn, 1), quarterTurn);
+    expectSameRotation(SO3{}.interpolate(quarterTurn, 0.5), SO3::exp(R3{0, 0, M_PI / 4}));
+}
+
+TEST(SE3Test, Init) {
+    SE3 identity;
+    ASSERT_TRUE(identity.position().isZero());
+    ASSERT_TRUE(identity.rotation().quaternion().coeffs().isApprox(Eigen::Vector4d{0, 0, 0, 1}));
+
+    SE3 transform{R3{1, 2, 3}, fromXyzw(1, 2, 3, 4)};
+    ASSERT_TRUE(transform.position().isApprox(R3{1, 2, 3}));
+    expectSameRotation(transform.rotation(), fromXyzw(1, 2, 3, 4));
+}
+
+TEST(SE3Test, DistanceTo) {
+    SE3 p1{R3{1, 2, 3}, SO3{}}, p2{R3{-4, 8, -7}, SO3{}};
+    ASSERT_NEAR(p1.distanceTo(p2), 12.6886, 1e-4);
+    ASSERT_NEAR(p2.distanceTo(p1), 12.6886, 1e-4);
+    ASSERT_NEAR(p1.distanceTo(p1), 0, 1e-12);
+    ASSERT_NEAR(SE3{}.distanceTo(SE3{R3{3, 4, 0}, SO3{}}), 5, 1e-12);
+}
+
+TEST(SE3Test, TransformMatrix) {
+    Eigen::Matrix4d matrix = Eigen::Matrix4d::Identity();
+    matrix.block<3, 3>(0, 0) << 0, -1, 0, 1, 0, 0, 0, 0, 1;
+    matrix.block<3, 1>(0, 3) << 1, 2, 3;
+
+    SE3 transform{R3{1, 2, 3}, fromXyzw(0, 0, M_SQRT1_2, M_SQRT1_2)};
+    ASSERT_TRUE(transform.matrix().isApprox(matrix));
+    Eigen::Matrix3d rotation = transform.rotation().matrix().block<3, 3>(0, 0);
+    ASSERT_TRUE(rotation.isApprox(matrix.block<3, 3>(0, 0)));
+}
+
+TEST(SE3Test, ComposesInFrameOrder) {
+    // A tag a meter in front of a camera, the camera rotated a quarter turn in its parent
+    SE3 tagInCam{R3{1, 0, 0}, SO3{}}, camInParent{R3{0, 0, 2}, SO3::exp(R3{0, 0, M_PI / 2})};
+    SE3 tagInParent = tagInCam * camInParent;
+    ASSERT_TRUE(tagInParent.position().isApprox(R3{0, 1, 2}));
+    ASSERT_TRUE(tagInParent.matrix().isApprox(camInParent.matrix() * tagInCam.matrix()));
+    ASSERT_TRUE(camInParent.apply(R3{1, 0, 0}).isApprox(tagInParent.position()));
+}
+
+TEST(SE3Test, InverseExpLogAndInterpolation) {
+    SE3 transform = someTransform();
+    ASSERT_TRUE((transform * transform.inverse()).matrix().isApprox(Eigen::Matrix4d::Identity()));
+    ASSERT_TRUE(transform.inverse().apply(transform.apply(R3{3, 2, 1})).isApprox(R3{3, 2, 1}));
+
+    ASSERT_TRUE(SE3::exp(transform.log()).matrix().isApprox(transform.matrix(), 1e-9));
+    R6 twist;
+    twist << 0.5, -1, 2, 1e-9, 0, 0;
+    ASSERT_TRUE(SE3::exp(twist).log().isApprox(twist, 1e-6));
+    // A pure translation twist is the translation
+    twist << 1, 2, 3, 0, 0, 0;
+    ASSERT_TRUE(SE3::exp(twist).position().isApprox(R3{1, 2, 3}));
+
+    SE3 halfway = SE3{}.interpolate(transform, 0.5);
+    ASSERT_TRUE(halfway.position().isApprox(transform.position() / 2));
+    expectSameRotation(halfway.rotation(), SO3{}.interpolate(transform.rotation(), 0.5));
+    ASSERT_TRUE(SE3{}.interpolate(transform, 1).matrix().isApprox(transform.matrix()));
+}
+
+TEST(SE3Test, ApplyToPackedFloats) {
+    SE3 transform = someTransform();
+    // Odd counts and the parallel path both end on a point the vector loop does not take
+    for (size_t count: {size_t{0}, size_t{1}, size_t{2}, size_t{7}, size_t{200003}}) {
+        std::mt19937 generator{static_cast<uint32_t>(count)};
+        std::uniform_real_distribution<float> coordinate{-20, 20};
+        std::vector<float> xyz(count * 3 + 1);
+        for (float& value: xyz) value = coordinate(generator);
+        std::vector<float> original = xyz;
+
+        transform.apply(xyz.data(), count);
+        for (size_t i = 0; i < count; ++i) {
+            R3 expected = transform.apply(R3{original[i * 3], original[i * 3 + 1], original[i * 3 + 2]});
+            for (size_t axis = 0; axis < 3; ++axis) ASSERT_NEAR(xyz[i * 3 + axis], expected[static_cast<Eigen::Index>(axis)], 1e-4) << "point " << i;
+        }
+        ASSERT_EQ(xyz.back(), original.back());
+    }
+}
+
+TEST(SE3Test, ApplyToPointsKeepsOtherFields) {
+    SE3 transform = someTransform();
+    for (size_t count: {size_t{5}, size_t{100001}}) {
+        std::vector<Point> points(count);
+        std::vector<PointXYZRGB> colored(count);
+        for (size_t i = 0; i < count; ++i) {
+            // Spread over the range of the camera
+            auto value = static_cast<float>(i % 4000) * 0.005f - 10;
+            // Color bytes that read as a denormal and a NaN position, both have to come through
+            points[i] = {value, -value, 1, 1, 2, 3, 0, 0, 0, 1, 0.5};
+            colored[i] = {value, 2, i % 2 ? std::numeric_limits<float>::quiet_NaN() : 3, 0xFF, 0xFF, 0xFF, 0xFF};
+        }
+        std::vector<Point> originalPoints = points;
+        std::vector<PointXYZRGB> originalColored = colored;
+
+        transform.apply(points.data(), count);
+        transform.apply(colored.data(), count);
+        for (size_t i = 0; i < count; ++i) {
+            Point const &point = points[i], &original = originalPoints[i];
+            R3 position = transform.apply(R3{original.x, original.y, original.z});
+            ASSERT_NEAR(point.x, position.x(), 1e-3);
+            ASSERT_NEAR(point.y, position.y(), 1e-3);
+            ASSERT_NEAR(point.z, position.z(), 1e-3);
+            // Normals rotate but do not move
+            R3 normal = transform.rotation() * R3{original.normal_x, original.normal_y, original.normal_z};
+            ASSERT_NEAR(point.normal_x, normal.x(), 1e-5);
+            ASSERT_NEAR(point.normal_y, normal.y(), 1e-5);
+            ASSERT_NEAR(point.normal_z, normal.z(), 1e-5);
+            ASSERT_EQ(std::memcmp(&point.b, &original.b, 4), 0);
+            ASSERT_EQ(point.curvature, original.curvature);
+
+            ASSERT_EQ(std::isnan(colored[i].x), i % 2 == 1);
+            ASSERT_EQ(std::memcmp(&colored[i].b, &originalColored[i].b, 4), 0);
+        }
+    }
+}
+
+int main(int argc, char** argv) {
+    testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
@@ -0,0 +1,123 @@
+#include <gtest/gtest.h>
+
+#include <thread>
+
+#include <triple_buffer.hpp>
+
+TEST(TripleBufferTest, NothingToConsumeBeforePublish) {
+    TripleBuffer<int> buffer;
+    ASSERT_FALSE(buffer.consume());
+}
+
+TEST(TripleBufferTest, ConsumeTakesPublishedValueOnce) {
+    TripleBuffer<int> buffer;
+    buffer.back() = 42;
+    buffer.publish();
+    ASSERT_TRUE(buffer.consume());
+    ASSERT_EQ(buffer.front(), 42);
+    ASSERT_FALSE(buffer.consume());
+    ASSERT_EQ(buffer.front(), 42);
+}
+
+TEST(TripleBufferTest, ConsumeTakesNewestValue) {
+    TripleBuffer<int> buffer;
+    for (int i = 1; i <= 5; ++i) {
+        buffer.back() = i;
+        // Every value but the first replaces one that was never consumed
+        ASSERT_EQ(buffer.publish(), i > 1);
+    }
+    ASSERT_TRUE(buffer.consume());
+    ASSERT_EQ(buffer.front(), 5);
+    buffer.back() = 6;
+    ASSERT_FALSE(buffer.publish());
+}
+
+TEST(TripleBufferTest, ProducerNeverWritesIntoFront) {
+    TripleBuffer<int> buffer;
+    buffer.back() = 1;
+    buffer.publish();
+    ASSERT_TRUE(buffer.consume());
+    int* front = &buffer.front();
+    // However far ahead the producer gets, the buffer the consumer is reading stays untouched
+    for (int i = 2; i < 10; ++i) {
+        ASSERT_NE(&buffer.back(), front);
+        buffer.back() = i;
+        buffer.publish();
+    }
+    ASSERT_EQ(*front, 1);
+    ASSERT_TRUE(buffer.consume());
+    ASSERT_EQ(buffer.front(), 9);
+}
+
+TEST(TripleBufferTest, CloseKeepsLastValue) {
+    TripleBuffer<int> buffer;
+    buffer.back() = 7;
+    buffer.publish();
+    buffer.close();
+    ASSERT_TRUE(buffer.isClosed());
+    ASSERT_TRUE(buffer.waitAndConsume());
+    ASSERT_EQ(buffer.front(), 7);
+    ASSERT_FALSE(buffer.waitAndConsume());
+    ASSERT_TRUE(buffer.isClosed());
+}
+
+TEST(TripleBufferTest, ConcurrentValuesAreCompleteAndIncreasing) {
+    // Each value is written in full before it is published, a torn read shows up as mismatched halves
+    struct Frame {
+        uint64_t sequence = 0;
+        std::array<uint64_t, 64> payload{};
+    };
+    constexpr uint64_t FRAME_COUNT = 200'000;
+
+    TripleBuffer<Frame> buffer;
+    std::thread producer{[&] {
+        for (uint64_t sequence = 1; sequence <= FRAME_COUNT; ++sequence) {
+            Frame& frame = buffer.back();
+            frame.sequence = sequence;
+            frame.payload.fill(sequence);
+            buffer.publish();
+        }
+        buffer.close();
+    }};
+
+    uint64_t last = 0, received = 0;
+    while (buffer.waitAndConsume()) {
+        Frame const& frame = buffer.front();
+        ASSERT_GT(frame.sequence, last);
+        for (uint64_t value: frame.payload) ASSERT_EQ(value, frame.sequence);
+        last = frame.sequence;
+        ++received;
+    }
+    producer.join();
+
+    // The last value published before closing is never lost
+    ASSERT_EQ(last, FRAME_COUNT);
+    ASSERT_GT(received, 0u);
+}
+
+TEST(TripleBufferTest, WaitUntilConsumedHandsOverEveryValue) {
+    constexpr int VALUE_COUNT = 10'000;
+
+    TripleBuffer<int> buffer;
+    std::thread producer{[&] {
+        for (int value = 1; value <= VALUE_COUNT; ++value) {
+            buffer.waitUntilConsumed();
+            buffer.back() = value;
+            buffer.publish();
+        }
+        buffer.close();
+    }};
+
+    // Producing on demand, nothing is ever overwritten before the consumer gets to it
+    int expected = 1;
+    while (buffer.waitAndConsume()) {
+        ASSERT_EQ(buffer.front(), expected++);
+    }
+    producer.join();
+    ASSERT_EQ(expected, VALUE_COUNT + 1);
+}
+
+int main(int argc, char** argv) {
+    testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}